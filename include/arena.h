@@ -0,0 +1,41 @@
+#ifndef STDB_ARENA_H
+#define STDB_ARENA_H
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Bump allocator for one memtable: small allocations are carved out of
+// BLOCK_SIZE blocks, large ones get a block of their own, and everything is
+// freed at once when the Arena is destroyed. allocate() may be called from
+// several threads at once; memory_usage() is always safe to read.
+class Arena {
+public:
+    Arena() = default;
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    // `bytes` with no alignment guarantee (key bytes).
+    char* allocate(size_t bytes);
+    // `bytes` aligned for any object with alignment ≤ alignof(std::max_align_t).
+    char* allocate_aligned(size_t bytes);
+
+    // Bytes of blocks allocated so far, including unused block tails.
+    size_t memory_usage() const { return memory_usage_.load(std::memory_order_relaxed); }
+
+    static constexpr size_t BLOCK_SIZE = 64 * 1024;
+
+private:
+    char* allocate_locked(size_t bytes, size_t align);
+    char* new_block(size_t bytes);
+
+    std::mutex                           mu_;
+    char*                                ptr_ = nullptr;    // next free byte in the current block
+    size_t                               remaining_ = 0;    // bytes left after ptr_
+    std::vector<std::unique_ptr<char[]>> blocks_;
+    std::atomic<size_t>                  memory_usage_{0};
+};
+
+#endif // STDB_ARENA_H
@@ -7,6 +7,16 @@
 class Benchmark {
 public:
     static void run_all(const std::string& type, int num_ops = 20000); 
+
+    // Append-path microbenchmark: the former copy-into-a-buffer record
+    // encoding vs. GatherBuffer, then end-to-end kNone puts. Reports
+    // ns/record and bytes memcpy'd per record.
+    static void run_append_micro(size_t value_size = 65536, int num_ops = 2000);
+
+    // Checksum throughput over one buffer (default: a 64 MiB SSTable's
+    // worth): the former byte-at-a-time CRC32, slicing-by-8 CRC32 and
+    // CRC32C, and the runtime-dispatched CRC32C.
+    static void run_checksum_micro(size_t bytes = 64u * 1024u * 1024u);
 private:
     static void run_workload(const std::string& dir, const std::string& type, bool is_warm, int num_ops);
 };
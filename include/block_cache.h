@@ -0,0 +1,94 @@
+#ifndef STDB_BLOCK_CACHE_H
+#define STDB_BLOCK_CACHE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+struct SSTableBlock;
+
+// Capacity-bounded cache of SSTable data blocks, shared by every reader of a
+// store and, through Options::block_cache, by several stores.
+//
+// Blocks are keyed by (owner, file sequence, block offset); each store takes
+// its own owner id so equal sequences of different stores never collide.
+// The key space is split into 2^shard_bits shards by hash, each with its own
+// mutex and LRU list, so concurrent readers rarely contend.
+//
+// Entries are shared_ptrs: a block evicted while a reader still uses it
+// stays alive until that reader drops it. Index and filter blocks are not
+// entries; readers keep them in memory and pin() their size instead, which
+// shrinks the room left for data blocks. capacity() thus bounds the memory
+// for all SSTable metadata and cached data together.
+class BlockCache {
+public:
+    explicit BlockCache(size_t capacity_bytes, int shard_bits = 4);
+
+    BlockCache(const BlockCache&) = delete;
+    BlockCache& operator=(const BlockCache&) = delete;
+
+    // A fresh owner id for a store's keys.
+    uint64_t new_owner_id() { return next_owner_.fetch_add(1, std::memory_order_relaxed); }
+
+    // The cached block, or nullptr. A hit becomes most recently used.
+    std::shared_ptr<const SSTableBlock> lookup(uint64_t owner, uint32_t file_seq, uint64_t offset);
+
+    // Cache `block` with the given charge in bytes, replacing an existing
+    // entry. Returns the number of blocks evicted to make room.
+    size_t insert(uint64_t owner, uint32_t file_seq, uint64_t offset,
+                  std::shared_ptr<const SSTableBlock> block, size_t charge);
+
+    // Account memory held outside the cache (index and filter blocks).
+    void pin(size_t bytes)   { pinned_.fetch_add(bytes, std::memory_order_relaxed); }
+    void unpin(size_t bytes) { pinned_.fetch_sub(bytes, std::memory_order_relaxed); }
+
+    size_t capacity() const     { return capacity_; }
+    size_t pinned_usage() const { return pinned_.load(std::memory_order_relaxed); }
+    size_t usage() const;       // cached data blocks only
+
+    // Totals across every owner.
+    uint64_t hits() const      { return hits_.load(std::memory_order_relaxed); }
+    uint64_t misses() const    { return misses_.load(std::memory_order_relaxed); }
+    uint64_t evictions() const { return evictions_.load(std::memory_order_relaxed); }
+
+private:
+    struct Key {
+        uint64_t owner;
+        uint64_t offset;
+        uint32_t file_seq;
+        bool operator==(const Key& o) const {
+            return owner == o.owner && offset == o.offset && file_seq == o.file_seq;
+        }
+    };
+    struct KeyHash {
+        size_t operator()(const Key& k) const;
+    };
+    struct Entry {
+        Key                                 key;
+        std::shared_ptr<const SSTableBlock> block;
+        size_t                              charge;
+    };
+    struct Shard {
+        mutable std::mutex                                          mu;
+        std::list<Entry>                                            lru;   // front = most recent
+        std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> map;
+        size_t                                                      usage = 0;
+    };
+
+    Shard& shard_for(size_t hash) { return shards_[hash % shards_.size()]; }
+
+    size_t                   capacity_;
+    std::vector<Shard>       shards_;
+    std::atomic<size_t>      pinned_{0};
+    std::atomic<uint64_t>    next_owner_{1};
+    std::atomic<uint64_t>    hits_{0};
+    std::atomic<uint64_t>    misses_{0};
+    std::atomic<uint64_t>    evictions_{0};
+};
+
+#endif // STDB_BLOCK_CACHE_H
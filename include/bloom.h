@@ -2,6 +2,7 @@
 #define STDB_BLOOM_H
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <cstdint>
 
@@ -23,10 +24,20 @@ public:
 
     // Builder method (called during flush/compaction)
     void build(const std::vector<std::string>& keys, double fp_rate = 0.01);
+    void build(const std::vector<std::string_view>& keys, double fp_rate = 0.01);
+    // Same, from key_hash() of each key: a builder that streams its keys
+    // keeps 8 bytes per key instead of the keys.
+    void build_from_hashes(const std::vector<uint64_t>& hashes, double fp_rate = 0.01);
+    static uint64_t key_hash(std::string_view key);
 
     // Load method (called by SSTableReader)
     // Loads either into heap memory (< 1MB) or via mmap (>= 1MB)
     bool load(const std::string& file_path, uint64_t file_offset, uint32_t bloom_size, uint32_t k);
+    // Adopt filter bytes already read (and verified) by the caller.
+    void load(std::vector<uint8_t> bits, uint32_t k);
+    // Use filter bytes owned by the caller (a mapped SSTable), which must
+    // outlive the filter.
+    void load_view(const uint8_t* bits, size_t size, uint32_t k);
 
     // Query method
     bool may_contain(const std::string& key) const;
@@ -3,9 +3,24 @@
 
 class KVStore;
 
-// Runs L0 to L1 compaction on the given store.
-// Strictly merges L0 files with overlapping L1 files, outputs sorted L1 files,
-// drops tombstones if safe, and automatically commits a new manifest.
-void run_compaction(KVStore* store);
+// Runs one leveled compaction on the given store.
+// Picks the level with the highest compaction score (KVStore::
+// compaction_score), or L0 if no level is due. All of L0, or one table of a
+// deeper level, is merged with the overlapping tables of the next level
+// into sorted, disjoint tables of that level; tombstones are dropped if
+// safe, and a new manifest is committed automatically. An input that
+// overlaps no other input and no table of the next level is moved there
+// as is, by the manifest edit alone.
+//
+// Takes the store's mutex itself and drops it while merging and writing, so
+// reads, writes and flushes continue; L0 tables flushed meanwhile stay in L0.
+// One compaction runs at a time: a second caller waits for the first.
+// Returns false if nothing was due and L0 was empty.
+//
+// With CompactionStyle::kUniversal it instead merges consecutive sorted
+// runs (L0 tables and whole deeper levels) picked by run count, space
+// amplification and size ratio, or every run if nothing is due, into one
+// new run in their place. Returns false if there was at most one run.
+bool run_compaction(KVStore* store);
 
 #endif // STDB_COMPACTION_H
@@ -1,16 +1,60 @@
 #ifndef STDB_CRC32_H
 #define STDB_CRC32_H
 
+#include <cstddef>
 #include <cstdint>
-#include <string>
+#include <string_view>
 
-// Compute CRC32 over arbitrary byte buffer.
+// Checksum algorithm of a file or record. The numeric value is what the
+// on-disk formats store (WAL header, SSTable footer), so never renumber.
+//   kCRC32  — IEEE 802.3 polynomial (zlib). Everything written before
+//             checksum types existed uses it; still read, no longer written.
+//   kCRC32C — Castagnoli polynomial. SSE4.2 has an instruction for it;
+//             otherwise a slicing-by-8 table loop. Written by default.
+enum class ChecksumType : uint32_t { kCRC32 = 0, kCRC32C = 1 };
+
+static constexpr ChecksumType kDefaultChecksumType = ChecksumType::kCRC32C;
+
+// True if `raw` names a ChecksumType this build can verify.
+inline bool is_known_checksum_type(uint32_t raw) { return raw <= 1; }
+
+// Compute CRC32 (IEEE) over arbitrary byte buffer.
 uint32_t compute_crc32(const uint8_t* data, size_t len);
 
+// Incremental CRC32: crc32_extend(crc32_extend(0, a), b) == CRC32(a || b),
+// and crc32_extend(0, d) == compute_crc32(d). Lets callers checksum a record
+// piece by piece without first copying it into one buffer.
+uint32_t crc32_extend(uint32_t crc, const void* data, size_t len);
+
+// Incremental CRC32C, same contract. Uses the SSE4.2 crc32 instruction when
+// the CPU has it (checked once, at first use), slicing-by-8 otherwise.
+uint32_t crc32c_extend(uint32_t crc, const void* data, size_t len);
+
+// The slicing-by-8 CRC32C path, regardless of CPU. For tests and benchmarks.
+uint32_t crc32c_extend_portable(uint32_t crc, const void* data, size_t len);
+
+// "sse4.2" or "slicing-by-8": what crc32c_extend() dispatches to.
+const char* crc32c_implementation();
+
+// Incremental checksum of the given type.
+uint32_t checksum_extend(ChecksumType type, uint32_t crc, const void* data, size_t len);
+
+inline uint32_t compute_checksum(ChecksumType type, const void* data, size_t len) {
+    return checksum_extend(type, 0, data, len);
+}
+
 // Compute CRC32 over the WAL record fields:
 //   key_size (4 bytes) + value_size (4 bytes) + key + value
-// This is the checksum stored alongside each WAL record.
+// This is the checksum stored alongside each legacy (headerless) WAL
+// record, always IEEE. No allocation.
 uint32_t record_checksum(uint32_t key_size, uint32_t value_size,
-                         const std::string& key, const std::string& value);
+                         std::string_view key, std::string_view value);
+
+// Same, for headered WAL files: log_number (4 bytes) is covered first, so a
+// recycled record from an older log can never verify under a newer one.
+// `type` comes from the file header.
+uint32_t record_checksum(ChecksumType type, uint32_t log_number,
+                         uint32_t key_size, uint32_t value_size,
+                         std::string_view key, std::string_view value);
 
 #endif // STDB_CRC32_H
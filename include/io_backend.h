@@ -0,0 +1,130 @@
+#ifndef STDB_IO_BACKEND_H
+#define STDB_IO_BACKEND_H
+
+#include "options.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// One contiguous piece of a positioned write.
+struct IOSlice {
+    const void* data;
+    size_t      len;
+};
+
+// One positioned read. `ok` is set by IOBackend::read().
+struct IORead {
+    int      fd;
+    void*    buf;
+    size_t   len;
+    uint64_t offset;
+    bool     ok = false;
+};
+
+// Scatter-gather builder for one positioned write. Small pieces (record
+// headers, short keys) are copied into a reusable arena; pieces of at least
+// COPY_THRESHOLD bytes are referenced in place and must stay alive until the
+// write returns. clear() keeps capacity, so a long-lived builder stops
+// allocating once it has seen its working-set size.
+class GatherBuffer {
+public:
+    static constexpr size_t COPY_THRESHOLD = 256;
+
+    void clear();
+
+    // Append bytes, copying them if small and referencing them otherwise.
+    void add(const void* data, size_t len);
+
+    // Always copy; returns the arena offset for a later patch().
+    size_t copy(const void* data, size_t len);
+
+    // Overwrite previously copied bytes (e.g. a checksum known only later).
+    void patch(size_t arena_offset, const void* data, size_t len);
+
+    size_t size() const { return total_; }
+
+    // The write's slices, in order. Valid until the next mutating call.
+    const std::vector<IOSlice>& slices();
+
+    // Process-wide totals across all builders, for benchmarks and tests.
+    static uint64_t copied_bytes();
+    static uint64_t referenced_bytes();
+
+private:
+    struct Piece {
+        const void* external;   // nullptr → bytes live in arena_ at `offset`
+        size_t      offset;
+        size_t      len;
+    };
+    std::vector<uint8_t> arena_;
+    std::vector<Piece>   pieces_;
+    std::vector<IOSlice> slices_;
+    size_t               total_ = 0;
+};
+
+// Read-only memory map of a whole file (mmap / MapViewOfFile), advised for
+// sequential access. The view reflects the file as of open(); do not map a
+// file that another writer may truncate while the view is in use. An empty
+// file opens successfully with data() == nullptr.
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& path);
+    void close();
+
+    const uint8_t* data() const { return data_; }
+    size_t         size() const { return size_; }
+
+private:
+    const uint8_t* data_ = nullptr;
+    size_t         size_ = 0;
+};
+
+// Pluggable file I/O for WAL, VLog and SSTable files.
+//
+// Every call is synchronous from the caller's point of view: it returns once
+// all requested I/O has completed. Backends differ in how many system calls
+// that takes.
+//   POSIX    — pwritev / pread / fdatasync, one syscall per operation.
+//   io_uring — (Linux) the writes and the trailing fdatasync of a commit
+//              reach the kernel in one io_uring_enter(), linked so the sync
+//              only runs once the data has landed. Large writes are split
+//              into chunks that are all in flight at once, and batched reads
+//              submit every pread together.
+//
+// Thread safety: every method may be called concurrently. The io_uring
+// backend keeps one ring per calling thread.
+class IOBackend {
+public:
+    virtual ~IOBackend() = default;
+
+    virtual const char* name() const = 0;
+
+    // Write `slices` back-to-back at `offset` of fd, then fdatasync fd if
+    // `sync`. Returns false on any I/O error.
+    virtual bool write(int fd, const std::vector<IOSlice>& slices, uint64_t offset, bool sync) = 0;
+
+    // Perform every read; reads[i].ok is true if all reads[i].len bytes were
+    // read. Returns true only if every read succeeded.
+    virtual bool read(std::vector<IORead>& reads) = 0;
+
+    // fdatasync fd.
+    virtual bool sync(int fd) = 0;
+};
+
+// Process-wide POSIX backend, used when a file is opened without one.
+IOBackend* default_io_backend();
+
+// Creates the requested backend. Falls back to POSIX (with a warning) when
+// io_uring is not compiled in or the kernel refuses to set up a ring.
+std::unique_ptr<IOBackend> make_io_backend(IOBackendKind kind);
+
+#endif // STDB_IO_BACKEND_H
@@ -6,9 +6,19 @@
 #include "memtable.h"
 #include "sstable.h"
 #include "manifest.h"
+#include "block_cache.h"
+#include "metrics.h"
+#include "options.h"
+#include "write_batch.h"
 
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 #include <stdexcept>
 #include <limits>
@@ -18,51 +28,99 @@ inline bool is_tombstone(const VLogPointer& ptr) {
     return ptr.length == 0 && ptr.offset == std::numeric_limits<uint64_t>::max();
 }
 
-struct EngineMetrics {
-    uint64_t user_bytes_written = 0;
-    uint64_t storage_bytes_written = 0;
-    uint64_t get_calls = 0;
-    uint64_t sst_considered = 0;
-    uint64_t bloom_skips = 0;
-    uint64_t sst_searches = 0;
-    uint64_t vlog_reads = 0;
-
-    void reset() {
-        user_bytes_written = 0;
-        storage_bytes_written = 0;
-        get_calls = 0;
-        sst_considered = 0;
-        bloom_skips = 0;
-        sst_searches = 0;
-        vlog_reads = 0;
-    }
-};
-
 // KVStore — engine core (Phase 2).
 //
-// Write path (strict order):
-//   1. WAL.append(key, value)    — full record
+// Write path (strict order, per commit group):
+//   1. WAL.append_group(records) — full records, one write
 //   2. WAL.sync()                — durability boundary
-//   3. VLog.append(value)        — returns pointer
+//   3. VLog.append_group(values) — returns pointers, one write
 //   4. VLog.sync()               — pointer validity boundary
 //   5. Memtable.put(key, pointer)— only if 1–4 succeed
 //
+// Log mode (Options::vlog_as_wal): steps 1–2 are dropped and step 3 appends
+// keyed VLog records instead, so step 4 is the durability boundary. Flush
+// records the VLog tail in the manifest; recovery replays from there.
+//
+// Group commit: concurrent put()/delete_key()/write() callers queue up in writers_.
+// The writer at the front becomes the leader, takes every queued record
+// (up to MAX_GROUP_BYTES), runs steps 1–4 once for the whole group without
+// holding mu_, then applies step 5 in queue order and wakes the followers.
+// A group is fsynced if any member asked for SyncMode::kSync; kSync callers
+// never return before the fsyncs covering their record have completed.
+// kPeriodic writes are fsynced by sync_thread_, kNone writes at the next
+// flush / rotation / sync write / close (see options.h).
+//
+// Flush: when the active memtable fills up, the leader appends it to
+// immutables_ and switches to a new WAL, both under mu_, then wakes
+// flush_thread_. Once Options::min_memtables_to_merge are queued, the
+// flusher merges all of them into one SSTable without mu_; commit makes it
+// visible and drops those memtables in one step. A writer only waits if
+// Options::max_immutable_memtables are already queued when the next
+// memtable fills (flush_waits).
+//
+// Compaction: SSTables live in Options::num_levels levels. compaction_thread_
+// merges L0 into L1 once L0 holds L0_COMPACTION_TRIGGER tables, and moves
+// one table of a deeper level into the next once the level outgrows its
+// target size (see compaction_score()), without holding mu_ while it
+// merges. If L0 keeps growing, each commit group is delayed a little more
+// per table from L0_SLOWDOWN_TRIGGER on, and stopped at L0_HARD_LIMIT until
+// compaction catches up (write_slowdowns, write_stops, stall_micros). Under
+// universal compaction both limits scale with universal_run_trigger.
+//
 // Read path:
-//   active memtable → immutable memtable → SSTables (newest-first) → VLog read
+//   active memtable → immutable memtables → L0 SSTables (newest-first)
+//   → one SSTable per deeper level → VLog read
+//
+// Concurrency: get() and multi_get() may be called from any number of
+// threads while writes, flushes and compactions proceed. A reader never
+// takes mu_; it pins the current Version (memtables, SSTable lists and the
+// VLog they point into), which stays valid for as long as it is held. Every
+// change to those publishes a new Version under mu_.
 //
-// WAL files: wal_NNNNNN.log (monotonically increasing).
-// Rotation: create new WAL → fsync → switch → delete old (I19 safe).
+// WAL files: wal_NNNNNN.log (monotonically increasing). The log of a frozen
+// memtable stays on disk until its SSTable is committed (I19 safe).
 class KVStore {
 public:
-    explicit KVStore(const std::string& data_dir);
+    explicit KVStore(const std::string& data_dir, const Options& options = Options());
+    ~KVStore();
+
+    KVStore(const KVStore&) = delete;
+    KVStore& operator=(const KVStore&) = delete;
 
-    void put(const std::string& key, const std::string& value);
-    void delete_key(const std::string& key);
+    void put(const std::string& key, const std::string& value,
+             const WriteOptions& opts = WriteOptions());
+    void delete_key(const std::string& key, const WriteOptions& opts = WriteOptions());
+
+    // Apply every operation in `batch` atomically: one WAL batch record,
+    // one contiguous VLog append, one fsync per file. Replay restores either
+    // the whole batch or none of it.
+    void write(const WriteBatch& batch, const WriteOptions& opts = WriteOptions());
+    // Throws if an SSTable block the lookup needs is corrupt, or the key
+    // points into no VLog the store has.
     bool get(const std::string& key, std::string& out_value) const;
 
+    // Point lookups for many keys; the VLog reads for every key found are
+    // issued as one batch. found[i] reports whether values[i] was read.
+    // Throws as get() does.
+    void multi_get(const std::vector<std::string>& keys,
+                   std::vector<std::string>& values, std::vector<bool>& found) const;
+
+    // The store's block cache (possibly shared), or nullptr if disabled.
+    BlockCache* block_cache() const { return block_cache_.get(); }
+
+    // Name of the active I/O backend ("posix" or "io_uring").
+    const char* io_backend_name() const { return io_->name(); }
+
     size_t memtable_size() const;
     bool   wal_tainted() const;
 
+    // Blocks until no frozen memtable is waiting to be written. Throws if
+    // the background flush failed.
+    void   wait_for_flush();
+    // Flushes as wait_for_flush() does, then blocks until no compaction is
+    // running or due. Throws if the background compaction failed.
+    void   wait_for_compaction();
+
     EngineMetrics& metrics() { return metrics_; }
     const EngineMetrics& metrics() const { return metrics_; }
 
@@ -74,37 +132,162 @@ public:
     void bypass_bloom(bool bypass) { disable_bloom_ = bypass; }
 
 private:
+    struct Writer;
+    using Levels = std::vector<std::vector<SSTableHandle>>;
+
+    // Immutable once published. The active memtable keeps taking writes
+    // (Memtable synchronizes itself); everything else in it is fixed.
+    struct Version {
+        std::shared_ptr<Memtable>       active;
+        std::vector<std::shared_ptr<const Memtable>> immutables;   // newest-first
+        Levels                          levels;   // as levels_
+        std::shared_ptr<const VLog>     vlog;
+        std::shared_ptr<const VLog>     retired_vlog;   // as retired_vlog_
+
+        // The log `ptr` addresses, by file id; nullptr if neither holds it.
+        const VLog* vlog_for(const VLogPointer& ptr) const {
+            if (ptr.file_id == vlog->file_id()) return vlog.get();
+            if (retired_vlog && ptr.file_id == retired_vlog->file_id()) return retired_vlog.get();
+            return nullptr;
+        }
+    };
+
+    void     write_record(Writer& w);
+    bool     find_pointer(const Version& v, const std::string& key, VLogPointer& ptr) const;
+    static bool table_get(const SSTableReader& sst, const std::string& key, VLogPointer& ptr);
+    // v.vlog_for(ptr), or throws: a pointer into no known log is corruption.
+    static const VLog* vlog_for(const Version& v, const VLogPointer& ptr);
+    void     install_version();
+    std::shared_ptr<const Version> current_version() const;
+    std::string commit_to_wal(const std::vector<Writer*>& group,
+                              const std::vector<VLogRecordRef>& ops, bool need_sync,
+                              std::vector<VLogPointer>& ptrs, uint64_t& storage_bytes);
+    std::string commit_to_vlog(const std::vector<VLogRecordRef>& ops, bool need_sync,
+                               std::vector<VLogPointer>& ptrs, uint64_t& storage_bytes);
+    void     run_exclusive(const std::function<void()>& fn);
+    // VLog GC: put(key, value) only if key still maps to `expected`, checked
+    // and written with no other write in between. False if a newer write won.
+    bool     rewrite_value(const std::string& key, const std::string& value,
+                           const VLogPointer& expected);
+    void     background_sync_loop();
+    void     background_flush_loop();
+    void     background_compaction_loop();
     void     recover();
     void     load_sstables();
     void     scan_wal_files(std::vector<std::string>& paths, uint32_t& max_id) const;
-    void     maybe_flush();
+    void     maybe_flush(std::unique_lock<std::mutex>& lock);
     void     flush();
-    void     rotate_wal();
-    void     compact_l0_to_l1();
-    uint32_t next_sst_sequence() const;
+    void     freeze_memtable();
+    std::shared_ptr<Memtable> new_memtable() const;   // per options_.memtable_rep
+    void     flush_immutable(std::unique_lock<std::mutex>* lock);
+    void     drain_immutables(std::unique_lock<std::mutex>& lock);
+    void     switch_wal();
+    void     retire_wals(uint32_t upto_id);
+    uint64_t wal_preallocate_bytes() const {
+        return options_.recycle_wal ? options_.wal_segment_size : 0;
+    }
+    uint32_t next_sst_sequence();
+    // The level most in need of compaction and its score: L0's table count
+    // over L0_COMPACTION_TRIGGER, or a deeper level's bytes over
+    // level_max_bytes(). A score >= 1 means compaction is due; the last
+    // level is never picked. Under universal compaction: the sorted run
+    // count over universal_run_trigger, with level 0. Caller holds mu_.
+    double   compaction_score(size_t& level) const;
+    uint64_t level_max_bytes(size_t level) const;
+    // L0 table counts at which commit groups are slowed down and stopped:
+    // L0_SLOWDOWN_TRIGGER and L0_HARD_LIMIT, or under universal compaction
+    // twice universal_run_trigger and seven more than that.
+    size_t   l0_slowdown_trigger() const;
+    size_t   l0_stop_trigger() const;
+    // Records the tables and sizes of `levels` in `m`.
+    static void describe_levels(const Levels& levels, Manifest& m);
+    SSTableReadContext sst_read_context() const;
 
     std::string manifest_path() const;
 
     std::string wal_path(uint32_t id) const;
+    std::string spare_wal_path() const;
     std::string vlog_path() const;
     std::string sst_path(uint32_t seq) const;
 
     std::string                  data_dir_;
+    Options                      options_;
     mutable EngineMetrics        metrics_;
+    std::unique_ptr<IOBackend>   io_;          // outlives wal_/vlog_
+    std::shared_ptr<BlockCache>  block_cache_; // outlives every SSTableReader
+    uint64_t                     cache_owner_ = 0;
     std::unique_ptr<WAL>         wal_;
-    std::unique_ptr<VLog>        vlog_;
-    std::unique_ptr<Memtable>    active_;
-    std::unique_ptr<Memtable>    immutable_;
+    std::shared_ptr<VLog>        vlog_;
+    // VLog GC: the log being rewritten, readable until its live values are
+    // flushed from vlog_.
+    std::shared_ptr<VLog>        retired_vlog_;
+    std::shared_ptr<Memtable>    active_;
+
+    // A full memtable waiting for flush, with the state its flush commits.
+    struct FrozenMemtable {
+        std::shared_ptr<Memtable> mem;
+        uint64_t vlog_tail = 0;       // VLog tail when frozen
+        uint64_t last_sequence = 0;   // last sequence when frozen
+        uint32_t wal_id = 0;          // WAL holding its records
+    };
+    std::deque<FrozenMemtable>   immutables_;  // oldest first
     Manifest                     manifest_;
-    std::vector<SSTableReader>   l0_sstables_; // sorted newest-first
-    std::vector<SSTableReader>   l1_sstables_; // non-overlapping
+    // levels_[0] is L0, newest first; every deeper level is sorted by key
+    // and its tables do not overlap.
+    Levels                       levels_;
+    std::vector<std::string>     compact_pointer_;   // per level: max key of the last table moved down
     uint32_t                     current_wal_id_ = 1;
-    bool                         disable_bloom_ = false;
+    uint64_t                     last_sequence_ = 0;   // last assigned write sequence
+    uint32_t                     next_sst_seq_ = 1;    // allocated under mu_
+    std::atomic<bool>            disable_bloom_{false};
+
+    // What readers see; replaced (never modified) under mu_ + version_mu_.
+    // version_mu_ only guards the pointer copy.
+    mutable std::mutex               version_mu_;
+    std::shared_ptr<const Version>   current_;
+
+    // Guards memtables, SSTable lists, the manifest and the writer queue.
+    // The group-commit leader drops it while doing WAL/VLog I/O.
+    mutable std::mutex           mu_;
+    std::deque<Writer*>          writers_;
+
+    // Background fsync for SyncMode::kPeriodic. sync_mu_ is held while the
+    // syncer fsyncs wal_/vlog_ and by anyone replacing those objects
+    // (lock order: mu_ → sync_mu_).
+    std::mutex                   sync_mu_;
+    std::condition_variable      sync_cv_;   // waits on mu_
+    std::thread                  sync_thread_;
+    uint64_t                     periodic_unsynced_bytes_ = 0;
+    bool                         shutting_down_ = false;
+
+    // Background flush of immutables_. Both condition variables wait on mu_:
+    // flush_cv_ wakes the flusher, flush_done_cv_ the writers waiting on it.
+    // A failed flush leaves immutables_ in place and fails later writes.
+    std::condition_variable      flush_cv_;
+    std::condition_variable      flush_done_cv_;
+    std::thread                  flush_thread_;
+    std::string                  flush_error_;
+    int                          drain_waiters_ = 0;  // flush below min_memtables_to_merge
+
+    // Background compaction. compaction_cv_ wakes the compactor,
+    // compaction_done_cv_ stopped writers and callers of run_compaction()
+    // waiting for the running one (both wait on mu_).
+    std::condition_variable      compaction_cv_;
+    std::condition_variable      compaction_done_cv_;
+    std::thread                  compaction_thread_;
+    bool                         compaction_running_ = false;
+    std::string                  compaction_error_;
+    // Workers for subcompactions, created by the first split compaction;
+    // only the running compaction uses it.
+    std::unique_ptr<ThreadPool>  compaction_pool_;
 
     static constexpr size_t FLUSH_THRESHOLD = 4u * 1024u * 1024u;  // 4 MiB
-    static constexpr size_t L0_HARD_LIMIT   = 15;
+    static constexpr size_t L0_COMPACTION_TRIGGER = 4;
+    static constexpr size_t L0_SLOWDOWN_TRIGGER   = 8;
+    static constexpr size_t L0_HARD_LIMIT         = 15;
+    static constexpr size_t MAX_GROUP_BYTES = 1u * 1024u * 1024u;  // 1 MiB per commit group
 
-    friend void run_compaction(KVStore* store);
+    friend bool run_compaction(KVStore* store);
     friend void run_vlog_gc(KVStore* store);
 };
 
@@ -5,13 +5,25 @@
 #include <string>
 #include <vector>
 
-// Tracks the set of SSTables in L0 and L1.
+// Tracks the set of SSTables in each level.
 // Supports atomic commits for crash-safety (I26).
 class Manifest {
 public:
     uint32_t version = 0;
-    std::vector<uint32_t> l0_seqs;
-    std::vector<uint32_t> l1_seqs;
+    // levels[0] is L0, oldest first; every deeper level holds tables with
+    // disjoint key ranges, and holds older data than the levels above it
+    // (under universal compaction each is one sorted run, and their count
+    // varies). level_bytes[n] is the size of levels[n] on disk.
+    std::vector<std::vector<uint32_t>> levels;
+    std::vector<uint64_t> level_bytes;
+
+    // Everything in the VLog before this offset is covered by SSTables.
+    // Recovery scans keyed VLog records from here (Options::vlog_as_wal).
+    uint64_t vlog_replay_offset = 0;
+    // VLog::file_id() of the current VLog; VLog GC moves to the next one.
+    uint32_t vlog_file_id = 0;
+    // Highest write sequence number covered by SSTables.
+    uint64_t last_sequence = 0;
 
     // Load from the given manifest file. Returns true on success.
     bool load(const std::string& path);
@@ -1,25 +1,103 @@
 #ifndef STDB_MEMTABLE_H
 #define STDB_MEMTABLE_H
 
+#include "arena.h"
+#include "options.h"
 #include "vlog.h"
-#include <map>
-#include <string>
+#include <atomic>
 #include <cstddef>
+#include <cstdint>
+#include <string_view>
 
-// Ordered in-memory key → VLogPointer store backed by std::map.
+// Ordered in-memory key → VLogPointer store: a skiplist whose nodes, keys
+// and pointers all live in a per-memtable Arena, released in one shot when
+// the memtable is discarded after flush.
+//
+// Concurrency: get(), for_each(), size() and byte_size() take no lock and
+// may run alongside put(). put() may itself be called from several threads:
+// nodes are linked in with compare-and-swap, bottom level first, so a node
+// is visible to readers as soon as it is in the bottom list. Nodes are
+// never removed; overwriting a key swaps in a new pointer copy.
+//
+// MemtableRep::kHashIndex adds a fixed array of hash buckets, also in the
+// arena, each a lock-free chain of nodes. get() and overwrites use it
+// instead of the skiplist search; a new node is pushed onto its chain once
+// it is in the bottom list.
 class Memtable {
+    struct Node;
+
 public:
-    void put(const std::string& key, const VLogPointer& pointer);
-    bool get(const std::string& key, VLogPointer& out_pointer) const;
+    explicit Memtable(MemtableRep rep = MemtableRep::kSkipList, uint32_t hash_buckets = 1u << 16);
+    Memtable(const Memtable&) = delete;
+    Memtable& operator=(const Memtable&) = delete;
+
+    void put(std::string_view key, const VLogPointer& pointer);
+    bool get(std::string_view key, VLogPointer& out_pointer) const;
+
+    size_t size() const { return count_.load(std::memory_order_relaxed); }
+    // Arena bytes in use, overwritten pointers included: drives the flush threshold.
+    size_t byte_size() const { return arena_.memory_usage(); }
+
+    // Calls fn(std::string_view key, const VLogPointer&) for every key in
+    // ascending order.
+    template <class F>
+    void for_each(F&& fn) const {
+        for (const Node* n = head_->next(0); n; n = n->next(0))
+            fn(n->key(), *n->value.load(std::memory_order_acquire));
+    }
+
+    // Ascending walk over the bottom list, for merging. Keys put while it
+    // runs are seen if they land ahead of it. The memtable must outlive the
+    // iterator.
+    class Iterator {
+    public:
+        explicit Iterator(const Memtable& mem) : mem_(&mem) {}
 
-    size_t size() const;
-    size_t byte_size() const;   // approximate bytes for flush threshold
+        void seek_to_first() { node_ = mem_->head_->next(0); }
+        void seek(std::string_view target);   // first key >= target
+        bool valid() const { return node_ != nullptr; }
+        void next() { node_ = node_->next(0); }
+        std::string_view   key() const { return node_->key(); }
+        const VLogPointer& pointer() const { return *node_->value.load(std::memory_order_acquire); }
 
-    const std::map<std::string, VLogPointer>& entries() const { return table_; }
+    private:
+        const Memtable* mem_;
+        const Node*     node_ = nullptr;
+    };
 
 private:
-    std::map<std::string, VLogPointer> table_;
-    size_t byte_size_ = 0;
+    static constexpr int MAX_HEIGHT = 12;
+    static constexpr unsigned BRANCHING = 4;
+
+    struct Node {
+        std::atomic<const VLogPointer*> value;
+        std::atomic<Node*>              hash_next;   // kHashIndex chain
+        const char*                     key_data;
+        uint32_t                        key_size;
+        // Tower of `height` links; only next_[0] is declared, the rest are
+        // allocated behind it.
+        std::atomic<Node*>              next_[1];
+
+        std::string_view key() const { return {key_data, key_size}; }
+        Node* next(int level) const { return next_[level].load(std::memory_order_acquire); }
+    };
+
+    Node* new_node(std::string_view key, const VLogPointer* value, int height);
+    const VLogPointer* copy_pointer(const VLogPointer& pointer);
+    static int random_height();
+    std::atomic<Node*>* bucket(std::string_view key) const;
+    Node* hash_find(std::string_view key) const;
+
+    // Last node before `key` on `level`, searching forward from `start`;
+    // `out_next` is the node after it (≥ key or nullptr).
+    static Node* find_prev(std::string_view key, Node* start, int level, Node*& out_next);
+
+    Arena               arena_;   // declared first: outlives every node
+    Node*               head_;
+    std::atomic<Node*>* buckets_ = nullptr;   // kHashIndex only
+    uint32_t            bucket_count_ = 0;
+    std::atomic<int>    max_height_{1};
+    std::atomic<size_t> count_{0};
 };
 
 #endif // STDB_MEMTABLE_H
@@ -0,0 +1,102 @@
+#ifndef STDB_MERGE_ITERATOR_H
+#define STDB_MERGE_ITERATOR_H
+
+#include "memtable.h"
+#include "sstable.h"
+#include "vlog.h"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// A sorted stream of key → pointer entries, one per key. key() and
+// pointer() stay valid until the next call to next() or seek_to_first().
+class KeyIterator {
+public:
+    virtual ~KeyIterator() = default;
+
+    virtual void seek_to_first() = 0;
+    virtual void seek(std::string_view target) = 0;   // first key >= target
+    virtual bool valid() const = 0;
+    virtual void next() = 0;
+    virtual std::string_view   key() const = 0;
+    virtual const VLogPointer& pointer() const = 0;
+
+    // False once the source failed to read (e.g. a corrupt SSTable block);
+    // it is then no longer valid.
+    virtual bool ok() const { return true; }
+};
+
+// One SSTable, reading blocks without filling the block cache. The handle
+// keeps the table alive.
+class SSTableKeyIterator : public KeyIterator {
+public:
+    explicit SSTableKeyIterator(SSTableHandle table)
+        : table_(std::move(table)), it_(table_->new_iterator(false)) {}
+
+    void seek_to_first() override { it_.seek_to_first(); }
+    void seek(std::string_view target) override { it_.seek(target); }
+    bool valid() const override { return it_.valid(); }
+    void next() override { it_.next(); }
+    std::string_view   key() const override { return it_.key(); }
+    const VLogPointer& pointer() const override { return it_.pointer(); }
+    bool ok() const override { return it_.ok(); }
+
+private:
+    SSTableHandle          table_;
+    SSTableReader::Iterator it_;
+};
+
+// One memtable, kept alive by the iterator. It should no longer take
+// writes (a frozen memtable).
+class MemtableKeyIterator : public KeyIterator {
+public:
+    explicit MemtableKeyIterator(std::shared_ptr<const Memtable> mem)
+        : mem_(std::move(mem)), it_(*mem_) {}
+
+    void seek_to_first() override { it_.seek_to_first(); }
+    void seek(std::string_view target) override { it_.seek(target); }
+    bool valid() const override { return it_.valid(); }
+    void next() override { it_.next(); }
+    std::string_view   key() const override { return it_.key(); }
+    const VLogPointer& pointer() const override { return it_.pointer(); }
+
+private:
+    std::shared_ptr<const Memtable> mem_;
+    Memtable::Iterator              it_;
+};
+
+// Merges sorted sources into one ascending stream holding each key once.
+// Sources are given newest first: when several hold a key, the newest
+// one's pointer is returned and the others skip it. A binary min-heap over
+// (key, source) makes each step O(log n) in the number of sources, and
+// memory is one current entry (one SSTable block) per source.
+class MergingIterator : public KeyIterator {
+public:
+    explicit MergingIterator(std::vector<std::unique_ptr<KeyIterator>> sources);
+
+    void seek_to_first() override;
+    void seek(std::string_view target) override;
+    bool valid() const override { return !heap_.empty(); }
+    void next() override;
+    std::string_view   key() const override { return sources_[heap_.front()]->key(); }
+    const VLogPointer& pointer() const override { return sources_[heap_.front()]->pointer(); }
+    // False if any source failed; a failed source drops out of the merge,
+    // so check ok() once iteration ends.
+    bool ok() const override;
+
+private:
+    // Heap order: smallest key on top, the newest source first on a tie.
+    bool after(size_t a, size_t b) const;
+    void push(size_t i);
+    size_t pop();
+    void rebuild();   // heap of the sources left valid by a seek
+
+    std::vector<std::unique_ptr<KeyIterator>> sources_;
+    std::vector<size_t>                       heap_;   // valid sources
+    std::string                               skip_;   // key being skipped in next()
+};
+
+#endif // STDB_MERGE_ITERATOR_H
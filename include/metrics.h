@@ -0,0 +1,81 @@
+#ifndef STDB_METRICS_H
+#define STDB_METRICS_H
+
+#include <atomic>
+#include <cstdint>
+
+// A uint64_t counter that many threads may bump at once (relaxed atomic).
+// Reads, copies and arithmetic behave like the plain integer.
+class MetricCounter {
+public:
+    MetricCounter(uint64_t v = 0) : v_(v) {}
+    MetricCounter(const MetricCounter& o) : v_(o.load()) {}
+    MetricCounter& operator=(const MetricCounter& o) { v_.store(o.load(), std::memory_order_relaxed); return *this; }
+    MetricCounter& operator=(uint64_t v) { v_.store(v, std::memory_order_relaxed); return *this; }
+
+    operator uint64_t() const { return load(); }
+    uint64_t load() const { return v_.load(std::memory_order_relaxed); }
+
+    MetricCounter& operator+=(uint64_t d) { v_.fetch_add(d, std::memory_order_relaxed); return *this; }
+    MetricCounter& operator-=(uint64_t d) { v_.fetch_sub(d, std::memory_order_relaxed); return *this; }
+    MetricCounter& operator++() { *this += 1; return *this; }
+    uint64_t       operator++(int) { return v_.fetch_add(1, std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> v_;
+};
+
+// Counters are updated by readers, writers and background threads alike.
+struct EngineMetrics {
+    MetricCounter user_bytes_written = 0;
+    MetricCounter storage_bytes_written = 0;
+    MetricCounter get_calls = 0;
+    MetricCounter sst_considered = 0;
+    MetricCounter bloom_skips = 0;
+    MetricCounter sst_searches = 0;
+    MetricCounter vlog_reads = 0;
+    MetricCounter wal_syncs = 0;          // WAL fsyncs issued by the write path
+    MetricCounter grouped_commits = 0;    // commit groups holding more than one writer
+    MetricCounter background_syncs = 0;   // WAL+VLog fsyncs issued for kPeriodic writes
+    MetricCounter background_flushes = 0; // memtables written to L0 by flush_thread_
+    MetricCounter flush_merges = 0;       // L0 tables written from more than one memtable
+    MetricCounter flush_waits = 0;        // writes that waited for the flush queue to drain
+    MetricCounter background_compactions = 0;
+    MetricCounter subcompactions = 0;     // key ranges merged in parallel by split compactions
+    MetricCounter compaction_bytes_written = 0; // SSTable bytes written by compaction
+    MetricCounter trivial_moves = 0;      // tables compaction moved down a level without rewriting
+    MetricCounter write_slowdowns = 0;    // commit groups delayed by the L0 backlog
+    MetricCounter write_stops = 0;        // commit groups stopped at L0_HARD_LIMIT
+    MetricCounter stall_micros = 0;       // time writes spent slowed, stopped or waiting for a flush
+    MetricCounter block_cache_hits = 0;   // SSTable data blocks served from the block cache
+    MetricCounter block_cache_misses = 0; // SSTable data blocks read from disk
+    MetricCounter block_cache_evictions = 0; // blocks this store's inserts pushed out
+
+    void reset() {
+        user_bytes_written = 0;
+        storage_bytes_written = 0;
+        get_calls = 0;
+        sst_considered = 0;
+        bloom_skips = 0;
+        sst_searches = 0;
+        vlog_reads = 0;
+        wal_syncs = 0;
+        grouped_commits = 0;
+        background_syncs = 0;
+        background_flushes = 0;
+        flush_merges = 0;
+        flush_waits = 0;
+        background_compactions = 0;
+        subcompactions = 0;
+        compaction_bytes_written = 0;
+        trivial_moves = 0;
+        write_slowdowns = 0;
+        write_stops = 0;
+        stall_micros = 0;
+        block_cache_hits = 0;
+        block_cache_misses = 0;
+        block_cache_evictions = 0;
+    }
+};
+
+#endif // STDB_METRICS_H
@@ -0,0 +1,130 @@
+#ifndef STDB_OPTIONS_H
+#define STDB_OPTIONS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+class BlockCache;
+
+// Durability of a single write.
+//   kSync     — fsync WAL and VLog before the write returns (default).
+//   kPeriodic — return after the write() syscalls; a background thread
+//               fsyncs every Options::sync_interval_ms or as soon as
+//               Options::sync_bytes of periodic writes are pending.
+//   kNone     — never fsync on behalf of this write. Data becomes durable
+//               at the next flush, WAL rotation, sync write or clean close.
+// A crash may lose the most recent kPeriodic / kNone writes, never a
+// kSync write that returned. Replay still stops at the last valid record.
+enum class SyncMode : uint8_t { kSync, kPeriodic, kNone };
+
+// File I/O backend (see io_backend.h). kIoUring falls back to kPosix when
+// the platform or kernel does not support it.
+enum class IOBackendKind : uint8_t { kPosix, kIoUring };
+
+// In-memory structure of each memtable.
+//   kSkipList  — ordered skiplist; a point lookup walks O(log n) nodes.
+//   kHashIndex — the same skiplist plus a hash index over its nodes, so a
+//                point lookup (and an overwrite) is O(1) expected. Flush
+//                still reads keys in order from the skiplist.
+enum class MemtableRep : uint8_t { kSkipList, kHashIndex };
+
+// How SSTables are compacted.
+//   kLeveled   — data moves down one level at a time into disjoint levels
+//                of growing size; low read amplification.
+//   kUniversal — tiered: every L0 table and every deeper level is one
+//                sorted run, and runs of similar size are merged only when
+//                there are too many or they waste too much space. Each key
+//                is rewritten far less often, at the cost of more runs to
+//                search on a read.
+// Both keep the same level layout (newer data in lower levels), so a
+// store may be reopened with either style.
+enum class CompactionStyle : uint8_t { kLeveled, kUniversal };
+
+struct WriteOptions {
+    SyncMode sync = SyncMode::kSync;
+};
+
+// Store-wide settings fixed at open time.
+struct Options {
+    uint32_t sync_interval_ms = 100;               // kPeriodic: max fsync delay
+    uint64_t sync_bytes       = 1u * 1024u * 1024u; // kPeriodic: early fsync trigger
+
+    // WiscKey log mode: the VLog is the recovery log. Writes append keyed,
+    // checksummed VLog records only — no WAL file and no second copy of the
+    // value. Recovery rebuilds the memtable by scanning the VLog from the
+    // manifest's replay offset. A store may be reopened in either mode;
+    // unflushed data from the other mode is replayed and flushed at open.
+    bool     vlog_as_wal      = false;
+
+    // WAL segment recycling: each WAL file is preallocated to
+    // wal_segment_size and, after a flush, the obsolete log is restamped
+    // with a new log number and overwritten in place instead of deleted.
+    // Appends then rewrite already-allocated blocks, so fdatasync flushes
+    // data only. Logs that outgrow the segment simply keep growing.
+    bool     recycle_wal      = false;
+    uint64_t wal_segment_size = 8u * 1024u * 1024u;
+
+    IOBackendKind io_backend  = IOBackendKind::kPosix;
+
+    // Threads verifying WAL checksums during recovery (0 → one per core).
+    // The memtable is still filled by the opening thread, in log order.
+    uint32_t recovery_threads = 0;
+
+    // Memtable structure; buckets are only used by kHashIndex (8 bytes each,
+    // counted against the flush threshold).
+    MemtableRep memtable_rep          = MemtableRep::kSkipList;
+    uint32_t    memtable_hash_buckets = 1u << 16;
+
+    // Full memtables that may wait for flush (each with its own WAL) before
+    // a write blocks. The flusher starts once min_memtables_to_merge are
+    // queued and writes every queued memtable into one L0 SSTable, newest
+    // version of each key winning; merging more memtables per flush means
+    // fewer L0 files. min_memtables_to_merge is capped at the maximum.
+    uint32_t max_immutable_memtables = 2;
+    uint32_t min_memtables_to_merge  = 1;
+
+    // Cache for SSTable data blocks; index and filter blocks count against
+    // its capacity too. Pass one block_cache to several stores to give them
+    // a single memory budget. Without one the store creates its own of
+    // block_cache_capacity bytes (0 → no cache).
+    std::shared_ptr<BlockCache> block_cache;
+    size_t   block_cache_capacity = 8u * 1024u * 1024u;
+
+    // Memory-map SSTables instead of reading their blocks with pread. Data
+    // and filter blocks are then paged in by the OS and use no heap or
+    // block cache; only each table's index stays in memory.
+    bool     sstable_mmap = false;
+
+    // Leveled compaction over num_levels levels (L0 plus at least one).
+    // L1 may hold level_base_bytes of SSTables and every deeper level
+    // level_size_ratio times the one above it; the last level is unbounded.
+    // A level over its target moves one table, with the overlapping tables
+    // of the next level, down a level. Compaction output is cut into tables
+    // of about target_file_size bytes of keys and pointers.
+    uint32_t num_levels       = 7;
+    uint64_t level_base_bytes = 16u * 1024u * 1024u;
+    uint32_t level_size_ratio = 10;
+    uint64_t target_file_size = 4u * 1024u * 1024u;
+
+    // A compaction reading more than target_file_size bytes of tables is
+    // split at sampled block boundaries into up to max_subcompactions
+    // disjoint key ranges, merged in parallel (0 → one per core). Every
+    // range writes its own tables; all are committed in one manifest edit.
+    uint32_t max_subcompactions = 0;
+
+    CompactionStyle compaction_style = CompactionStyle::kLeveled;
+    // kUniversal: compact once there are universal_run_trigger sorted runs.
+    // If the runs newer than the oldest hold more than
+    // universal_max_space_amp percent of its size, all runs are merged.
+    // Otherwise the newest runs whose sizes stay within
+    // universal_size_ratio percent of the runs merged before them are, or
+    // failing that just enough of the newest to get below the trigger.
+    // Writes slow down once L0 holds twice universal_run_trigger tables and
+    // stop seven tables later, so compaction is always due before a stall.
+    uint32_t universal_run_trigger   = 4;
+    uint32_t universal_size_ratio    = 1;
+    uint32_t universal_max_space_amp = 200;
+};
+
+#endif // STDB_OPTIONS_H
@@ -3,9 +3,15 @@
 
 #include "vlog.h"
 #include "bloom.h"
+#include "crc32.h"
+#include "io_backend.h"
+#include "metrics.h"
+#include <atomic>
 #include <cstdint>
 #include <map>
+#include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
 
 // Entry stored in an SSTable: key + vlog pointer.
@@ -14,54 +20,314 @@ struct SSTableEntry {
     VLogPointer pointer;
 };
 
+// Same, with the key borrowed from the source being written (a memtable).
+struct SSTableEntryRef {
+    std::string_view key;
+    VLogPointer      pointer;
+};
+
 // Writes a sorted set of key-pointer pairs to an SSTable file.
 //
-// File layout (STRICT):
-//   [Data Section: entries in sorted key order]
-//   [Bloom Filter Bytes]
-//   [Footer: uint32_t entry_count, uint32_t bloom_offset, uint32_t bloom_size, uint32_t checksum]
+// File layout (format 3, block-based):
+//   [Data Block 0][uint32_t checksum] ... [Data Block N-1][uint32_t checksum]
+//   [Bloom Block: uint32_t k, filter bytes][uint32_t checksum]
+//   [Index Block: varint block_count,
+//                 per block: varint key_size, separator, varint offset, varint size]
+//   [uint32_t checksum]
+//   [Footer: uint64_t index_offset, uint32_t index_size, uint64_t bloom_offset,
+//            uint32_t bloom_size, uint32_t entry_count, uint32_t checksum_type,
+//            uint32_t format_version, uint32_t checksum, uint32_t magic "SSTB"]
+//
+// Data blocks are cut once they reach SSTABLE_BLOCK_SIZE and hold whole
+// entries. Every block checksum (checksum_type, CRC32C for new files) covers
+// that block's bytes; the footer checksum covers the footer words before it.
+// A block's index key is a separator: >= every key in the block and < every
+// key in the next one (the last block's is its last key), so a lookup reads
+// exactly one data block.
 //
-// Entry format:
-//   [uint32_t key_size][key bytes][uint32_t file_id][uint64_t offset][uint32_t length]
+// Data block (format 3): entries, then uint32_t restart offsets and
+// uint32_t restart count. Every SSTABLE_RESTART_INTERVAL-th entry is a
+// restart point and stores its key whole, so binary search runs over the
+// restart points and then scans at most one interval:
+//   [varint shared][varint unshared][unshared key bytes]
+//   [varint file_id][varint zigzag(offset - previous offset)][varint length]
+// The previous offset is 0 at a restart point. Offsets of one flush grow
+// steadily, so deltas are short; a tombstone's offset is small as well.
+//
+// Format 2 stores entries whole — [uint32_t key_size][key bytes]
+// [uint32_t file_id][uint64_t offset][uint32_t length] — with an index of
+// fixed-width fields and last keys. Earlier formats hold those entries
+// followed by the bloom bytes and a single whole-file checksum, with a
+// 24-byte footer [entry_count, bloom_offset, bloom_size, checksum_type,
+// checksum, magic "SSTF"] (format 1) or a 16-byte footer [entry_count,
+// bloom_offset, bloom_size, checksum] with IEEE CRC32 (legacy). All remain
+// readable; formats 1 and legacy are kept in memory whole.
+static constexpr uint32_t SSTABLE_FOOTER_MAGIC = 0x46545353;  // "SSTF"
+static constexpr uint32_t SSTABLE_BLOCK_MAGIC  = 0x42545353;  // "SSTB"
+static constexpr uint32_t SSTABLE_FORMAT_VERSION = 3;
+static constexpr size_t   SSTABLE_BLOCK_SIZE   = 4096;
+static constexpr size_t   SSTABLE_RESTART_INTERVAL = 16;
+static constexpr size_t   SSTABLE_WRITE_BUFFER = 1u * 1024u * 1024u;
+static constexpr size_t   BLOCK_FOOTER_SIZE    = 44;
+static constexpr size_t   FOOTER_SIZE          = 24;
+static constexpr size_t   LEGACY_FOOTER_SIZE   = 16;
+
+// Builds an SSTable one entry at a time. Only the current data block, the
+// index, one hash per key (for the filter) and up to SSTABLE_WRITE_BUFFER
+// bytes of finished blocks are held in memory; full buffers are written out
+// as the table grows. finish() appends filter, index and footer and
+// fdatasyncs the file. A builder that is not finished removes its file.
+class SSTableBuilder {
+public:
+    explicit SSTableBuilder(IOBackend* io = nullptr);
+    ~SSTableBuilder();
+
+    SSTableBuilder(const SSTableBuilder&) = delete;
+    SSTableBuilder& operator=(const SSTableBuilder&) = delete;
+
+    // Creates (or truncates) the file. False on error.
+    bool open(const std::string& path);
+
+    // Keys must be strictly ascending. Errors surface in ok() and finish().
+    void add(std::string_view key, const VLogPointer& pointer);
+
+    // Writes the rest of the table and syncs it. False on any error, in
+    // which case the file is removed.
+    bool finish();
+
+    bool     ok() const { return ok_; }
+    const std::string& path() const { return path_; }
+    uint32_t entry_count() const { return entry_count_; }
+    // Bytes of finished blocks so far, written or buffered.
+    uint64_t file_size() const { return offset_ + buffer_.size(); }
+
+private:
+    void finish_block(std::string_view separator);
+    void flush_buffer(bool sync);
+    void close(bool remove);
+
+    struct BlockHandle {
+        std::string separator;
+        uint64_t    offset;
+        uint32_t    size;
+    };
+
+    IOBackend*               io_;
+    std::string              path_;
+    int                      fd_ = -1;
+    bool                     ok_ = false;
+    uint64_t                 offset_ = 0;        // bytes already written
+    std::vector<uint8_t>     buffer_;            // finished blocks not yet written
+    std::vector<uint8_t>     block_;
+    std::vector<uint32_t>    restarts_;
+    size_t                   in_interval_ = 0;
+    uint64_t                 prev_offset_ = 0;
+    std::string              last_key_;
+    bool                     pending_cut_ = false;   // block_ full; separator needs the next key
+    uint32_t                 entry_count_ = 0;
+    std::vector<BlockHandle> handles_;
+    std::vector<uint64_t>    key_hashes_;
+};
+
 class SSTableWriter {
 public:
-    // Write entries to file. Returns false on error.
+    // Write entries to file and fdatasync it. The data is submitted as
+    // several chunked writes plus the sync in one go through `io`
+    // (nullptr → POSIX). Returns false on error.
+    static bool write(const std::string& path,
+                      const std::map<std::string, VLogPointer>& entries,
+                      IOBackend* io = nullptr);
+    // `entries` must be sorted by key, without duplicates.
     static bool write(const std::string& path,
-                      const std::map<std::string, VLogPointer>& entries);
+                      const std::vector<SSTableEntryRef>& entries,
+                      IOBackend* io = nullptr);
 };
 
-// Loads and queries an SSTable file.
+class BlockCache;
+
+// Outcome of SSTableReader::get(). kCorrupt: the data block that would hold
+// the key failed to read or verify, so the table cannot say either way.
+enum class SSTableLookup { kFound, kAbsent, kCorrupt };
+
+// What a reader uses besides the file itself. Every field is optional.
+struct SSTableReadContext {
+    IOBackend*     io = nullptr;        // nullptr → POSIX
+    BlockCache*    cache = nullptr;     // nullptr → every block read from disk
+    uint64_t       cache_owner = 0;     // BlockCache::new_owner_id() of the store
+    EngineMetrics* metrics = nullptr;   // block cache hits, misses, evictions
+    bool           mmap = false;        // map formats 2–3 instead of reading blocks
+};
+
+// One data block read from disk and verified. Format 3 blocks stay
+// encoded and are decoded by SSTableBlockCursor; earlier formats are parsed
+// into `entries` up front, with keys pointing into the block bytes. A block
+// of a mapped table borrows its bytes from the mapping instead of `data`.
+struct SSTableBlock {
+    std::vector<uint8_t>         data;
+    const uint8_t*               mapped = nullptr;   // mmap: bytes in the reader's mapping
+    std::vector<SSTableEntryRef> entries;        // formats 1–2, sorted by key
+    uint32_t                     restarts = 0;   // format 3: offset of the restart array
+    uint32_t                     num_restarts = 0;   // 0 → `entries`
+
+    const uint8_t* bytes() const { return mapped ? mapped : data.data(); }
+};
+using SSTableBlockHandle = std::shared_ptr<const SSTableBlock>;
+
+// Walks the entries of one block in key order. A malformed format 3 entry
+// ends the walk and sets corrupt(); blocks are checksummed, so that only
+// happens with a writer bug.
+class SSTableBlockCursor {
+public:
+    explicit SSTableBlockCursor(SSTableBlockHandle block = nullptr) : block_(std::move(block)) {}
+
+    void seek_to_first();
+    void seek(std::string_view target);   // first key >= target
+    void next();
+    bool valid() const { return valid_; }
+    bool corrupt() const { return corrupt_; }
+    std::string_view   key() const;
+    const VLogPointer& pointer() const;
+
+private:
+    void     seek_to_restart(uint32_t r);
+    bool     decode_next();      // entry at next_ → current
+    uint32_t restart_point(uint32_t r) const;
+
+    SSTableBlockHandle block_;
+    bool               valid_ = false;
+    bool               corrupt_ = false;
+    size_t             pos_ = 0;           // formats 1–2: index into entries
+    uint32_t           next_ = 0;          // format 3: offset of the next entry
+    uint32_t           restart_ = 0;       // format 3: restart interval of current entry
+    uint64_t           prev_offset_ = 0;
+    std::string        key_;
+    VLogPointer        pointer_{};
+};
+
+// Opens and queries an SSTable file. Only the footer, index and bloom
+// filter (plus the first block, for min_key()) are read at open; data
+// blocks are read with positioned reads when a lookup or an iterator needs
+// them, through the block cache if there is one. Index and filter stay in
+// memory and are pinned against the cache's capacity. All const methods may
+// be called from many threads; the cache must outlive the reader.
+//
+// With SSTableReadContext::mmap the whole file is mapped instead. The
+// filter and data blocks are used in place, with the OS paging them in;
+// only the index is copied to the heap. Each block is verified on first
+// use, and the block cache is bypassed.
 class SSTableReader {
 public:
     SSTableReader() = default;
+    ~SSTableReader();
+
+    SSTableReader(const SSTableReader&) = delete;
+    SSTableReader& operator=(const SSTableReader&) = delete;
+    SSTableReader(SSTableReader&& other) noexcept;
+    SSTableReader& operator=(SSTableReader&& other) noexcept;
 
-    // Load from file. Validates footer checksum. Returns false if invalid.
-    bool load(const std::string& path);
+    // Open a file and verify its footer, index and filter. Returns false if
+    // invalid.
+    bool load(const std::string& path, const SSTableReadContext& ctx);
+    bool load(const std::string& path, IOBackend* io = nullptr);
 
-    // Binary search for key. Returns true and sets out_pointer if found.
-    bool get(const std::string& key, VLogPointer& out_pointer) const;
+    // Binary search for key; sets out_pointer if found. A data block that
+    // fails to read or verify gives kCorrupt, never kAbsent.
+    SSTableLookup get(const std::string& key, VLogPointer& out_pointer) const;
 
     uint32_t sequence() const { return sequence_; }
     const std::string& path() const { return path_; }
 
-    // Range metadata (assuming entries are sorted).
-    const std::string& min_key() const { return entries_.front().key; }
-    const std::string& max_key() const { return entries_.back().key; }
+    // Range metadata.
+    const std::string& min_key() const { return min_key_; }
+    const std::string& max_key() const { return index_.back().separator; }
 
     // Returns true if this table's key range overlaps with [min_k, max_k].
     bool overlaps(const std::string& min_k, const std::string& max_k) const {
-        if (entries_.empty()) return false;
+        if (entry_count_ == 0) return false;
         return !(max_key() < min_k || min_key() > max_k);
     }
 
-    const std::vector<SSTableEntry>& entries() const { return entries_; }
+    uint32_t entry_count() const { return entry_count_; }
+    size_t   block_count() const { return index_.size(); }
+    // Index separator of data block i: >= its keys, < the next block's.
+    const std::string& block_separator(size_t i) const { return index_[i].separator; }
+    uint64_t file_size() const { return file_size_; }
     const BloomFilter& bloom() const { return bloom_; }
 
+    // Data block i from the cache, or read and verified from disk and then
+    // cached if `fill_cache`. nullptr on failure, with a warning the first
+    // time a block fails its checksum.
+    SSTableBlockHandle read_block(size_t i, bool fill_cache = true) const;
+
+    // Forward iteration in key order, one data block resident at a time.
+    // The table must outlive the iterator.
+    class Iterator {
+    public:
+        explicit Iterator(const SSTableReader& table, bool fill_cache = true)
+            : table_(&table), fill_cache_(fill_cache) {}
+
+        void seek_to_first();
+        void seek(std::string_view target);   // first key >= target
+        void next();
+        bool valid() const { return cursor_.valid(); }
+        std::string_view   key() const     { return cursor_.key(); }
+        const VLogPointer& pointer() const { return cursor_.pointer(); }
+
+        // False once a data block failed to read or verify; the iterator is
+        // then no longer valid.
+        bool ok() const { return ok_; }
+
+    private:
+        void load_block(size_t i);
+        void skip_exhausted_blocks();
+
+        const SSTableReader* table_;
+        bool                 fill_cache_;
+        size_t               index_ = 0;
+        SSTableBlockCursor   cursor_;
+        bool                 ok_ = true;
+    };
+    // Scans that touch each block once (compaction, GC) pass fill_cache =
+    // false so they do not push hot blocks out of the cache.
+    Iterator new_iterator(bool fill_cache = true) const { return Iterator(*this, fill_cache); }
+
 private:
+    struct IndexEntry {
+        std::string separator;
+        uint64_t    offset;
+        uint32_t    size;
+    };
+
+    bool load_whole_file(uint64_t file_size);
+    bool parse_index(const uint8_t* p, size_t size);
+    bool parse_index_v2(const uint8_t* p, size_t size);
+    bool map_file(uint64_t file_size);
+    void unmap_file();
+    SSTableBlockHandle mapped_block(size_t i) const;
+    void mark_corrupt(size_t i) const;
+    void close_file();
+    void release();   // close_file(), unmap_file() and unpin
+
     std::string              path_;
     uint32_t                 sequence_ = 0;
-    std::vector<SSTableEntry> entries_;  // sorted by key
+    SSTableReadContext       ctx_;
+    uint32_t                 format_ = 0;
+    size_t                   pinned_bytes_ = 0;
+    int                      fd_ = -1;
+    const uint8_t*           map_ = nullptr;
+    size_t                   map_size_ = 0;
+    std::unique_ptr<std::atomic<uint8_t>[]> block_state_;   // per block: verified yet (mmap), corrupt?
+    ChecksumType             checksum_type_ = kDefaultChecksumType;
+    uint32_t                 entry_count_ = 0;
+    uint64_t                 file_size_ = 0;
+    std::string              min_key_;
+    std::vector<IndexEntry>  index_;
+    SSTableBlockHandle       resident_;   // earlier formats: every entry
     BloomFilter              bloom_;
 };
 
+// A loaded table is never modified, so it is shared: a compaction keeps its
+// inputs alive after the store's table lists have moved on.
+using SSTableHandle = std::shared_ptr<const SSTableReader>;
+
 #endif // STDB_SSTABLE_H
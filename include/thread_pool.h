@@ -0,0 +1,55 @@
+#ifndef STDB_THREAD_POOL_H
+#define STDB_THREAD_POOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Fixed-size pool of worker threads running submitted tasks in FIFO order.
+//
+// submit() returns a future for the task's result; an exception thrown by
+// the task is delivered through that future. The destructor runs every task
+// already queued, then joins the workers.
+class ThreadPool {
+public:
+    // threads == 0 → one per hardware thread (at least 1).
+    explicit ThreadPool(size_t threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t size() const { return workers_.size(); }
+
+    template <class F>
+    std::future<std::invoke_result_t<F>> submit(F&& fn) {
+        using R = std::invoke_result_t<F>;
+        // std::function needs a copyable target; packaged_task is move-only.
+        auto task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(fn));
+        std::future<R> result = task->get_future();
+        {
+            std::lock_guard<std::mutex> lock(mu_);
+            tasks_.emplace_back([task] { (*task)(); });
+        }
+        cv_.notify_one();
+        return result;
+    }
+
+private:
+    void worker_loop();
+
+    std::vector<std::thread>          workers_;
+    std::mutex                        mu_;
+    std::condition_variable           cv_;
+    std::deque<std::function<void()>> tasks_;
+    bool                              stop_ = false;
+};
+
+#endif // STDB_THREAD_POOL_H
@@ -1,32 +1,102 @@
 #ifndef STDB_VLOG_H
 #define STDB_VLOG_H
 
+#include "io_backend.h"
+
 #include <cstdint>
+#include <functional>
 #include <string>
+#include <string_view>
+#include <vector>
 
 // Pointer to a value stored in the Value Log.
 struct VLogPointer {
-    uint32_t file_id;   // 0 in Phase 2 (single file)
+    uint32_t file_id;   // VLog::file_id() of the log holding the value
     uint64_t offset;    // byte offset of record start (value_size field)
     uint32_t length;    // value bytes (excluding 4-byte size header)
 };
 
+// One record for a keyed (log-mode) group append. For tombstones `value`
+// is ignored. batch_size > 0 on the first record of a WriteBatch wraps that
+// record and the following batch_size - 1 records in one batch envelope.
+struct VLogRecordRef {
+    std::string_view key;
+    std::string_view value;
+    uint64_t         seq = 0;
+    bool             is_tombstone = false;
+    uint32_t         batch_size = 0;
+};
+
+// One recovered keyed record (see VLog::scan_keyed).
+struct VLogScanEntry {
+    std::string_view key;
+    VLogPointer      pointer;       // addresses the value; tombstones use the sentinel
+    uint64_t         seq;
+    bool             is_tombstone;
+};
+
 // Append-only Value Log for WiscKey key-value separation.
 //
 // Record format: [uint32_t value_size][value_bytes]
 //
+// Keyed record format (Options::vlog_as_wal — the VLog doubles as the WAL):
+//   [uint32_t 0xFFFFFFF3][uint32_t key_size][uint64_t seq][uint32_t checksum]
+//   [key bytes][uint32_t value_size][value_bytes]
+//   value_size = 0xFFFFFFFF marks a tombstone (no value bytes follow). The
+//   checksum is CRC32C over (key_size, seq, value_size, key, value). Pointers
+//   address the embedded [value_size][value_bytes] tail, so read_at() is
+//   identical for both record kinds.
+//
+// Batch envelope (atomic WriteBatch in log mode):
+//   [uint32_t 0xFFFFFFF4][uint32_t count][uint32_t payload_size][uint32_t checksum]
+//   [payload: count keyed records]   — checksum is CRC32C over the payload.
+//
+// Records written before checksum types existed use markers 0xFFFFFFF1 /
+// 0xFFFFFFF2 with IEEE CRC32; they are still scanned, never written.
+//
+// The markers exceed any legal value_size, so plain and keyed records can be
+// told apart while scanning and may share one file.
+//
 // Offset is tracked via an internal current_offset_ variable (user-space).
 // NEVER derived from lseek on the file descriptor.
 class VLog {
 public:
-    explicit VLog(const std::string& path);
+    // All reads, writes and syncs go through `io` (nullptr → POSIX).
+    // Every pointer the log hands out carries `file_id`.
+    explicit VLog(const std::string& path, IOBackend* io = nullptr, uint32_t file_id = 0);
     ~VLog();
 
     VLog(const VLog&) = delete;
     VLog& operator=(const VLog&) = delete;
 
     // Append value, return pointer. Returns false on I/O error.
-    bool append(const std::string& value, VLogPointer& out_pointer);
+    bool append(std::string_view value, VLogPointer& out_pointer);
+
+    // Append several values with a single contiguous write (group commit).
+    // out_pointers[i] addresses values[i]. Returns false on I/O error, in
+    // which case no pointer is produced and the offset is not advanced.
+    // With `sync`, the fdatasync is submitted together with the write.
+    bool append_group(const std::vector<std::string_view>& values,
+                      std::vector<VLogPointer>& out_pointers, bool sync = false);
+
+    // Append keyed records with a single contiguous write. out_pointers[i]
+    // addresses the value of records[i] (unspecified for tombstones).
+    bool append_keyed_group(const std::vector<VLogRecordRef>& records,
+                            std::vector<VLogPointer>& out_pointers, bool sync = false);
+
+    // Scan keyed records from byte `from` to EOF in log order, calling fn for
+    // each valid one (plain records are skipped). Batches are delivered all or
+    // nothing. Stops at the first torn / corrupt record; returns the offset
+    // just past the last valid record. Views are valid only during fn.
+    uint64_t scan_keyed(uint64_t from,
+                        const std::function<void(const VLogScanEntry&)>& fn) const;
+
+    // Cut the file back to `offset` (torn tail after a crash).
+    bool truncate(uint64_t offset);
+
+    // Offset at which the next append will land.
+    uint64_t tail_offset() const { return current_offset_; }
+    uint32_t file_id() const { return file_id_; }
 
     // Flush to stable storage. Returns false on error.
     bool sync();
@@ -34,11 +104,36 @@ public:
     // Read value at pointer. Returns false on error.
     bool read_at(const VLogPointer& pointer, std::string& out_value) const;
 
+    // Read many values with one batched submission. ok[i] reports whether
+    // out_values[i] was read and passed the size check.
+    void read_batch(const std::vector<VLogPointer>& pointers,
+                    std::vector<std::string>& out_values, std::vector<bool>& ok) const;
+
+    static constexpr uint32_t KEYED_MARKER        = 0xFFFFFFF1;   // IEEE CRC32 (read only)
+    static constexpr uint32_t BATCH_MARKER        = 0xFFFFFFF2;   // IEEE CRC32 (read only)
+    static constexpr uint32_t KEYED_MARKER_CRC32C = 0xFFFFFFF3;
+    static constexpr uint32_t BATCH_MARKER_CRC32C = 0xFFFFFFF4;
+    static constexpr uint32_t TOMBSTONE_SIZE      = 0xFFFFFFFF;
+    static constexpr uint32_t MAX_SCAN_FIELD      = 256u * 1024u * 1024u;  // corruption guard
+
 private:
+    // Reads exactly len bytes at offset; false on short read / error.
+    bool read_exact_at(uint64_t offset, void* buf, size_t len) const;
+
+    // Decodes one keyed record from buf (file offset `base`). Returns the
+    // record length, or 0 if it is incomplete or fails its checksum.
+    static size_t decode_keyed(const uint8_t* buf, size_t len, uint64_t base,
+                               VLogScanEntry& out);
+
+    bool write_gathered(bool sync, const char* what);
+
+    IOBackend*  io_;
     std::string path_;
-    int         write_fd_;         // persistent fd (append mode)
+    uint32_t    file_id_;
+    int         write_fd_;         // persistent fd (positioned writes at current_offset_)
     int         read_fd_;          // persistent fd (read-only)
     uint64_t    current_offset_;   // user-space offset tracking
+    GatherBuffer gather_;          // reused by every append (no per-record allocation)
 };
 
 #endif // STDB_VLOG_H
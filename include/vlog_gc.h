@@ -5,10 +5,11 @@ class KVStore;
 
 // Runs Value Log Garbage Collection on the KVStore.
 //
-// 1. Rotates the current VLog to a GC target file.
+// 1. Rotates the current VLog to a GC target file, which stays readable
+//    until step 5.
 // 2. Iterates the entire LSM tree to find strictly the newest live versions of keys.
 // 3. Reads live values from the target old VLog.
-// 4. Rewrites them via standard `store->put(key, value)`.
+// 4. Rewrites them via standard `store->put(key, value)` and flushes them.
 // 5. Deletes the old VLog safely.
 void run_vlog_gc(KVStore* store);
 
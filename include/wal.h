@@ -1,32 +1,93 @@
 #ifndef STDB_WAL_H
 #define STDB_WAL_H
 
+#include "crc32.h"
+#include "io_backend.h"
+#include "thread_pool.h"
+
 #include <cstdint>
+#include <functional>
 #include <string>
+#include <string_view>
 #include <vector>
 
-// A single replayed WAL entry.
-struct WALEntry {
-    std::string key;
-    std::string value;
-    bool is_tombstone = false;
+// A single replayed WAL entry. The views point into the mapped log and are
+// valid only for the duration of the replay callback.
+struct WALEntryView {
+    std::string_view key;
+    std::string_view value;
+    bool             is_tombstone = false;
+    uint64_t         vlog_offset  = UINT64_MAX;  // where the value's VLog record should be
+                                                 // (see kVLogBase); UINT64_MAX if unknown
+};
+
+// value_size sentinels. Real values are bounded by MAX_FIELD_SIZE, so these
+// can never collide with a value length.
+static constexpr uint32_t WAL_TOMBSTONE_MARKER = 0xFFFFFFFF;
+static constexpr uint32_t WAL_BATCH_MARKER     = 0xFFFFFFFE;
+static constexpr uint32_t WAL_VLOG_BASE_MARKER = 0xFFFFFFFD;
+
+enum class WALRecordType : uint8_t { kValue, kTombstone, kBatch, kVLogBase };
+
+// Borrowed view of one record for group appends. The referenced bytes must
+// stay alive until append_group() returns. For kBatch, `value` holds the
+// encoded WriteBatch payload and `key` is unused. For kVLogBase, `key` holds
+// the 8-byte little-endian VLog offset and `value` is unused.
+struct WALRecordRef {
+    std::string_view key;
+    std::string_view value;
+    WALRecordType    type = WALRecordType::kValue;
 };
 
 // Result of a WAL replay operation.
 struct ReplayResult {
-    std::vector<WALEntry> entries;     // valid, checksum-verified records
-    bool                  tainted;     // true if replay stopped due to corruption
+    size_t                entries = 0;     // entries delivered (batch operations count singly)
+    bool                  tainted = false; // true if replay stopped due to corruption
+    uint64_t              valid_bytes = 0; // end offset of the last valid record
+    uint32_t              log_number = 0;  // 0 for legacy (headerless) files
 };
 
 // Write-Ahead Log — append-only, CRC32-validated, crash-safe.
 //
+// File header (16 bytes):
+//   [uint32_t magic "SWAL"][uint32_t version = 4][uint32_t log_number][uint32_t checksum_type]
+//   checksum_type is a ChecksumType (crc32.h); new logs use CRC32C. Version 2
+//   headers have 0 there and are read as IEEE CRC32. Version 3 logs have no
+//   VLog base records.
+//
 // Record format (binary, little-endian, no padding):
 //   [uint32_t key_size]
 //   [uint32_t value_size]  — NOTE: 0xFFFFFFFF explicitly indicates a TOMBSTONE (delete marker).
-//   [uint32_t checksum]    — CRC32 over (key_size, value_size, key, value)
+//   [uint32_t log_number]  — must equal the header's; anything else is stale
+//   [uint32_t checksum]    — checksum_type over (log_number, key_size, value_size, key, value)
 //   [key_size bytes]       — key
 //   [value_size bytes]     — value
 //
+// Batch record (value_size = 0xFFFFFFFE):
+//   [uint32_t payload_size][0xFFFFFFFE][uint32_t log_number][uint32_t checksum][payload]
+//   The payload is an encoded WriteBatch (see write_batch.h) and the checksum
+//   covers (log_number, payload_size, marker, payload). Replay applies either
+//   every operation of a batch or none of them.
+//
+// VLog base record (value_size = 0xFFFFFFFD, version 4):
+//   [uint32_t 8][0xFFFFFFFD][uint32_t log_number][uint32_t checksum][uint64_t vlog_offset]
+//   Written ahead of a commit group's records: the group's values were
+//   appended to the VLog as plain records starting at vlog_offset, in record
+//   order (tombstones take no space). Replay reports the implied offset of
+//   each value in WALEntryView::vlog_offset so recovery can reuse values
+//   that reached the VLog instead of appending them again.
+//
+// Because every record names its log, a file may be preallocated (zeros)
+// or recycled from an obsolete log (old records): replay stops cleanly at
+// the first record whose log_number does not match. Appends then overwrite
+// already-allocated blocks and fdatasync no longer has to persist a new
+// file size.
+//
+// Legacy files (written before the header existed) have no header and no
+// log_number field; they are detected by the missing magic, replayed and
+// appended to in the old format (IEEE CRC32). An existing log always keeps
+// its own checksum type; only new or recycled logs get CRC32C.
+//
 // File descriptor is kept open for the lifetime of the WAL object.
 //
 // Memory safety note: replay allocates key/value buffers sized by the
@@ -37,8 +98,14 @@ struct ReplayResult {
 // measure — it is NOT a substitute for file-level access control.
 class WAL {
 public:
-    // Opens (or creates) the WAL file at the given path.
-    explicit WAL(const std::string& path);
+    // Opens (or creates) the WAL file at the given path. A new file gets a
+    // header for `log_number` (must be > 0) and, if preallocate_bytes > 0,
+    // is extended to that size up front. An existing file keeps its own
+    // header; appends continue at its current end of file, so callers must
+    // cut any stale / torn tail off first (see KVStore::recover()).
+    // All writes and syncs go through `io` (nullptr → POSIX).
+    explicit WAL(const std::string& path, uint32_t log_number = 1,
+                 uint64_t preallocate_bytes = 0, IOBackend* io = nullptr);
 
     // Closes the file descriptor.
     ~WAL();
@@ -54,25 +121,72 @@ public:
     // Append a tombstone record.
     bool append_delete(const std::string& key);
 
+    // Append an encoded WriteBatch payload as one checksummed batch record.
+    bool append_batch(std::string_view payload);
+
+    // Append several records with a single write (group commit).
+    // Records are laid out back-to-back exactly as individual appends would
+    // be, so replay is unchanged. With `sync`, the fdatasync is submitted
+    // together with (and ordered after) the write. Returns false on I/O error.
+    bool append_group(const std::vector<WALRecordRef>& records, bool sync = false);
+
+    // Reuse this (obsolete) log as `new_path` with a new, higher log number:
+    // the header is rewritten in place and synced, then the file is renamed
+    // and appends restart right after the header. Old records stay on disk
+    // but no longer match the log number. Requires recyclable().
+    bool recycle(const std::string& new_path, uint32_t new_log_number);
+
+    // Extend the file with allocated, zeroed space up to `bytes` total.
+    bool preallocate(uint64_t bytes);
+
     // Flush to stable storage (fdatasync / platform equivalent).
     // Returns false if fsync fails (caller must NOT proceed to memtable).
     bool sync();
 
-    // Replay the WAL from byte 0. Returns valid entries + tainted flag.
-    // Stops at the first invalid / incomplete / corrupt record.
+    // Replay the WAL from its first record, calling fn for every valid,
+    // checksum-verified entry in log order (a batch's operations
+    // consecutively, and only if the whole batch verifies). Stops at the
+    // first invalid / incomplete / corrupt record. The file is mapped, and
+    // checksums of upcoming chunks are verified on `pool` (nullptr → on
+    // this thread) while fn consumes earlier ones; fn itself always runs
+    // on the calling thread.
     // This is a read-only operation — the WAL file is not modified.
-    ReplayResult replay() const;
+    ReplayResult replay(const std::function<void(const WALEntryView&)>& fn,
+                        ThreadPool* pool = nullptr) const;
 
     // True if the last replay encountered corruption before EOF.
     bool is_tainted() const { return tainted_; }
 
+    // True for headered logs, whose records carry a log number.
+    bool     recyclable() const { return log_number_ != 0; }
+    uint32_t log_number() const { return log_number_; }
+    ChecksumType checksum_type() const { return checksum_; }
+
+    // True if this log may carry kVLogBase records (version 4 and later).
+    bool records_vlog_base() const { return version_ >= 4; }
+
+    static constexpr uint32_t HEADER_MAGIC   = 0x4C415753;  // "SWAL"
+    static constexpr uint32_t FORMAT_VERSION = 4;
+    static constexpr uint32_t HEADER_SIZE    = 16;
+
+    // Size sanity bounds — corruption guards, not product constraints.
+    static constexpr uint32_t MAX_FIELD_SIZE = 64u * 1024u * 1024u;  // 64 MiB
+    static constexpr uint32_t MAX_BATCH_SIZE = 256u * 1024u * 1024u; // 256 MiB
+
 private:
-    std::string path_;
-    int         fd_;       // persistent file descriptor (append mode)
-    bool        tainted_;  // set by replay if corruption detected
+    bool write_header(uint32_t log_number);
+    static bool parse_header(const uint32_t header[4], ChecksumType& out);
+    bool write_gathered(const char* what, bool sync = false);
 
-    // Size sanity bound — corruption guard, not a product constraint.
-    static constexpr uint32_t MAX_FIELD_SIZE = 64u * 1024u * 1024u; // 64 MiB
+    IOBackend*  io_;
+    std::string path_;
+    int         fd_;          // persistent file descriptor (read/write)
+    bool        tainted_;     // set by replay if corruption detected
+    uint32_t    log_number_;  // 0 → legacy headerless file
+    ChecksumType checksum_;   // of this file's records
+    uint32_t    version_;     // format version (0 → legacy headerless file)
+    uint64_t    offset_;      // next append position (user-space, not lseek)
+    GatherBuffer gather_;     // reused by every append (no per-record allocation)
 };
 
 #endif // STDB_WAL_H
@@ -0,0 +1,74 @@
+#ifndef STDB_WRITE_BATCH_H
+#define STDB_WRITE_BATCH_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// An ordered set of puts and deletes applied atomically by KVStore::write().
+//
+// The batch keeps its operations pre-encoded in a single buffer (rep_), which
+// is exactly the payload of the WAL batch record — committing a batch copies
+// no per-operation state.
+//
+// Payload format:
+//   [uint32_t count]
+//   count × [uint8_t type][uint32_t key_size][uint32_t value_size][key][value]
+//
+// type is kTypeValue or kTypeDeletion; deletions carry value_size = 0.
+class WriteBatch {
+public:
+    static constexpr uint8_t kTypeDeletion = 0;
+    static constexpr uint8_t kTypeValue    = 1;
+
+    WriteBatch() { clear(); }
+
+    void put(std::string_view key, std::string_view value);
+    void delete_key(std::string_view key);
+    void clear();
+
+    uint32_t count() const;
+    bool     empty() const { return count() == 0; }
+
+    // Encoded payload (what goes into the WAL record).
+    const std::string& rep() const { return rep_; }
+
+    // Calls fn(type, key, value) for every operation in insertion order.
+    // Views point into the batch payload.
+    template <typename Fn>
+    bool for_each(Fn&& fn) const { return for_each_in(rep_, fn); }
+
+    // Decode an encoded payload. Returns false if it is malformed.
+    template <typename Fn>
+    static bool for_each_in(std::string_view payload, Fn&& fn);
+
+private:
+    void append_op(uint8_t type, std::string_view key, std::string_view value);
+
+    std::string rep_;
+};
+
+template <typename Fn>
+bool WriteBatch::for_each_in(std::string_view payload, Fn&& fn) {
+    if (payload.size() < sizeof(uint32_t)) return false;
+    uint32_t count = 0;
+    payload.copy(reinterpret_cast<char*>(&count), sizeof(uint32_t), 0);
+
+    constexpr size_t op_header = 1 + sizeof(uint32_t) * 2;
+    size_t off = sizeof(uint32_t);
+    for (uint32_t i = 0; i < count; ++i) {
+        if (payload.size() - off < op_header) return false;
+        uint8_t  type = static_cast<uint8_t>(payload[off]);
+        uint32_t ks = 0, vs = 0;
+        payload.copy(reinterpret_cast<char*>(&ks), sizeof(uint32_t), off + 1);
+        payload.copy(reinterpret_cast<char*>(&vs), sizeof(uint32_t), off + 1 + sizeof(uint32_t));
+        off += op_header;
+        if (type != kTypeValue && type != kTypeDeletion) return false;
+        if (payload.size() - off < static_cast<size_t>(ks) + vs) return false;
+        fn(type, payload.substr(off, ks), payload.substr(off + ks, vs));
+        off += static_cast<size_t>(ks) + vs;
+    }
+    return off == payload.size();
+}
+
+#endif // STDB_WRITE_BATCH_H
@@ -6,13 +6,21 @@
 #include "bloom.h"
 #include "benchmark.h"
 #include "cli.h"
+#include "crc32.h"
+#include "merge_iterator.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cstdint>
+#include <cstdio>
 #include <cstring>
 #include <filesystem>
 #include <fstream>
+#include <map>
 #include <iostream>
+#include <chrono>
 #include <string>
+#include <thread>
 #include <vector>
 
 // ── Test helpers ───────────────────────────────────────────────
@@ -658,8 +666,1976 @@ static void test_bloom_invariant_disabling(const std::string& dir) {
     }
 }
 
+// ── Phase 6 Tests ──────────────────────────────────────────────
+
+static void test_group_commit(const std::string& dir) {
+    std::cout << "\n=== Test 27: Group Commit Across Concurrent Writers ===\n";
+    clean_dir(dir);
+
+    // Every write is kSync, so while a leader fsyncs the other writers
+    // queue up behind it and commit together.
+    const int threads = 16, per_thread = 50;
+    {
+        KVStore store(dir);
+        store.metrics().reset();
+        std::vector<std::thread> workers;
+        for (int t = 0; t < threads; ++t) {
+            workers.emplace_back([&store, t]() {
+                for (int i = 0; i < per_thread; ++i) {
+                    std::string k = "gc_t" + std::to_string(t) + "_" + std::to_string(i);
+                    if (i % 10 == 9) store.delete_key("gc_t" + std::to_string(t) + "_" + std::to_string(i - 1));
+                    else store.put(k, "v" + std::to_string(i));
+                }
+            });
+        }
+        for (auto& w : workers) w.join();
+
+        bool all_ok = true;
+        std::string v;
+        for (int t = 0; t < threads; ++t) {
+            for (int i = 0; i < per_thread; ++i) {
+                std::string k = "gc_t" + std::to_string(t) + "_" + std::to_string(i);
+                bool deleted = (i % 10 == 8), never_written = (i % 10 == 9);
+                bool found = store.get(k, v);
+                if (deleted || never_written) { if (found) all_ok = false; }
+                else if (!found || v != "v" + std::to_string(i)) all_ok = false;
+            }
+        }
+        expect_true(all_ok, "every concurrent put/delete is visible in queue order");
+        const auto& m = store.metrics();
+        std::cout << "  (" << threads * per_thread << " writes, " << m.wal_syncs << " WAL fsyncs, "
+                  << m.grouped_commits << " groups of several writers)\n";
+        expect_true(m.grouped_commits > 0, "concurrent writers were committed in shared groups");
+        expect_true(m.wal_syncs < static_cast<uint64_t>(threads * per_thread),
+                    "one WAL fsync per commit group, fewer than one per write");
+    }
+
+    {
+        KVStore store(dir);
+        std::string v;
+        bool ok = store.get("gc_t3_7", v) && v == "v7" && !store.get("gc_t5_8", v);
+        expect_true(ok, "group-committed records survive recovery");
+    }
+}
+
+static void test_write_batch_atomicity(const std::string& dir) {
+    std::cout << "\n=== Test 28: Atomic WriteBatch ===\n";
+    clean_dir(dir);
+
+    {
+        KVStore store(dir);
+        store.put("wb_old", "old");
+        store.metrics().reset();
+
+        WriteBatch batch;
+        for (int i = 0; i < 100; ++i) batch.put("wb_" + std::to_string(i), "v" + std::to_string(i));
+        batch.delete_key("wb_old");
+        batch.put("wb_7", "seven");   // later op in the same batch wins
+        store.write(batch);
+
+        std::string v;
+        store.get("wb_42", v); expect_eq(v, "v42", "batch put visible");
+        store.get("wb_7", v);  expect_eq(v, "seven", "last op for a key wins within a batch");
+        expect_true(!store.get("wb_old", v), "batch delete visible");
+        expect_true(store.metrics().wal_syncs == 1, "102 operations committed with a single WAL fsync");
+    }
+
+    std::string wal_file = find_wal_file(dir);
+    auto committed_size = std::filesystem::file_size(wal_file);
+    {
+        KVStore store(dir);
+        std::string v;
+        store.get("wb_99", v); expect_eq(v, "v99", "batch replayed after restart");
+        expect_true(!store.get("wb_old", v), "batch delete replayed after restart");
+
+        WriteBatch torn;
+        for (int i = 0; i < 50; ++i) torn.put("torn_" + std::to_string(i), "t");
+        torn.delete_key("wb_1");
+        store.write(torn);
+    }
+
+    // Chop the tail of the last batch record: replay must drop the whole batch.
+    auto full_size = std::filesystem::file_size(wal_file);
+    std::filesystem::resize_file(wal_file, committed_size + (full_size - committed_size) / 2);
+    {
+        KVStore store(dir);
+        std::string v;
+        expect_true(!store.get("torn_0", v) && !store.get("torn_49", v),
+                    "torn batch is not replayed at all");
+        store.get("wb_1", v);
+        expect_eq(v, "v1", "delete inside torn batch is not applied");
+    }
+}
+
+static void test_durability_modes(const std::string& dir) {
+    std::cout << "\n=== Test 29: Per-Write Durability Modes ===\n";
+    clean_dir(dir);
+
+    Options opts;
+    opts.sync_interval_ms = 20;
+    WriteOptions none_opts, periodic_opts;
+    none_opts.sync = SyncMode::kNone;
+    periodic_opts.sync = SyncMode::kPeriodic;
+
+    {
+        KVStore store(dir, opts);
+        store.metrics().reset();
+        for (int i = 0; i < 50; ++i) store.put("none_" + std::to_string(i), "n", none_opts);
+        expect_true(store.metrics().wal_syncs == 0 && store.metrics().background_syncs == 0,
+                    "kNone writes issue no fsync");
+
+        for (int i = 0; i < 50; ++i) store.put("per_" + std::to_string(i), "p", periodic_opts);
+        expect_true(store.metrics().wal_syncs == 0, "kPeriodic writes do not fsync inline");
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        expect_true(store.metrics().background_syncs >= 1, "background thread fsyncs kPeriodic writes");
+
+        store.put("sync_key", "s");
+        expect_true(store.metrics().wal_syncs == 1, "kSync write still fsyncs inline");
+    }
+
+    {
+        KVStore store(dir, opts);
+        std::string v;
+        bool ok = store.get("none_49", v) && store.get("per_49", v) && store.get("sync_key", v);
+        expect_true(ok, "clean close makes kNone / kPeriodic writes durable");
+    }
+
+    // Torn tail from an unsynced write: recovery must stop cleanly and new
+    // records must land after the last valid one, not behind the garbage.
+    const char junk[] = "TORN-UNSYNCED-RECORD";
+    append_raw_bytes(find_wal_file(dir), junk, sizeof(junk));
+    {
+        KVStore store(dir, opts);
+        std::string v;
+        expect_true(store.get("sync_key", v), "valid prefix survives torn tail");
+        store.put("after_torn", "ok", none_opts);
+    }
+    {
+        KVStore store(dir, opts);
+        std::string v;
+        store.get("after_torn", v);
+        expect_eq(v, "ok", "write after torn tail is replayed on next restart");
+        expect_true(!store.wal_tainted(), "torn tail was cut off by recovery");
+    }
+}
+
+static void test_vlog_as_wal(const std::string& dir) {
+    std::cout << "\n=== Test 30: VLog as Write-Ahead Log ===\n";
+    const std::string value(1000, 'v');
+
+    // Baseline: the same workload in WAL mode, for write amplification.
+    clean_dir(dir);
+    uint64_t wal_mode_bytes;
+    {
+        KVStore store(dir);
+        store.metrics().reset();
+        for (int i = 0; i < 100; ++i) store.put("k" + std::to_string(i), value);
+        wal_mode_bytes = store.metrics().storage_bytes_written;
+    }
+
+    clean_dir(dir);
+    Options opts;
+    opts.vlog_as_wal = true;
+    uint64_t log_mode_bytes;
+    {
+        KVStore store(dir, opts);
+        store.metrics().reset();
+        for (int i = 0; i < 100; ++i) store.put("k" + std::to_string(i), value);
+        log_mode_bytes = store.metrics().storage_bytes_written;
+
+        store.delete_key("k7");
+        WriteBatch batch;
+        batch.put("b1", "one");
+        batch.put("b2", "two");
+        batch.delete_key("k8");
+        store.write(batch);
+    }
+    expect_true(log_mode_bytes * 10 < wal_mode_bytes * 6,
+                "log mode writes each value once (storage bytes roughly halved)");
+    expect_true(!std::filesystem::exists(find_wal_file(dir)), "log mode creates no WAL file");
+
+    {
+        KVStore store(dir, opts);
+        std::string v;
+        expect_true(store.get("k99", v) && v == value, "value recovered from VLog tail");
+        expect_true(!store.get("k7", v), "tombstone recovered from VLog tail");
+        expect_true(store.get("b2", v) && v == "two" && !store.get("k8", v),
+                    "batch recovered from VLog tail");
+    }
+
+    // Torn tail: recovery stops at the last valid keyed record and later
+    // writes land after it.
+    const char junk[] = "\xF1\xFF\xFF\xFF-TORN-KEYED-RECORD";
+    append_raw_bytes(dir + "/vlog.bin", junk, sizeof(junk));
+    {
+        KVStore store(dir, opts);
+        std::string v;
+        expect_true(store.get("b1", v) && v == "one", "valid prefix survives torn VLog tail");
+        store.put("after_torn", "ok");
+    }
+    {
+        KVStore store(dir, opts);
+        std::string v;
+        store.get("after_torn", v);
+        expect_eq(v, "ok", "write after torn VLog tail is replayed on next restart");
+    }
+
+    // Switching modes either way keeps every write.
+    { KVStore store(dir); store.put("wal_key", "w"); }
+    {
+        KVStore store(dir, opts);
+        std::string v;
+        expect_true(store.get("wal_key", v) && v == "w" && store.get("k99", v),
+                    "reopen in log mode keeps WAL-mode writes");
+        expect_true(!std::filesystem::exists(find_wal_file(dir)), "stale WAL removed in log mode");
+        store.put("log_key", "l");
+    }
+    {
+        KVStore store(dir);
+        std::string v;
+        expect_true(store.get("log_key", v) && v == "l" && store.get("wal_key", v),
+                    "reopen in WAL mode keeps log-mode writes");
+    }
+}
+
+static void test_wal_recycling(const std::string& dir) {
+    std::cout << "\n=== Test 31: Preallocated and Recycled WAL Segments ===\n";
+    clean_dir(dir);
+
+    Options opts;
+    opts.recycle_wal = true;
+    opts.wal_segment_size = 1024 * 1024;
+    const std::string value = "recycled";
+    // Memtable size counts keys and pointers, so long keys force flushes.
+    auto key_of = [](int i) {
+        std::string k = "r_" + std::to_string(i);
+        k.resize(1000, 'k');
+        return k;
+    };
+    size_t unflushed = 0;
+    {
+        KVStore store(dir, opts);
+        expect_true(std::filesystem::file_size(find_wal_file(dir)) == opts.wal_segment_size,
+                    "new WAL is preallocated to the segment size");
+
+        // Enough data for two flushes: the first retires a log, the second
+        // switches into it.
+        for (int i = 0; i < 10000; ++i) store.put(key_of(i), value);
+        store.wait_for_flush();
+        unflushed = store.memtable_size();
+    }
+
+    size_t wal_count = 0;
+    for (auto& e : std::filesystem::directory_iterator(dir))
+        if (e.path().filename().string().substr(0, 4) == "wal_") wal_count++;
+    expect_true(wal_count == 1, "rotation leaves exactly one WAL file");
+    expect_true(find_wal_file(dir) != dir + "/wal_000001.log", "active WAL was renamed forward");
+    expect_true(std::filesystem::file_size(find_wal_file(dir)) > opts.wal_segment_size,
+                "rotated WAL reuses the old log's allocated blocks");
+
+    {
+        KVStore store(dir, opts);
+        expect_true(unflushed > 0 && store.memtable_size() == unflushed,
+                    "recycled log replays only records of its own log number");
+        std::string v;
+        bool all = true;
+        for (int i = 0; i < 10000; i += 97)
+            all = all && store.get(key_of(i), v) && v == value;
+        expect_true(all, "every key readable after recovery from a recycled log");
+        store.put("after_reopen", "ok");
+    }
+    {
+        KVStore store(dir);   // recycling off: same files stay readable
+        std::string v;
+        store.get("after_reopen", v);
+        expect_eq(v, "ok", "recycled log readable without recycle_wal");
+    }
+}
+
+static void test_io_backends(const std::string& dir) {
+    std::cout << "\n=== Test 32: Pluggable I/O Backends (POSIX / io_uring) ===\n";
+
+    for (IOBackendKind kind : {IOBackendKind::kPosix, IOBackendKind::kIoUring}) {
+        clean_dir(dir);
+        Options opts;
+        opts.io_backend = kind;
+        std::string name;
+        auto key_of = [](int i) {
+            std::string k = "io_" + std::to_string(i);
+            k.resize(1000, 'k');   // long keys force a flush (SST write path)
+            return k;
+        };
+        {
+            KVStore store(dir, opts);
+            name = store.io_backend_name();
+            std::cout << "  backend: " << name << "\n";
+            for (int i = 0; i < 5000; ++i) store.put(key_of(i), "v" + std::to_string(i));
+            store.delete_key(key_of(3));
+        }
+        {
+            KVStore store(dir, opts);
+            std::vector<std::string> keys = {key_of(0), key_of(3), "missing", key_of(4999), key_of(2500)};
+            std::vector<std::string> values;
+            std::vector<bool> found;
+            store.multi_get(keys, values, found);
+            bool ok = found[0] && values[0] == "v0" && !found[1] && !found[2] &&
+                      found[3] && values[3] == "v4999" && found[4] && values[4] == "v2500";
+            expect_true(ok, std::string("multi_get batch reads correct after restart (") + name + ")");
+
+            std::string v;
+            store.get(key_of(1234), v);
+            expect_eq(v, "v1234", std::string("single get through backend (") + name + ")");
+        }
+    }
+}
+
+static void test_zero_copy_appends(const std::string& dir) {
+    std::cout << "\n=== Test 33: Zero-Copy Scatter-Gather WAL/VLog Appends ===\n";
+
+    const std::string big(64 * 1024, 'z');
+    auto value_of = [&](int i) { std::string v = big; v[0] = static_cast<char>('a' + i % 26); return v; };
+
+    for (bool vlog_as_wal : {false, true}) {
+        clean_dir(dir);
+        Options opts;
+        opts.vlog_as_wal = vlog_as_wal;
+        std::string mode = vlog_as_wal ? "vlog-as-wal" : "wal";
+        const int n = 50;
+        {
+            KVStore store(dir, opts);
+            WriteOptions wo;
+            wo.sync = SyncMode::kNone;
+            uint64_t copied = GatherBuffer::copied_bytes();
+            uint64_t referenced = GatherBuffer::referenced_bytes();
+            for (int i = 0; i < n; ++i) store.put("zc_" + std::to_string(i), value_of(i), wo);
+            copied = GatherBuffer::copied_bytes() - copied;
+            referenced = GatherBuffer::referenced_bytes() - referenced;
+            std::cout << "  " << mode << ": " << copied / n << " bytes copied/put, "
+                      << referenced / n << " referenced/put\n";
+            expect_true(copied / n < 256,
+                        "64 KiB put copies only record headers (" + mode + ")");
+            expect_true(referenced >= static_cast<uint64_t>(n) * big.size(),
+                        "values reach the file by reference (" + mode + ")");
+
+            WriteBatch batch;
+            batch.put("zc_batch_a", value_of(1));
+            batch.put("zc_batch_b", "small");
+            batch.delete_key("zc_0");
+            store.write(batch);
+        }
+        {
+            KVStore store(dir, opts);
+            std::string v;
+            bool ok = true;
+            for (int i = 1; i < n; ++i) ok = ok && store.get("zc_" + std::to_string(i), v) && v == value_of(i);
+            expect_true(ok, "gathered records replay intact after restart (" + mode + ")");
+            ok = store.get("zc_batch_a", v) && v == value_of(1) &&
+                 store.get("zc_batch_b", v) && v == "small" && !store.get("zc_0", v);
+            expect_true(ok, "gathered batch replays atomically (" + mode + ")");
+        }
+    }
+}
+
+static void test_checksum_types(const std::string& dir) {
+    std::cout << "\n=== Test 34: CRC32C Checksums and Legacy CRC32 Files ===\n";
+    std::cout << "  crc32c implementation: " << crc32c_implementation() << "\n";
+
+    const std::string check = "123456789";
+    expect_true(compute_crc32(reinterpret_cast<const uint8_t*>(check.data()), check.size()) == 0xCBF43926,
+                "CRC32 (IEEE) check value");
+    expect_true(crc32c_extend(0, check.data(), check.size()) == 0xE3069283 &&
+                crc32c_extend_portable(0, check.data(), check.size()) == 0xE3069283,
+                "CRC32C check value (dispatched and slicing-by-8)");
+
+    // Every length / split point: dispatched == portable, incremental == one-shot.
+    std::string data(1031, '\0');
+    for (size_t i = 0; i < data.size(); ++i) data[i] = static_cast<char>(i * 131 + 7);
+    bool same = true;
+    for (size_t len = 0; len <= data.size() && same; len += 17) {
+        uint32_t whole = crc32c_extend_portable(0, data.data(), len);
+        size_t cut = len / 3;
+        uint32_t split = crc32c_extend(crc32c_extend(0, data.data(), cut), data.data() + cut, len - cut);
+        same = whole == crc32c_extend(0, data.data(), len) && whole == split &&
+               crc32_extend(crc32_extend(0, data.data(), cut), data.data() + cut, len - cut) ==
+                   compute_crc32(reinterpret_cast<const uint8_t*>(data.data()), len);
+    }
+    expect_true(same, "hardware, slicing-by-8 and incremental checksums agree");
+
+    // Version-2 WAL (IEEE CRC32, no checksum type) replays and stays IEEE.
+    clean_dir(dir);
+    std::filesystem::create_directories(dir);
+    std::string wal_file = dir + "/wal_000001.log";
+    uint32_t header[4] = {WAL::HEADER_MAGIC, 2, 1, 0};
+    append_raw_bytes(wal_file, header, sizeof(header));
+    std::string key = "legacy_wal", value = "ieee";
+    uint32_t rec[4] = {static_cast<uint32_t>(key.size()), static_cast<uint32_t>(value.size()), 1,
+                       record_checksum(ChecksumType::kCRC32, 1, static_cast<uint32_t>(key.size()),
+                                       static_cast<uint32_t>(value.size()), key, value)};
+    append_raw_bytes(wal_file, rec, sizeof(rec));
+    append_raw_bytes(wal_file, key.data(), key.size());
+    append_raw_bytes(wal_file, value.data(), value.size());
+    {
+        WAL wal(wal_file);
+        expect_true(wal.checksum_type() == ChecksumType::kCRC32, "v2 WAL keeps IEEE CRC32 for appends");
+    }
+    {
+        KVStore store(dir);
+        std::string v;
+        store.get(key, v);
+        expect_eq(v, "ieee", "v2 (IEEE) WAL record recovered");
+        store.put("new_key", "crc32c");
+    }
+    {
+        KVStore store(dir);
+        std::string v;
+        bool ok = store.get(key, v) && v == "ieee" && store.get("new_key", v) && v == "crc32c";
+        expect_true(ok, "appends to a v2 WAL replay after restart");
+    }
+    {
+        clean_dir(dir);
+        std::filesystem::create_directories(dir);
+        WAL wal(dir + "/fresh.log");
+        expect_true(wal.checksum_type() == ChecksumType::kCRC32C, "new WAL is stamped CRC32C");
+    }
+
+    // Legacy SSTable: 16-byte footer, IEEE CRC32 over data, no bloom.
+    std::string sst_file = dir + "/sst_000001.sst";
+    {
+        std::vector<uint8_t> bytes;
+        auto put32 = [&](uint32_t x) { bytes.insert(bytes.end(), (uint8_t*)&x, (uint8_t*)&x + 4); };
+        std::string k = "legacy_sst";
+        put32(static_cast<uint32_t>(k.size()));
+        bytes.insert(bytes.end(), k.begin(), k.end());
+        put32(0);
+        uint64_t off = 4242;
+        bytes.insert(bytes.end(), (uint8_t*)&off, (uint8_t*)&off + 8);
+        put32(7);
+        uint32_t footer[4] = {1, static_cast<uint32_t>(bytes.size()), 0,
+                              compute_crc32(bytes.data(), bytes.size())};
+        append_raw_bytes(sst_file, bytes.data(), bytes.size());
+        append_raw_bytes(sst_file, footer, sizeof(footer));
+    }
+    {
+        SSTableReader r;
+        VLogPointer p{};
+        bool ok = r.load(sst_file) && r.get("legacy_sst", p) == SSTableLookup::kFound && p.offset == 4242 && p.length == 7;
+        expect_true(ok, "legacy (IEEE, 16-byte footer) SSTable loads");
+
+        std::map<std::string, VLogPointer> entries{{"a", {0, 1, 2}}, {"b", {0, 3, 4}}};
+        std::string fresh = dir + "/sst_000002.sst";
+        SSTableReader r2;
+        ok = SSTableWriter::write(fresh, entries) && r2.load(fresh) && r2.get("b", p) == SSTableLookup::kFound && p.offset == 3;
+        expect_true(ok, "CRC32C SSTable round-trips");
+
+        std::fstream f(fresh, std::ios::in | std::ios::out | std::ios::binary);
+        f.seekp(0);
+        f.put(0x7F);
+        f.close();
+        SSTableReader r3;
+        expect_true(!r3.load(fresh), "corrupt CRC32C SSTable rejected");
+    }
+
+    // Legacy keyed VLog record (marker 0xFFFFFFF1, IEEE CRC32) still scans.
+    {
+        std::string vlog_file = dir + "/legacy.vlog";
+        std::string k = "legacy_vlog", v = "old";
+        uint32_t ks = static_cast<uint32_t>(k.size()), vs = static_cast<uint32_t>(v.size());
+        uint64_t seq = 9;
+        uint32_t crc = crc32_extend(0, &ks, 4);
+        crc = crc32_extend(crc, &seq, 8);
+        crc = crc32_extend(crc, &vs, 4);
+        crc = crc32_extend(crc, k.data(), k.size());
+        crc = crc32_extend(crc, v.data(), v.size());
+        uint32_t marker = VLog::KEYED_MARKER;
+        append_raw_bytes(vlog_file, &marker, 4);
+        append_raw_bytes(vlog_file, &ks, 4);
+        append_raw_bytes(vlog_file, &seq, 8);
+        append_raw_bytes(vlog_file, &crc, 4);
+        append_raw_bytes(vlog_file, k.data(), k.size());
+        append_raw_bytes(vlog_file, &vs, 4);
+        append_raw_bytes(vlog_file, v.data(), v.size());
+
+        VLog vlog(vlog_file);
+        VLogPointer ptr{};
+        std::vector<VLogPointer> ptrs;
+        vlog.append_keyed_group({{"new_vlog", "crc32c", 10}}, ptrs);
+        int seen = 0;
+        std::string got;
+        uint64_t end = vlog.scan_keyed(0, [&](const VLogScanEntry& e) {
+            ++seen;
+            if (e.key == "legacy_vlog") ptr = e.pointer;
+        });
+        bool ok = seen == 2 && end == vlog.tail_offset() && vlog.read_at(ptr, got) && got == "old";
+        expect_true(ok, "legacy CRC32 and new CRC32C keyed VLog records scan together");
+    }
+    clean_dir(dir);
+}
+
+static void test_parallel_wal_replay(const std::string& dir) {
+    std::cout << "\n=== Test 35: Parallel mmap WAL Replay ===\n";
+    clean_dir(dir);
+
+    const int n = 40000;
+    auto value_of = [](int i) { return std::string(200, static_cast<char>('a' + i % 26)) + std::to_string(i); };
+    {
+        KVStore store(dir);
+        WriteOptions wo;
+        wo.sync = SyncMode::kNone;
+        for (int i = 0; i < n; ++i) {
+            if (i % 1000 == 999) {
+                WriteBatch batch;
+                batch.put("pr_" + std::to_string(i), value_of(i));
+                batch.delete_key("pr_" + std::to_string(i - 1));
+                store.write(batch, wo);
+            } else {
+                store.put("pr_" + std::to_string(i), value_of(i), wo);
+            }
+        }
+    }
+
+    // Same entries, values, order and end offset with and without the pool.
+    auto mix = [](uint64_t& digest, std::string_view bytes) {
+        for (char c : bytes) digest = (digest ^ static_cast<uint8_t>(c)) * 1099511628211ull;
+        digest = (digest ^ bytes.size()) * 1099511628211ull;
+    };
+    std::string wal_file = find_wal_file(dir);
+    auto replay_digest = [&](ThreadPool* pool, ReplayResult& result) {
+        uint64_t digest = 1469598103934665603ull;
+        WAL wal(wal_file);
+        result = wal.replay([&](const WALEntryView& e) {
+            mix(digest, e.key);
+            mix(digest, e.value);
+            digest = (digest ^ (e.is_tombstone ? 0x100 : 0)) * 1099511628211ull;
+        }, pool);
+        return digest;
+    };
+    ThreadPool pool(4);
+    ReplayResult serial, parallel;
+    uint64_t d_serial = replay_digest(nullptr, serial);
+    uint64_t d_parallel = replay_digest(&pool, parallel);
+    expect_true(!serial.tainted && serial.entries == static_cast<size_t>(n) + n / 1000,
+                "serial replay delivers every entry (" + std::to_string(serial.entries) + ")");
+    expect_true(d_serial == d_parallel && serial.entries == parallel.entries &&
+                serial.valid_bytes == parallel.valid_bytes && !parallel.tainted,
+                "parallel replay delivers the same entries in the same order");
+
+    {
+        Options opts;
+        opts.recovery_threads = 4;
+        auto start = std::chrono::steady_clock::now();
+        KVStore store(dir, opts);
+        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - start).count();
+        std::cout << "  recovered " << n << " records in " << ms << " ms\n";
+        // Every key's value bytes, read back through get(), against what
+        // was written: a value attached to the wrong key changes the digest.
+        uint64_t got = 1469598103934665603ull, want = got;
+        std::string v;
+        for (int i = 0; i < n; ++i) {
+            std::string key = "pr_" + std::to_string(i);
+            bool deleted = (i % 1000 == 998);
+            mix(got, key);
+            mix(want, key);
+            if (store.get(key, v)) mix(got, v);
+            if (!deleted) mix(want, value_of(i));
+        }
+        expect_true(got == want, "store recovered through the pool serves every value");
+    }
+
+    // A flipped byte mid-log: both paths stop at the same record.
+    auto wal_size = std::filesystem::file_size(wal_file);
+    {
+        std::fstream f(wal_file, std::ios::in | std::ios::out | std::ios::binary);
+        f.seekg(static_cast<std::streamoff>(wal_size / 2));
+        char c = 0;
+        f.get(c);
+        f.seekp(static_cast<std::streamoff>(wal_size / 2));
+        f.put(static_cast<char>(c ^ 0x5A));
+    }
+    d_serial = replay_digest(nullptr, serial);
+    d_parallel = replay_digest(&pool, parallel);
+    expect_true(serial.tainted && parallel.tainted && serial.entries == parallel.entries &&
+                serial.valid_bytes == parallel.valid_bytes && d_serial == d_parallel &&
+                serial.entries > 0 && serial.entries < static_cast<size_t>(n),
+                "corruption stops serial and parallel replay at the same record");
+    clean_dir(dir);
+}
+
+static void test_recovery_reuses_vlog(const std::string& dir) {
+    std::cout << "\n=== Test 36: Recovery Reuses Values Already in the VLog ===\n";
+    clean_dir(dir);
+
+    const int n = 500;
+    auto value_of = [](int i) { return std::string(1000, static_cast<char>('A' + i % 26)) + std::to_string(i); };
+    auto all_values_ok = [&](KVStore& store) {
+        std::string v;
+        for (int i = 0; i < n; ++i)
+            if (!store.get("rv_" + std::to_string(i), v) || v != value_of(i)) return false;
+        return true;
+    };
+    {
+        KVStore store(dir);
+        WriteOptions wo;
+        wo.sync = SyncMode::kNone;
+        for (int i = 0; i < n; ++i) {
+            if (i % 100 == 50) {
+                WriteBatch batch;
+                batch.put("rv_" + std::to_string(i), value_of(i));
+                batch.delete_key("rv_gone");
+                store.write(batch, wo);
+            } else {
+                store.put("rv_" + std::to_string(i), value_of(i), wo);
+            }
+        }
+    }
+
+    const std::string vlog_file = dir + "/vlog.bin";
+    auto size_before = std::filesystem::file_size(vlog_file);
+    for (int round = 0; round < 2; ++round) {
+        KVStore store(dir);
+        expect_true(all_values_ok(store), "values served after restart " + std::to_string(round + 1));
+    }
+    expect_true(std::filesystem::file_size(vlog_file) == size_before,
+                "two restarts append nothing to the VLog");
+
+    // Crash between the WAL write and the VLog write: the last values never
+    // reached the VLog. Only they are appended again.
+    const uint64_t lost = 3 * (sizeof(uint32_t) + value_of(0).size()) + 10;
+    std::filesystem::resize_file(vlog_file, size_before - lost);
+    {
+        KVStore store(dir);
+        expect_true(all_values_ok(store), "values whose VLog write was lost are restored from the WAL");
+    }
+    auto size_after = std::filesystem::file_size(vlog_file);
+    expect_true(size_after > size_before - lost && size_after - (size_before - lost) < 5 * 1024,
+                "only the missing VLog tail is re-appended (" +
+                std::to_string(size_after - (size_before - lost)) + " bytes)");
+    clean_dir(dir);
+}
+
+static void test_background_flush(const std::string& dir) {
+    std::cout << "\n=== Test 37: Background Flush ===\n";
+    clean_dir(dir);
+
+    // Memtable size counts keys and pointers, so long keys force flushes.
+    auto key_of = [](int i) {
+        std::string k = "bf_" + std::to_string(i);
+        k.resize(1000, 'k');
+        return k;
+    };
+    const int n = 20000;
+    {
+        // About 5 memtables fill up; with room for 8 in the queue no write
+        // ever has to wait, however slow the flusher is.
+        Options opts;
+        opts.max_immutable_memtables = 8;
+        KVStore store(dir, opts);
+        WriteOptions wo;
+        wo.sync = SyncMode::kNone;
+        bool readable = true;
+        std::vector<double> put_us;
+        put_us.reserve(n);
+        for (int i = 0; i < n; ++i) {
+            auto start = std::chrono::steady_clock::now();
+            store.put(key_of(i), "v" + std::to_string(i), wo);
+            put_us.push_back(std::chrono::duration<double, std::micro>(
+                std::chrono::steady_clock::now() - start).count());
+            // Keys in a memtable being flushed stay visible throughout.
+            std::string v;
+            if (i % 50 == 0 && !(store.get(key_of(i / 2), v) && v == "v" + std::to_string(i / 2)))
+                readable = false;
+        }
+        expect_true(readable, "keys readable while their memtable is being flushed");
+
+        store.wait_for_flush();
+        const auto& m = store.metrics();
+        expect_true(m.background_flushes >= 4,
+                    "memtables flushed by the background thread (" +
+                    std::to_string(m.background_flushes) + ")");
+        std::sort(put_us.begin(), put_us.end());
+        std::cout << "  put latency p50 " << put_us[n / 2] << " us, p99 " << put_us[n * 99 / 100]
+                  << " us, max " << put_us.back() << " us; " << m.flush_waits
+                  << " writes waited for a flush\n";
+        expect_true(m.flush_waits == 0, "writes never wait while the flush queue has room");
+    }
+
+    size_t wal_count = 0;
+    for (auto& e : std::filesystem::directory_iterator(dir))
+        if (e.path().filename().string().substr(0, 4) == "wal_") wal_count++;
+    expect_true(wal_count == 1, "frozen WALs are retired once their SSTables commit");
+    {
+        KVStore store(dir);
+        std::string v;
+        bool all = true;
+        for (int i = 0; i < n; i += 37)
+            all = all && store.get(key_of(i), v) && v == "v" + std::to_string(i);
+        expect_true(all, "every key survives reopen");
+    }
+    clean_dir(dir);
+}
+
+static void test_background_compaction(const std::string& dir) {
+    std::cout << "\n=== Test 38: Background Compaction and Write Stalls ===\n";
+    clean_dir(dir);
+
+    // Memtable size counts keys and pointers, so long keys force flushes.
+    auto key_of = [](int i) {
+        std::string k = "bc_" + std::to_string(i % 15000);
+        k.resize(1000, 'k');
+        return k;
+    };
+    auto value_of = [](int i) { return "v" + std::to_string(i); };
+    const int n = 45000;   // ~11 memtables; every key overwritten twice
+    {
+        KVStore store(dir);
+        WriteOptions wo;
+        wo.sync = SyncMode::kNone;
+        bool readable = true;
+        for (int i = 0; i < n; ++i) {
+            store.put(key_of(i), value_of(i), wo);
+            // The newest write of key_of(i / 2) so far.
+            int newest = i - (i - i / 2) % 15000;
+            std::string v;
+            if (i % 100 == 0 && !(store.get(key_of(i / 2), v) && v == value_of(newest)))
+                readable = false;
+        }
+        expect_true(readable, "reads see the newest value while compaction runs");
+        store.wait_for_flush();
+
+        const auto& m = store.metrics();
+        expect_true(m.background_compactions >= 1,
+                    "L0 compacted by the background thread (" +
+                    std::to_string(m.background_compactions) + " runs)");
+        std::cout << "  " << m.write_slowdowns << " slowed and " << m.write_stops
+                  << " stopped commit groups, " << m.stall_micros << " us stalled\n";
+        expect_true(m.stall_micros > 0 || (m.write_slowdowns == 0 && m.write_stops == 0 && m.flush_waits == 0),
+                    "stall time accounted whenever writes were held back");
+    }
+    {
+        KVStore store(dir);
+        std::string v;
+        bool all = true;
+        for (int i = n - 15000; i < n; i += 41)
+            all = all && store.get(key_of(i), v) && v == value_of(i);
+        expect_true(all, "newest versions survive compaction and reopen");
+    }
+    clean_dir(dir);
+}
+
+static void test_concurrent_readers(const std::string& dir) {
+    std::cout << "\n=== Test 39: Concurrent Readers During Writes, Flushes and Compactions ===\n";
+    clean_dir(dir);
+
+    KVStore store(dir);
+    const int seeds = 2000;
+    auto seed_value = [](int i) { return "seed_value_" + std::to_string(i) + std::string(64, 's'); };
+    for (int i = 0; i < seeds; ++i) store.put("seed_" + std::to_string(i), seed_value(i));
+    store.metrics().reset();
+
+    std::atomic<bool> stop{false};
+    std::atomic<uint64_t> reads{0}, wrong{0};
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 4; ++t) {
+        readers.emplace_back([&, t] {
+            uint64_t n = 0;
+            for (int i = t; !stop.load(); i = (i + 7) % seeds) {
+                std::string v;
+                if (t == 0) {
+                    // multi_get counts one get call per key.
+                    std::vector<std::string> keys{"seed_" + std::to_string(i), "missing_" + std::to_string(i)};
+                    std::vector<std::string> values;
+                    std::vector<bool> found;
+                    store.multi_get(keys, values, found);
+                    if (!found[0] || values[0] != seed_value(i) || found[1]) wrong++;
+                    n += 2;
+                } else {
+                    if (!store.get("seed_" + std::to_string(i), v) || v != seed_value(i)) wrong++;
+                    n++;
+                }
+            }
+            reads += n;
+        });
+    }
+
+    // Long keys force several flushes and at least one compaction.
+    WriteOptions wo;
+    wo.sync = SyncMode::kNone;
+    for (int i = 0; i < 30000; ++i) {
+        std::string k = "cr_" + std::to_string(i);
+        k.resize(1000, 'k');
+        store.put(k, "v", wo);
+    }
+    store.wait_for_flush();
+    stop = true;
+    for (auto& t : readers) t.join();
+
+    const auto& m = store.metrics();
+    std::cout << "  " << reads.load() << " reads alongside " << m.background_flushes
+              << " flushes and " << m.background_compactions << " compactions\n";
+    expect_true(wrong.load() == 0, "every concurrent read saw the right value");
+    expect_true(m.background_flushes >= 4, "flushes ran while readers were active");
+    expect_true(m.get_calls == reads.load(), "get_calls counted exactly under contention");
+    clean_dir(dir);
+}
+
+static void test_skiplist_memtable() {
+    std::cout << "\n=== Test 40: Arena Skiplist Memtable ===\n";
+
+    Memtable mem;
+    const int threads = 4, per_thread = 5000;
+    auto key_of = [](int i) { return "sk_" + std::to_string(i); };
+    std::atomic<bool> reader_ok{true};
+    std::atomic<bool> done{false};
+
+    // A lock-free reader runs against the concurrent inserts: every key it
+    // finds must carry the pointer written for it.
+    std::thread reader([&] {
+        while (!done.load()) {
+            for (int i = 0; i < threads * per_thread; i += 13) {
+                VLogPointer p;
+                if (mem.get(key_of(i), p) && p.offset != static_cast<uint64_t>(i)) reader_ok = false;
+            }
+        }
+    });
+    std::vector<std::thread> writers;
+    for (int t = 0; t < threads; ++t) {
+        writers.emplace_back([&, t] {
+            for (int i = t; i < threads * per_thread; i += threads)
+                mem.put(key_of(i), VLogPointer{0, static_cast<uint64_t>(i), 1});
+        });
+    }
+    for (auto& w : writers) w.join();
+    done = true;
+    reader.join();
+    expect_true(reader_ok.load(), "lock-free reads during concurrent inserts see correct pointers");
+    expect_true(mem.size() == static_cast<size_t>(threads * per_thread), "every concurrent insert is present once");
+
+    bool sorted = true, all_found = true;
+    size_t n = 0;
+    std::string prev;
+    mem.for_each([&](std::string_view k, const VLogPointer&) {
+        if (n++ > 0 && !(prev < k)) sorted = false;
+        prev = std::string(k);
+    });
+    for (int i = 0; i < threads * per_thread; ++i) {
+        VLogPointer p;
+        all_found = all_found && mem.get(key_of(i), p) && p.offset == static_cast<uint64_t>(i);
+    }
+    expect_true(sorted && n == mem.size(), "for_each visits keys in strictly ascending order");
+    expect_true(all_found, "every key readable after concurrent inserts");
+
+    // Overwrites keep the key count but use arena space.
+    size_t before = mem.byte_size();
+    for (int round = 0; round < 10; ++round)
+        for (int i = 0; i < 1000; ++i) mem.put(key_of(i), VLogPointer{0, 7, 1});
+    VLogPointer p;
+    expect_true(mem.get(key_of(5), p) && p.offset == 7, "overwrite replaces the pointer");
+    expect_true(mem.size() == static_cast<size_t>(threads * per_thread), "overwrite adds no key");
+    expect_true(mem.byte_size() >= before + 10 * 1000 * sizeof(VLogPointer),
+                "byte_size() counts arena bytes used by overwrites");
+}
+
+static void test_hash_memtable(const std::string& dir) {
+    std::cout << "\n=== Test 41: Hash-Indexed Memtable ===\n";
+    clean_dir(dir);
+
+    // Few buckets force long chains, so collisions are exercised.
+    Memtable mem(MemtableRep::kHashIndex, 64);
+    const int threads = 4, per_thread = 3000, total = threads * per_thread;
+    auto key_of = [](int i) { return "hk_" + std::to_string(i); };
+    std::vector<std::thread> writers;
+    for (int t = 0; t < threads; ++t) {
+        writers.emplace_back([&, t] {
+            // Every key is written by two threads; the pointer is the same.
+            for (int i = t; i < total; i += threads / 2)
+                mem.put(key_of(i % total), VLogPointer{0, static_cast<uint64_t>(i % total), 1});
+        });
+    }
+    for (auto& w : writers) w.join();
+    bool all_found = true;
+    for (int i = 0; i < total; ++i) {
+        VLogPointer p;
+        all_found = all_found && mem.get(key_of(i), p) && p.offset == static_cast<uint64_t>(i);
+    }
+    expect_true(all_found, "hash lookups find every key after concurrent inserts");
+    expect_true(mem.size() == static_cast<size_t>(total), "racing puts of one key insert it once");
+    VLogPointer p;
+    expect_true(!mem.get("hk_missing", p), "absent key misses");
+
+    mem.put(key_of(3), VLogPointer{0, 99, 1});
+    expect_true(mem.get(key_of(3), p) && p.offset == 99, "overwrite visible through the hash index");
+    bool sorted = true;
+    size_t n = 0;
+    std::string prev;
+    mem.for_each([&](std::string_view k, const VLogPointer&) {
+        if (n++ > 0 && !(prev < k)) sorted = false;
+        prev = std::string(k);
+    });
+    expect_true(sorted && n == mem.size(), "for_each still yields sorted keys for flush");
+
+    // Point-lookup cost of both representations on the same keys.
+    Memtable skip_mem;
+    Memtable hash_mem(MemtableRep::kHashIndex);
+    const int lookups = 50000;
+    for (int i = 0; i < lookups; ++i) {
+        skip_mem.put(key_of(i), VLogPointer{0, static_cast<uint64_t>(i), 1});
+        hash_mem.put(key_of(i), VLogPointer{0, static_cast<uint64_t>(i), 1});
+    }
+    auto time_gets = [&](const Memtable& m) {
+        auto start = std::chrono::steady_clock::now();
+        uint64_t sum = 0;
+        for (int i = 0; i < lookups; ++i) {
+            VLogPointer q;
+            if (m.get(key_of((i * 7919) % lookups), q)) sum += q.offset;
+        }
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count();
+        return std::make_pair(sum, static_cast<double>(ns) / lookups);
+    };
+    auto [skip_sum, skip_ns] = time_gets(skip_mem);
+    auto [hash_sum, hash_ns] = time_gets(hash_mem);
+    std::cout << "  get: skiplist " << skip_ns << " ns/op, hash index " << hash_ns << " ns/op\n";
+    expect_true(skip_sum == hash_sum, "both representations return the same pointers");
+
+    // A store opened with the hash rep flushes and recovers like the default.
+    Options opts;
+    opts.memtable_rep = MemtableRep::kHashIndex;
+    opts.memtable_hash_buckets = 1024;
+    auto long_key = [&](int i) { std::string k = key_of(i); k.resize(300, 'h'); return k; };
+    {
+        KVStore store(dir, opts);
+        for (int i = 0; i < 20000; ++i) store.put(long_key(i), "value_" + std::to_string(i));
+        store.put(long_key(1), "updated");
+        store.delete_key(long_key(2));
+        store.wait_for_flush();
+        expect_true(store.metrics().background_flushes >= 1, "hash memtables flushed to SSTables");
+    }
+    {
+        KVStore store(dir, opts);
+        std::string v;
+        bool all = true;
+        for (int i = 3; i < 20000; i += 37)
+            all = all && store.get(long_key(i), v) && v == "value_" + std::to_string(i);
+        expect_true(all, "values survive flush and reopen");
+        expect_true(store.get(long_key(1), v) && v == "updated", "newest version wins");
+        expect_true(!store.get(long_key(2), v), "delete honoured");
+    }
+    clean_dir(dir);
+}
+
+static void test_immutable_memtable_queue(const std::string& dir) {
+    std::cout << "\n=== Test 42: Queued Immutable Memtables ===\n";
+    clean_dir(dir);
+
+    auto key_of = [](int i) {
+        std::string k = "iq_" + std::to_string(i);
+        k.resize(1000, 'k');
+        return k;
+    };
+    // Each round rewrites the same keys, so every memtable overlaps the
+    // others and a merged flush must keep the newest round.
+    const int keys = 4000, rounds = 6;
+    Options opts;
+    opts.max_immutable_memtables = 4;
+    opts.min_memtables_to_merge  = 2;
+    {
+        KVStore store(dir, opts);
+        WriteOptions wo;
+        wo.sync = SyncMode::kNone;
+        bool readable = true;
+        for (int r = 0; r < rounds; ++r) {
+            for (int i = 0; i < keys; i += 500) {
+                WriteBatch batch;
+                for (int j = i; j < i + 500; ++j)
+                    batch.put(key_of(j), "r" + std::to_string(r) + "_" + std::to_string(j));
+                store.write(batch, wo);
+                std::string v;
+                if (!(store.get(key_of(i), v) && v == "r" + std::to_string(r) + "_" + std::to_string(i)))
+                    readable = false;
+            }
+        }
+        expect_true(readable, "newest value readable while several memtables are queued");
+        store.wait_for_flush();
+        const auto& m = store.metrics();
+        std::cout << "  " << m.background_flushes << " memtables flushed, " << m.flush_merges
+                  << " merged flushes, " << m.flush_waits << " writes waited for the queue\n";
+        expect_true(m.background_flushes >= 4, "queued memtables flushed in the background");
+        expect_true(m.flush_merges >= 1 && m.flush_merges * 2 <= m.background_flushes,
+                    "flusher waits for two memtables and writes them as one L0 table");
+    }
+
+    size_t wal_count = 0;
+    for (auto& e : std::filesystem::directory_iterator(dir))
+        if (e.path().filename().string().substr(0, 4) == "wal_") wal_count++;
+    expect_true(wal_count == 1, "WALs of flushed memtables retired");
+    {
+        KVStore store(dir, opts);
+        std::string v;
+        bool all = true;
+        for (int i = 0; i < keys; i += 13)
+            all = all && store.get(key_of(i), v) && v == "r" + std::to_string(rounds - 1) + "_" + std::to_string(i);
+        expect_true(all, "newest round survives merged flushes and reopen");
+    }
+    clean_dir(dir);
+}
+
+static void test_block_sstable(const std::string& dir) {
+    std::cout << "\n=== Test 43: Block-Based SSTable ===\n";
+    clean_dir(dir);
+    std::filesystem::create_directories(dir);
+
+    const int n = 20000;
+    auto key_of = [](int i) {
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "blk_%06d", i);
+        return std::string(buf);
+    };
+    std::map<std::string, VLogPointer> entries;
+    for (int i = 0; i < n; ++i) entries[key_of(i)] = VLogPointer{0, static_cast<uint64_t>(i) * 10, 5};
+    std::string path = dir + "/sst_000001.sst";
+    expect_true(SSTableWriter::write(path, entries), "block-based SSTable written");
+
+    SSTableReader r;
+    expect_true(r.load(path), "block-based SSTable opens");
+    expect_true(r.block_count() > 1 && r.entry_count() == static_cast<uint32_t>(n),
+                "entries split into " + std::to_string(r.block_count()) + " blocks");
+    expect_true(r.min_key() == key_of(0) && r.max_key() == key_of(n - 1), "key range from index and first block");
+
+    bool all = true;
+    for (int i = 0; i < n; i += 7) {
+        VLogPointer p;
+        all = all && r.get(key_of(i), p) == SSTableLookup::kFound && p.offset == static_cast<uint64_t>(i) * 10;
+    }
+    VLogPointer p;
+    expect_true(all, "point lookups read one block each");
+    expect_true(r.get("blk_", p) == SSTableLookup::kAbsent && r.get("blk_9", p) == SSTableLookup::kAbsent && r.get("blk_000100x", p) == SSTableLookup::kAbsent, "absent keys miss");
+
+    size_t count = 0;
+    bool ordered = true;
+    std::string prev;
+    auto it = r.new_iterator();
+    for (it.seek_to_first(); it.valid(); it.next()) {
+        if (count++ > 0 && !(prev < it.key())) ordered = false;
+        prev = std::string(it.key());
+    }
+    expect_true(it.ok() && ordered && count == static_cast<size_t>(n), "iterator visits every entry in order");
+    it.seek("blk_012345x");
+    expect_true(it.valid() && it.key() == key_of(12346), "seek lands on the first key >= target");
+
+    // A corrupt block only affects the keys in it.
+    {
+        std::fstream f(path, std::ios::in | std::ios::out | std::ios::binary);
+        f.seekp(static_cast<std::streamoff>(SSTABLE_BLOCK_SIZE) * 3 + 100);
+        f.put(0x5A);
+    }
+    SSTableReader damaged;
+    expect_true(damaged.load(path), "table with a corrupt data block still opens");
+    size_t readable = 0, corrupt = 0;
+    for (int i = 0; i < n; ++i) {
+        SSTableLookup res = damaged.get(key_of(i), p);
+        readable += res == SSTableLookup::kFound;
+        corrupt  += res == SSTableLookup::kCorrupt;
+    }
+    expect_true(readable > 0 && readable < static_cast<size_t>(n), "lookups outside the corrupt block succeed");
+    expect_true(readable + corrupt == static_cast<size_t>(n), "keys in the corrupt block report corruption, not absence");
+    auto bad = damaged.new_iterator();
+    for (bad.seek_to_first(); bad.valid(); bad.next()) {}
+    expect_true(!bad.ok(), "iteration reports the corrupt block");
+
+    // Format 1 (whole-file checksum, 24-byte footer) is still readable.
+    std::string v1 = dir + "/sst_000003.sst";
+    {
+        std::vector<uint8_t> bytes;
+        auto put32 = [&](uint32_t x) { bytes.insert(bytes.end(), (uint8_t*)&x, (uint8_t*)&x + 4); };
+        for (const std::string k : {"v1_a", "v1_b"}) {
+            put32(static_cast<uint32_t>(k.size()));
+            bytes.insert(bytes.end(), k.begin(), k.end());
+            put32(0);
+            uint64_t off = k == "v1_a" ? 11 : 22;
+            bytes.insert(bytes.end(), (uint8_t*)&off, (uint8_t*)&off + 8);
+            put32(1);
+        }
+        uint32_t footer[6] = {2, static_cast<uint32_t>(bytes.size()), 0,
+                              static_cast<uint32_t>(ChecksumType::kCRC32C), 0, SSTABLE_FOOTER_MAGIC};
+        uint32_t crc = compute_checksum(ChecksumType::kCRC32C, bytes.data(), bytes.size());
+        footer[4] = checksum_extend(ChecksumType::kCRC32C, crc, footer, sizeof(uint32_t) * 4);
+        append_raw_bytes(v1, bytes.data(), bytes.size());
+        append_raw_bytes(v1, footer, sizeof(footer));
+    }
+    SSTableReader old;
+    bool ok = old.load(v1) && old.get("v1_b", p) == SSTableLookup::kFound && p.offset == 22 && old.block_count() == 1;
+    auto old_it = old.new_iterator();
+    old_it.seek_to_first();
+    expect_true(ok && old_it.valid() && old_it.key() == "v1_a", "format 1 SSTable loads and iterates");
+
+    // A store must not fall through a corrupt block to an older version.
+    // Long keys fill a memtable at about 3800: the first flush holds the
+    // "a" values, the next one overwrites them with "b".
+    std::string store_dir = dir + "/store";
+    auto long_key = [](int i) {
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "blk_%06d", i);
+        std::string k(buf);
+        k.resize(1000, 'b');
+        return k;
+    };
+    const int m = 4500;
+    {
+        KVStore store(store_dir);
+        for (int i = 0; i < m; ++i) store.put(long_key(i), "a" + std::to_string(i));
+        for (int i = 0; i < m; ++i) store.put(long_key(i), "b" + std::to_string(i));
+        store.wait_for_flush();
+    }
+    std::string newest;
+    for (auto& f : std::filesystem::directory_iterator(store_dir))
+        if (f.path().extension() == ".sst" && f.path().string() > newest) newest = f.path().string();
+    {
+        std::fstream f(newest, std::ios::in | std::ios::out | std::ios::binary);
+        f.seekp(static_cast<std::streamoff>(SSTABLE_BLOCK_SIZE) * 10 + 100);
+        f.put(0x5A);
+    }
+    {
+        KVStore store(store_dir);
+        size_t fresh = 0, stale = 0, errors = 0;
+        std::string v;
+        for (int i = 0; i < m; ++i) {
+            try {
+                if (store.get(long_key(i), v)) (v[0] == 'b' ? fresh : stale)++;
+            } catch (const std::runtime_error&) {
+                errors++;
+            }
+        }
+        std::cout << "  lookups: " << fresh << " current, " << errors << " failed on the corrupt block\n";
+        expect_true(errors > 0 && stale == 0 && fresh + errors == static_cast<size_t>(m),
+                    "store reports the corrupt block instead of an older value");
+    }
+    clean_dir(dir);
+}
+
+static void test_block_cache(const std::string& dir) {
+    std::cout << "\n=== Test 44: Sharded Block Cache ===\n";
+    clean_dir(dir);
+
+    {
+        BlockCache cache(16 * 1024, 2);   // 4 shards of 4 KiB
+        auto block = std::make_shared<SSTableBlock>();
+        size_t evicted = 0;
+        for (uint32_t i = 0; i < 64; ++i) evicted += cache.insert(1, i, 0, block, 1024);
+        expect_true(cache.usage() <= cache.capacity(), "usage stays within capacity");
+        expect_true(evicted > 0 && evicted == cache.evictions(), "evictions counted");
+        expect_true(cache.lookup(1, 63, 0) == block, "recent block hits");
+        expect_true(cache.lookup(2, 63, 0) == nullptr, "owners do not share keys");
+        cache.pin(12 * 1024);
+        for (uint32_t i = 100; i < 164; ++i) cache.insert(1, i, 0, block, 1024);
+        expect_true(cache.usage() <= 4 * 1024, "pinned bytes shrink the room for data blocks");
+        cache.unpin(12 * 1024);
+    }
+
+    // Two stores share one cache; both use the same SSTable sequences.
+    auto cache = std::make_shared<BlockCache>(4 * 1024 * 1024);
+    Options opts;
+    opts.block_cache = cache;
+    std::string dir_a = dir + "/a", dir_b = dir + "/b";
+    auto key_of = [](int i) { return "bc_" + std::to_string(i) + std::string(200, 'k'); };
+    {
+        KVStore a(dir_a, opts), b(dir_b, opts);
+        for (int i = 0; i < 20000; ++i) {
+            a.put(key_of(i), "a" + std::to_string(i));
+            b.put(key_of(i), "b" + std::to_string(i));
+        }
+        a.wait_for_flush();
+        b.wait_for_flush();
+    }
+    {
+        KVStore a(dir_a, opts), b(dir_b, opts);
+        expect_true(a.block_cache() == cache.get() && b.block_cache() == cache.get(), "stores use the shared cache");
+        a.metrics().reset();
+        b.metrics().reset();
+        bool correct = true;
+        for (int round = 0; round < 5; ++round) {
+            for (int i = 0; i < 200; i += 2) {
+                std::string va, vb;
+                correct = correct && a.get(key_of(i), va) && va == "a" + std::to_string(i);
+                correct = correct && b.get(key_of(i), vb) && vb == "b" + std::to_string(i);
+            }
+        }
+        expect_true(correct, "each store reads its own blocks through the shared cache");
+        const auto& m = a.metrics();
+        std::cout << "  store a: " << m.block_cache_hits << " hits, " << m.block_cache_misses
+                  << " misses; cache " << cache->usage() << " B data + " << cache->pinned_usage()
+                  << " B pinned of " << cache->capacity() << " B\n";
+        expect_true(m.block_cache_hits > 4 * m.block_cache_misses, "repeated reads hit the cache");
+        expect_true(b.metrics().block_cache_hits > 0, "second store counts its own hits");
+        expect_true(cache->usage() + cache->pinned_usage() <= cache->capacity(),
+                    "data and pinned metadata fit the one budget");
+    }
+    expect_true(cache->pinned_usage() == 0, "closing the stores unpins their metadata");
+
+    Options no_cache;
+    no_cache.block_cache_capacity = 0;
+    {
+        KVStore a(dir_a, no_cache);
+        std::string v;
+        expect_true(a.block_cache() == nullptr && a.get(key_of(10), v) && v == "a10", "reads work without a cache");
+    }
+    clean_dir(dir);
+}
+
+static void test_prefix_compressed_sstable(const std::string& dir) {
+    std::cout << "\n=== Test 45: Prefix-Compressed SSTable Blocks ===\n";
+    clean_dir(dir);
+    std::filesystem::create_directories(dir);
+
+    // Long shared prefixes and offsets that jump back and forth across
+    // value-log files, with every tenth key a tombstone.
+    auto key_of = [](int i) {
+        char buf[64];
+        std::snprintf(buf, sizeof(buf), "tenant:%05d:user:%08d:profile", i / 1000, i);
+        return std::string(buf);
+    };
+    auto ptr_of = [](int i) {
+        if (i % 10 == 9) return VLogPointer{0, std::numeric_limits<uint64_t>::max(), 0};
+        uint64_t off = (i % 2 ? 5000000ull : 0) + static_cast<uint64_t>(i) * 37;
+        return VLogPointer{static_cast<uint32_t>(i % 3), off, static_cast<uint32_t>(100 + i % 50)};
+    };
+    const int n = 30000;
+    std::map<std::string, VLogPointer> entries;
+    size_t plain_bytes = 0;
+    for (int i = 0; i < n; ++i) {
+        entries[key_of(i)] = ptr_of(i);
+        plain_bytes += 4 + key_of(i).size() + 16;   // format 2 entry
+    }
+    std::string path = dir + "/sst_000001.sst";
+    expect_true(SSTableWriter::write(path, entries), "prefix-compressed SSTable written");
+    size_t file_bytes = std::filesystem::file_size(path);
+    std::cout << "  " << n << " entries: " << file_bytes << " B on disk vs "
+              << plain_bytes << " B of format 2 entries\n";
+    expect_true(file_bytes * 2 <= plain_bytes, "shared prefixes and offset deltas at least halve the table");
+
+    SSTableReader r;
+    expect_true(r.load(path), "prefix-compressed SSTable opens");
+    expect_true(r.min_key() == key_of(0) && r.max_key() == key_of(n - 1), "key range survives separator index");
+
+    bool all = true;
+    for (int i = 0; i < n; i += 3) {
+        VLogPointer p, want = ptr_of(i);
+        all = all && r.get(key_of(i), p) == SSTableLookup::kFound && p.file_id == want.file_id && p.offset == want.offset &&
+              p.length == want.length;
+    }
+    expect_true(all, "lookups decode keys and delta-coded pointers");
+    VLogPointer p;
+    expect_true(r.get("tenant:00007:user:00007500:profilf", p) == SSTableLookup::kAbsent && r.get("tenant:", p) == SSTableLookup::kAbsent &&
+                r.get("tenant:99999", p) == SSTableLookup::kAbsent, "absent keys between and beyond entries miss");
+
+    int i = 0;
+    bool exact = true;
+    auto it = r.new_iterator();
+    for (it.seek_to_first(); it.valid(); it.next(), ++i) {
+        VLogPointer want = ptr_of(i);
+        exact = exact && it.key() == key_of(i) && it.pointer().offset == want.offset &&
+                is_tombstone(it.pointer()) == (i % 10 == 9);
+    }
+    expect_true(it.ok() && exact && i == n, "iteration restores every key, pointer and tombstone");
+
+    // Every position within a restart interval, across block boundaries.
+    bool seeks = true;
+    for (int j = 0; j + 1 < n; j += 997) {
+        for (int k = j; k < j + static_cast<int>(SSTABLE_RESTART_INTERVAL) + 1 && k + 1 < n; ++k) {
+            it.seek(key_of(k) + "!");
+            seeks = seeks && it.valid() && it.key() == key_of(k + 1);
+            it.seek(key_of(k));
+            seeks = seeks && it.valid() && it.key() == key_of(k);
+        }
+    }
+    expect_true(seeks, "seek lands correctly at and between restart points");
+    clean_dir(dir);
+}
+
+static void test_mmap_sstable(const std::string& dir) {
+    std::cout << "\n=== Test 46: Memory-Mapped SSTable Reader ===\n";
+    clean_dir(dir);
+    std::filesystem::create_directories(dir);
+
+    const int n = 20000;
+    auto key_of = [](int i) {
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "map_%06d", i);
+        return std::string(buf);
+    };
+    std::map<std::string, VLogPointer> entries;
+    for (int i = 0; i < n; ++i) entries[key_of(i)] = VLogPointer{1, static_cast<uint64_t>(i) * 64, 40};
+    std::string path = dir + "/sst_000001.sst";
+    expect_true(SSTableWriter::write(path, entries), "table written");
+
+    BlockCache cache(4 * 1024 * 1024);
+    SSTableReadContext ctx;
+    ctx.cache = &cache;
+    SSTableReader pread_reader;
+    expect_true(pread_reader.load(path, ctx), "pread reader opens");
+    size_t pread_pinned = cache.pinned_usage();
+    ctx.mmap = true;
+    SSTableReader r;
+    expect_true(r.load(path, ctx), "mapped reader opens");
+    size_t mapped_pinned = cache.pinned_usage() - pread_pinned;
+    std::cout << "  resident metadata: " << pread_pinned << " B with pread, "
+              << mapped_pinned << " B mapped\n";
+    expect_true(mapped_pinned < pread_pinned, "mapped filter is not held on the heap");
+
+    size_t cached_before = cache.usage();
+    bool all = true;
+    for (int i = 0; i < n; i += 5) {
+        VLogPointer p;
+        all = all && r.get(key_of(i), p) == SSTableLookup::kFound && p.offset == static_cast<uint64_t>(i) * 64;
+    }
+    VLogPointer p;
+    expect_true(all && r.get("map_", p) == SSTableLookup::kAbsent && r.get(key_of(n), p) == SSTableLookup::kAbsent, "lookups read the mapping in place");
+    expect_true(r.bloom().may_contain(key_of(7)), "mapped filter has no false negatives");
+    expect_true(cache.usage() == cached_before, "mapped blocks bypass the block cache");
+
+    size_t count = 0;
+    auto it = r.new_iterator();
+    for (it.seek_to_first(); it.valid(); it.next()) count++;
+    expect_true(it.ok() && count == static_cast<size_t>(n), "iterator walks the mapped blocks");
+
+    // A corrupt block is caught on first use and stays rejected.
+    {
+        std::fstream f(path, std::ios::in | std::ios::out | std::ios::binary);
+        f.seekp(static_cast<std::streamoff>(SSTABLE_BLOCK_SIZE) * 2 + 50);
+        f.put(0x5A);
+    }
+    SSTableReader damaged;
+    expect_true(damaged.load(path, ctx), "damaged table still maps");
+    size_t readable[2] = {0, 0}, corrupt[2] = {0, 0};
+    for (int pass = 0; pass < 2; ++pass)
+        for (int i = 0; i < n; ++i) {
+            SSTableLookup res = damaged.get(key_of(i), p);
+            readable[pass] += res == SSTableLookup::kFound;
+            corrupt[pass]  += res == SSTableLookup::kCorrupt;
+        }
+    expect_true(readable[0] > 0 && readable[0] < static_cast<size_t>(n) && readable[1] == readable[0] &&
+                readable[0] + corrupt[0] == static_cast<size_t>(n) && corrupt[1] == corrupt[0],
+                "keys in the corrupt block report corruption on every read");
+
+    // A store with mapped tables.
+    std::string store_dir = dir + "/store";
+    Options opts;
+    opts.sstable_mmap = true;
+    {
+        KVStore store(store_dir, opts);
+        for (int i = 0; i < 20000; ++i) store.put(key_of(i), std::string(200, 'a' + i % 26));
+        store.wait_for_flush();
+    }
+    {
+        KVStore store(store_dir, opts);
+        bool ok = true;
+        std::string v;
+        for (int i = 0; i < 20000; i += 13)
+            ok = ok && store.get(key_of(i), v) && v == std::string(200, 'a' + i % 26);
+        expect_true(ok, "store reads flushed data from mapped tables after reopen");
+    }
+    clean_dir(dir);
+}
+
+static void test_leveled_compaction(const std::string& dir) {
+    std::cout << "\n=== Test 47: Multi-Level Leveled Compaction ===\n";
+    clean_dir(dir);
+
+    Options opts;
+    opts.num_levels       = 4;
+    opts.level_base_bytes = 256 * 1024;
+    opts.level_size_ratio = 4;
+    opts.target_file_size = 64 * 1024;
+    auto key_of = [](uint32_t i) {
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "lvl_%08u", i);
+        return std::string(buf);
+    };
+    // Keys scattered over the key space, so every flush overlaps L1.
+    const uint32_t n = 120000;
+    auto scatter = [](uint32_t i) { return static_cast<uint32_t>(i * 2654435761ull % 1000003u); };
+    {
+        KVStore store(dir, opts);
+        for (uint32_t i = 0; i < n; ++i) store.put(key_of(scatter(i)), "v" + std::to_string(i) + std::string(100, 'x'));
+        for (uint32_t i = 0; i < n; i += 10) store.delete_key(key_of(scatter(i)));
+        store.wait_for_flush();
+        while (run_compaction(&store)) {}
+    }
+
+    Manifest m;
+    expect_true(m.load(dir + "/MANIFEST"), "manifest loads");
+    std::cout << "  levels:";
+    for (size_t l = 0; l < m.levels.size(); ++l)
+        std::cout << " L" << l << "=" << m.levels[l].size() << " files/"
+                  << (l < m.level_bytes.size() ? m.level_bytes[l] : 0) << " B";
+    std::cout << "\n";
+    expect_true(m.levels.size() == 4 && m.level_bytes.size() == 4, "manifest records every level");
+    expect_true(m.levels[0].empty(), "L0 drained into the levels below");
+    expect_true(!m.levels[2].empty() || !m.levels[3].empty(), "data moved below L1");
+
+    bool within = true, disjoint = true, sizes = true;
+    uint64_t target = opts.level_base_bytes;
+    for (size_t l = 1; l < m.levels.size(); ++l, target *= opts.level_size_ratio) {
+        std::vector<std::pair<std::string, std::string>> ranges;
+        uint64_t bytes = 0;
+        for (uint32_t seq : m.levels[l]) {
+            char name[32];
+            std::snprintf(name, sizeof(name), "/sst_%06u.sst", seq);
+            SSTableReader r;
+            if (!r.load(dir + name)) { disjoint = false; continue; }
+            ranges.emplace_back(r.min_key(), r.max_key());
+            bytes += r.file_size();
+        }
+        std::sort(ranges.begin(), ranges.end());
+        for (size_t i = 1; i < ranges.size(); ++i)
+            if (!(ranges[i - 1].second < ranges[i].first)) disjoint = false;
+        if (bytes != m.level_bytes[l]) sizes = false;
+        if (l + 1 < m.levels.size() && bytes > target) within = false;
+    }
+    expect_true(disjoint, "tables of every level are disjoint");
+    expect_true(sizes, "recorded level sizes match the tables");
+    expect_true(within, "no level above the last exceeds its target size");
+
+    {
+        KVStore store(dir, opts);
+        bool ok = true;
+        std::string v;
+        for (uint32_t i = 0; i < n; i += 7) {
+            bool got = store.get(key_of(scatter(i)), v);
+            ok = ok && (i % 10 == 0 ? !got : got && v == "v" + std::to_string(i) + std::string(100, 'x'));
+        }
+        expect_true(ok, "reads after reopen see newest values and deletes across levels");
+    }
+    clean_dir(dir);
+}
+
+static void test_streaming_merge(const std::string& dir) {
+    std::cout << "\n=== Test 48: Streaming K-Way Merge ===\n";
+    clean_dir(dir);
+    std::filesystem::create_directories(dir);
+
+    auto key_of = [](uint32_t i) {
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "mrg_%06u", i);
+        return std::string(buf);
+    };
+    // Three overlapping sources, newest first: a memtable holding every
+    // third key, then two SSTables; file_id names the source.
+    auto newest = std::make_shared<Memtable>();
+    for (uint32_t i = 0; i < 3000; i += 3) newest->put(key_of(i), VLogPointer{0, i, 1});
+    std::vector<SSTableEntryRef> mid_entries, old_entries;
+    std::vector<std::string> keys;
+    keys.reserve(4000);
+    for (uint32_t i = 0; i < 4000; ++i) keys.push_back(key_of(i));
+    for (uint32_t i = 0; i < 3000; i += 2) mid_entries.push_back({keys[i], VLogPointer{1, i, 1}});
+    for (uint32_t i = 0; i < 4000; ++i) old_entries.push_back({keys[i], VLogPointer{2, i, 1}});
+
+    // The builder streams the same bytes the one-shot writer produces.
+    const std::string mid_path = dir + "/mid.sst", old_path = dir + "/old.sst", built = dir + "/built.sst";
+    expect_true(SSTableWriter::write(mid_path, mid_entries), "writer writes the middle table");
+    {
+        SSTableBuilder builder;
+        bool ok = builder.open(old_path);
+        for (const auto& e : old_entries) builder.add(e.key, e.pointer);
+        expect_true(ok && builder.finish(), "builder writes the oldest table");
+        expect_true(SSTableWriter::write(built, old_entries), "writer writes the same entries");
+        expect_true(std::filesystem::file_size(built) == std::filesystem::file_size(old_path),
+                    "builder output matches the writer's size");
+    }
+
+    auto mid = std::make_shared<SSTableReader>(), old = std::make_shared<SSTableReader>();
+    expect_true(mid->load(mid_path) && old->load(old_path), "tables load");
+    std::vector<std::unique_ptr<KeyIterator>> sources;
+    sources.push_back(std::make_unique<MemtableKeyIterator>(newest));
+    sources.push_back(std::make_unique<SSTableKeyIterator>(mid));
+    sources.push_back(std::make_unique<SSTableKeyIterator>(old));
+    MergingIterator merged(std::move(sources));
+
+    uint32_t count = 0;
+    bool ordered = true, newest_wins = true;
+    std::string prev;
+    for (merged.seek_to_first(); merged.valid(); merged.next(), ++count) {
+        std::string k(merged.key());
+        if (count > 0 && !(prev < k)) ordered = false;
+        uint32_t i = static_cast<uint32_t>(merged.pointer().offset);
+        uint32_t want = (i % 3 == 0 && i < 3000) ? 0 : (i % 2 == 0 && i < 3000) ? 1 : 2;
+        if (k != key_of(i) || merged.pointer().file_id != want) newest_wins = false;
+        prev = std::move(k);
+    }
+    expect_true(merged.ok(), "merge read every block");
+    expect_true(count == 4000, "merge yields each key once");
+    expect_true(ordered, "merge output is strictly ascending");
+    expect_true(newest_wins, "newest source wins each key");
+
+    // Compaction through the merge keeps newest values and drops deletes.
+    clean_dir(dir);
+    {
+        KVStore store(dir);
+        // Long padding keys fill the memtable so each round is flushed.
+        auto pad = [&](uint32_t round) {
+            for (uint32_t i = 0; i < 4200; ++i) {
+                std::string k = "pad" + std::to_string(round) + "_" + std::to_string(i);
+                k.resize(1000, 'p');
+                store.put(k, "p");
+            }
+        };
+        for (uint32_t round = 0; round < 3; ++round) {
+            for (uint32_t i = 0; i < 2000; ++i) store.put(key_of(i), "r" + std::to_string(round) + "_" + std::to_string(i));
+            pad(round);
+        }
+        for (uint32_t i = 0; i < 2000; i += 5) store.delete_key(key_of(i));
+        pad(3);
+        store.wait_for_flush();
+        while (run_compaction(&store)) {}
+    }
+    {
+        KVStore store(dir);
+        bool ok = true;
+        std::string v;
+        for (uint32_t i = 0; i < 2000; ++i) {
+            bool got = store.get(key_of(i), v);
+            ok = ok && (i % 5 == 0 ? !got : got && v == "r2_" + std::to_string(i));
+        }
+        expect_true(ok, "compacted store returns newest values and hides deletes");
+    }
+    clean_dir(dir);
+}
+
+static void test_subcompactions(const std::string& dir) {
+    std::cout << "\n=== Test 49: Parallel Subcompactions ===\n";
+    clean_dir(dir);
+    auto key_of = [](uint32_t i) {
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "sub_%08u", i);
+        return std::string(buf);
+    };
+    auto scatter = [](uint32_t i) { return static_cast<uint32_t>(i * 2654435761ull % 1000003u); };
+    const uint32_t n = 120000;
+
+    Options opts;
+    opts.num_levels       = 3;
+    opts.level_base_bytes = 64u * 1024u * 1024u;   // keep everything in L1
+    opts.target_file_size = 64 * 1024;
+    {
+        KVStore store(dir, opts);
+        for (uint32_t i = 0; i < n; ++i) store.put(key_of(scatter(i)), "v" + std::to_string(i) + std::string(100, 's'));
+        for (uint32_t i = 0; i < n; i += 9) store.delete_key(key_of(scatter(i)));
+        store.wait_for_flush();
+    }
+    // The same L0 state compacted split into up to 4 ranges and unsplit
+    // must give the same entries.
+    const std::string unsplit = dir + "_unsplit";
+    clean_dir(unsplit);
+    std::filesystem::copy(dir, unsplit, std::filesystem::copy_options::recursive);
+
+    uint64_t split_ranges = 0;
+    std::vector<std::vector<std::pair<std::string, uint64_t>>> l1;
+    for (uint32_t subs : {4u, 1u}) {
+        const std::string& d = subs > 1 ? dir : unsplit;
+        opts.max_subcompactions = subs;
+        {
+            KVStore store(d, opts);
+            while (run_compaction(&store)) {}
+            if (subs > 1) split_ranges = store.metrics().subcompactions;
+            else expect_true(store.metrics().subcompactions == 0, "max_subcompactions = 1 never splits");
+        }
+
+        Manifest m;
+        expect_true(m.load(d + "/MANIFEST"), "manifest loads");
+        std::vector<std::pair<std::string, std::string>> ranges;
+        std::vector<std::pair<std::string, uint64_t>> entries;
+        for (uint32_t seq : m.levels[1]) {
+            char name[32];
+            std::snprintf(name, sizeof(name), "/sst_%06u.sst", seq);
+            SSTableReader r;
+            if (!r.load(d + name)) continue;
+            ranges.emplace_back(r.min_key(), r.max_key());
+            auto it = r.new_iterator();
+            for (it.seek_to_first(); it.valid(); it.next()) entries.emplace_back(it.key(), it.pointer().offset);
+        }
+        std::sort(ranges.begin(), ranges.end());
+        std::sort(entries.begin(), entries.end());
+        bool disjoint = ranges.size() == m.levels[1].size();
+        for (size_t i = 1; i < ranges.size(); ++i)
+            if (!(ranges[i - 1].second < ranges[i].first)) disjoint = false;
+        expect_true(m.levels[0].empty() && disjoint, "L1 tables are disjoint after compaction");
+        l1.push_back(std::move(entries));
+
+        KVStore store(d, opts);
+        bool ok = true;
+        std::string v;
+        for (uint32_t i = 0; i < n; i += 5) {
+            bool got = store.get(key_of(scatter(i)), v);
+            ok = ok && (i % 9 == 0 ? !got : got && v == "v" + std::to_string(i) + std::string(100, 's'));
+        }
+        expect_true(ok, "reads after reopen see newest values and deletes");
+    }
+    std::cout << "  subcompactions run: " << split_ranges << "\n";
+    expect_true(split_ranges >= 2, "large compactions were split into key ranges");
+    expect_true(!l1[0].empty() && l1[0] == l1[1], "split and unsplit compactions write the same entries");
+    clean_dir(unsplit);
+    clean_dir(dir);
+}
+
+static void test_universal_compaction(const std::string& dir) {
+    std::cout << "\n=== Test 50: Universal (Tiered) Compaction ===\n";
+    // Append-mostly log: distinct scattered keys, long enough that every
+    // round fills one memtable, plus a few deletes of earlier rounds.
+    const uint32_t rounds = 12, per_round = 2200;
+    auto key_of = [](uint32_t i) {
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "uni_%08u", static_cast<uint32_t>(i * 2654435761ull % 1000003u));
+        std::string k(buf);
+        k.resize(2000, 'u');
+        return k;
+    };
+    auto deleted = [&](uint32_t i) { return i % 13 == 0 && i / per_round + 1 < rounds; };
+    auto run_workload = [&](const Options& opts) {
+        clean_dir(dir);
+        KVStore store(dir, opts);
+        for (uint32_t r = 0; r < rounds; ++r) {
+            for (uint32_t i = r * per_round; i < (r + 1) * per_round; ++i) store.put(key_of(i), "v" + std::to_string(i));
+            if (r > 0)
+                for (uint32_t i = (r - 1) * per_round; i < r * per_round; ++i)
+                    if (deleted(i)) store.delete_key(key_of(i));
+        }
+        store.wait_for_compaction();
+        return static_cast<uint64_t>(store.metrics().compaction_bytes_written);
+    };
+    auto verify = [&](const Options& opts) {
+        KVStore store(dir, opts);
+        bool ok = true;
+        std::string v;
+        for (uint32_t i = 0; i < rounds * per_round; i += 3) {
+            bool got = store.get(key_of(i), v);
+            ok = ok && (deleted(i) ? !got : got && v == "v" + std::to_string(i));
+        }
+        return ok;
+    };
+
+    Options leveled;
+    uint64_t leveled_bytes = run_workload(leveled);
+
+    Options opts;
+    opts.compaction_style      = CompactionStyle::kUniversal;
+    opts.universal_run_trigger = 8;
+    uint64_t universal_bytes = run_workload(opts);
+    std::cout << "  compaction bytes: leveled " << leveled_bytes
+              << ", universal " << universal_bytes << "\n";
+    expect_true(universal_bytes < leveled_bytes, "universal rewrites less than leveled");
+
+    Manifest m;
+    expect_true(m.load(dir + "/MANIFEST"), "manifest loads");
+    size_t runs = m.levels[0].size();
+    bool disjoint = true;
+    for (size_t l = 1; l < m.levels.size(); ++l) {
+        runs += !m.levels[l].empty();
+        std::vector<std::pair<std::string, std::string>> ranges;
+        for (uint32_t seq : m.levels[l]) {
+            char name[32];
+            std::snprintf(name, sizeof(name), "/sst_%06u.sst", seq);
+            SSTableReader r;
+            if (r.load(dir + name)) ranges.emplace_back(r.min_key(), r.max_key());
+        }
+        std::sort(ranges.begin(), ranges.end());
+        for (size_t i = 1; i < ranges.size(); ++i)
+            if (!(ranges[i - 1].second < ranges[i].first)) disjoint = false;
+    }
+    std::cout << "  sorted runs: " << runs << "\n";
+    expect_true(runs > 1, "several overlapping sorted runs kept");
+    expect_true(disjoint, "each sorted run is disjoint internally");
+    expect_true(verify(opts), "reads across overlapping runs see newest values and deletes");
+    expect_true(verify(leveled), "store reopens under leveled compaction");
+
+    {
+        KVStore store(dir, opts);
+        while (run_compaction(&store)) {}
+    }
+    expect_true(m.load(dir + "/MANIFEST"), "manifest loads after full merge");
+    size_t non_empty = 0;
+    for (size_t l = 1; l < m.levels.size(); ++l) non_empty += !m.levels[l].empty();
+    expect_true(m.levels[0].empty() && non_empty == 1, "manual compaction merges everything into one run");
+    expect_true(verify(opts), "reads after full merge see newest values and deletes");
+    clean_dir(dir);
+}
+
+static void test_trivial_move(const std::string& dir) {
+    std::cout << "\n=== Test 51: Trivial-Move Compaction ===\n";
+    clean_dir(dir);
+    // Ascending keys, long enough that each memtable holds about 4200: every
+    // flushed table covers a range of its own.
+    auto key_of = [](uint32_t i) {
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "tm_%08u", i);
+        std::string k(buf);
+        k.resize(1000, 't');
+        return k;
+    };
+    const uint32_t n = 30000;
+    {
+        KVStore store(dir);
+        for (uint32_t i = 0; i < n; ++i) store.put(key_of(i), "v" + std::to_string(i));
+        store.wait_for_flush();
+        while (run_compaction(&store)) {}
+        std::cout << "  trivial moves: " << store.metrics().trivial_moves
+                  << ", compaction bytes: " << store.metrics().compaction_bytes_written << "\n";
+        expect_true(store.metrics().trivial_moves > 0, "sequential L0 tables moved down");
+        expect_true(store.metrics().compaction_bytes_written == 0, "sequential ingest rewrites nothing");
+    }
+
+    // Overwrite a slice in the middle: those tables must merge, and the
+    // merge output must not straddle tables moved around it.
+    {
+        KVStore store(dir);
+        for (uint32_t i = 0; i < 4200; ++i) store.put(key_of(10000 + i), "w" + std::to_string(i));
+        for (uint32_t i = n; i < n + 8400; ++i) store.put(key_of(i), "v" + std::to_string(i));
+        store.wait_for_flush();
+        while (run_compaction(&store)) {}
+        expect_true(store.metrics().compaction_bytes_written > 0, "overlapping tables still merge");
+    }
+
+    Manifest m;
+    expect_true(m.load(dir + "/MANIFEST"), "manifest loads");
+    bool disjoint = true, present = true;
+    for (size_t l = 1; l < m.levels.size(); ++l) {
+        std::vector<std::pair<std::string, std::string>> ranges;
+        for (uint32_t seq : m.levels[l]) {
+            char name[32];
+            std::snprintf(name, sizeof(name), "/sst_%06u.sst", seq);
+            SSTableReader r;
+            if (!r.load(dir + name)) { present = false; continue; }
+            ranges.emplace_back(r.min_key(), r.max_key());
+        }
+        std::sort(ranges.begin(), ranges.end());
+        for (size_t i = 1; i < ranges.size(); ++i)
+            if (!(ranges[i - 1].second < ranges[i].first)) disjoint = false;
+    }
+    expect_true(present, "moved tables stay on disk");
+    expect_true(disjoint, "levels stay disjoint after moves and merges");
+
+    KVStore store(dir);
+    bool ok = true;
+    std::string v;
+    for (uint32_t i = 0; i < n + 8400; i += 7) {
+        bool got = store.get(key_of(i), v);
+        std::string want = i >= 10000 && i < 14200 ? "w" + std::to_string(i - 10000) : "v" + std::to_string(i);
+        ok = ok && got && v == want;
+    }
+    expect_true(ok, "reads see moved and merged tables");
+    clean_dir(dir);
+}
+
 // ── main ───────────────────────────────────────────────────────
 
+static void test_universal_stall_limits(const std::string& dir) {
+    std::cout << "\n=== Test 52: Universal Trigger Above the Stall Limits ===\n";
+    clean_dir(dir);
+    // With universal_run_trigger 20 no compaction is due before L0 holds 20
+    // tables, so the fixed leveled limits (stop at 15) would block writers
+    // for good. About 3800 keys fill a memtable; write enough for 17.
+    auto key_of = [](uint32_t i) {
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "us_%08u", i);
+        std::string k(buf);
+        k.resize(1000, 's');
+        return k;
+    };
+    const uint32_t n = 68000;
+    Options opts;
+    opts.compaction_style      = CompactionStyle::kUniversal;
+    opts.universal_run_trigger = 20;
+    {
+        KVStore store(dir, opts);
+        for (uint32_t i = 0; i < n; ++i) store.put(key_of(i), "v" + std::to_string(i));
+        store.wait_for_flush();
+        const auto& m = store.metrics();
+        std::cout << "  write slowdowns: " << m.write_slowdowns
+                  << ", write stops: " << m.write_stops << "\n";
+        expect_true(m.write_stops == 0 && m.write_slowdowns == 0,
+                    "writes below twice the run trigger never stall");
+    }
+    Manifest m;
+    expect_true(m.load(dir + "/MANIFEST"), "manifest loads");
+    std::cout << "  L0 tables: " << m.levels[0].size() << "\n";
+    expect_true(m.levels[0].size() > 15, "L0 grew past the leveled stop limit");
+    {
+        KVStore store(dir, opts);
+        bool ok = true;
+        std::string v;
+        for (uint32_t i = 0; i < n; i += 7) ok = ok && store.get(key_of(i), v) && v == "v" + std::to_string(i);
+        expect_true(ok, "every value readable after reopen");
+    }
+    clean_dir(dir);
+}
+
+static void test_gc_concurrent_readers(const std::string& dir) {
+    std::cout << "\n=== Test 53: Concurrent Readers During VLog GC ===\n";
+    clean_dir(dir);
+
+    const int n = 2000;
+    auto key_of   = [](int i) { return "gcr_" + std::to_string(i); };
+    auto value_of = [](int i, int round) {
+        return "gcr_value_" + std::to_string(round) + "_" + std::to_string(i) + std::string(64, 'g');
+    };
+    {
+        KVStore store(dir);
+        WriteOptions wo;
+        wo.sync = SyncMode::kNone;
+        for (int round = 0; round < 2; ++round)
+            for (int i = 0; i < n; ++i) store.put(key_of(i), value_of(i, round), wo);
+
+        // Every read while GC moves the values must still find the newest one.
+        std::atomic<bool> stop{false};
+        std::atomic<uint64_t> reads{0}, wrong{0};
+        std::vector<std::thread> readers;
+        for (int t = 0; t < 4; ++t) {
+            readers.emplace_back([&, t] {
+                uint64_t count = 0;
+                for (int i = t; !stop.load(); i = (i + 7) % n) {
+                    if (t == 0) {
+                        std::vector<std::string> keys{key_of(i), key_of((i + 1) % n)};
+                        std::vector<std::string> values;
+                        std::vector<bool> found;
+                        store.multi_get(keys, values, found);
+                        if (!found[0] || values[0] != value_of(i, 1) ||
+                            !found[1] || values[1] != value_of((i + 1) % n, 1)) wrong++;
+                        count += 2;
+                    } else {
+                        std::string v;
+                        if (!store.get(key_of(i), v) || v != value_of(i, 1)) wrong++;
+                        count++;
+                    }
+                }
+                reads += count;
+            });
+        }
+        run_vlog_gc(&store);
+        stop = true;
+        for (auto& t : readers) t.join();
+
+        std::cout << "  " << reads.load() << " reads during GC, " << wrong.load() << " wrong\n";
+        expect_true(wrong.load() == 0, "every read during GC saw the live value");
+        expect_true(!std::filesystem::exists(dir + "/vlog_gc_target.bin"), "old VLog removed after GC");
+    }
+    {
+        KVStore store(dir);
+        bool ok = true;
+        std::string v;
+        for (int i = 0; i < n; ++i) ok = ok && store.get(key_of(i), v) && v == value_of(i, 1);
+        expect_true(ok, "values rewritten by GC survive a reopen");
+    }
+
+    // A pointer into a log the store does not have is corruption, not a miss.
+    {
+        KVStore store(dir);
+        for (int i = 0; i < 5000; ++i) {
+            std::string k = key_of(n + i);
+            k.resize(1000, 'g');
+            store.put(k, value_of(i, 2));
+        }
+        store.wait_for_flush();
+    }
+    Manifest m;
+    expect_true(m.load(dir + "/MANIFEST"), "manifest loads");
+    m.vlog_file_id += 7;
+    expect_true(m.commit(dir + "/MANIFEST"), "manifest names another VLog");
+    {
+        KVStore store(dir);
+        std::string k = key_of(n);
+        k.resize(1000, 'g');
+        std::string v;
+        std::vector<std::string> values;
+        std::vector<bool> found;
+        bool get_threw = false, multi_get_threw = false;
+        try { store.get(k, v); } catch (const std::runtime_error&) { get_threw = true; }
+        try { store.multi_get({k}, values, found); } catch (const std::runtime_error&) { multi_get_threw = true; }
+        expect_true(get_threw && multi_get_threw, "get() and multi_get() report a dangling VLog pointer");
+    }
+    clean_dir(dir);
+}
+
+static void test_gc_concurrent_writers(const std::string& dir) {
+    std::cout << "\n=== Test 54: Concurrent Writers During VLog GC ===\n";
+    clean_dir(dir);
+
+    const int n = 1000, threads = 4;
+    auto key_of = [](int t, int i) { return "gcw_" + std::to_string(t) + "_" + std::to_string(i); };
+    KVStore store(dir);
+    for (int i = 0; i < n; ++i) store.put(key_of(threads, i), "seed_" + std::to_string(i));
+
+    // GC runs its steps as exclusive writers; they queue behind ordinary
+    // puts and batches and must run alone, never inside their group.
+    std::atomic<bool> stop{false}, failed{false};
+    std::vector<int> written(threads, 0);
+    std::vector<std::thread> writers;
+    for (int t = 0; t < threads; ++t) {
+        writers.emplace_back([&, t] {
+            try {
+                for (int i = 0; !stop.load(); ++i) {
+                    if (t % 2 == 0) {
+                        store.put(key_of(t, i), "v" + std::to_string(i));
+                    } else {
+                        WriteBatch batch;
+                        batch.put(key_of(t, i), "v" + std::to_string(i));
+                        store.write(batch);
+                    }
+                    written[t] = i + 1;
+                }
+            } catch (const std::exception&) {
+                failed = true;
+            }
+        });
+    }
+    for (int round = 0; round < 3; ++round) run_vlog_gc(&store);
+    stop = true;
+    for (auto& t : writers) t.join();
+    expect_true(!failed.load(), "writes alongside GC succeed");
+
+    bool ok = true;
+    std::string v;
+    for (int t = 0; t < threads; ++t)
+        for (int i = 0; i < written[t]; ++i) ok = ok && store.get(key_of(t, i), v) && v == "v" + std::to_string(i);
+    for (int i = 0; i < n; ++i) ok = ok && store.get(key_of(threads, i), v) && v == "seed_" + std::to_string(i);
+    expect_true(ok, "every write and every value moved by GC is readable");
+    clean_dir(dir);
+}
+
+static void test_gc_keeps_newer_writes(const std::string& dir) {
+    std::cout << "\n=== Test 55: VLog GC Does Not Undo Newer Writes ===\n";
+    clean_dir(dir);
+
+    const int n = 2000;
+    auto key_of = [](int i) {
+        char buf[32];
+        std::snprintf(buf, sizeof(buf), "gcn_%06d", i);
+        return std::string(buf);
+    };
+    KVStore store(dir);
+    for (int i = 0; i < n; ++i) store.put(key_of(i), "old_" + std::to_string(i));
+
+    // GC rewrites keys in ascending order; the writer overwrites and deletes
+    // them in descending order, so the two cross while GC is running.
+    std::atomic<int> lowest{n};
+    std::thread writer([&] {
+        for (int i = n - 1; i >= 0; --i) {
+            if (i % 10 == 0) store.delete_key(key_of(i));
+            else             store.put(key_of(i), "new_" + std::to_string(i));
+            lowest = i;
+        }
+    });
+    run_vlog_gc(&store);
+    writer.join();
+
+    size_t undone = 0;
+    std::string v;
+    for (int i = 0; i < n; ++i) {
+        bool found = store.get(key_of(i), v);
+        if (i % 10 == 0 ? found : !found || v != "new_" + std::to_string(i)) undone++;
+    }
+    std::cout << "  writer reached key " << lowest.load() << ", " << undone << " writes undone\n";
+    expect_true(lowest.load() == 0 && undone == 0, "GC never replaces a newer value or delete with the old one");
+    clean_dir(dir);
+}
+
 int main(int argc, char* argv[]) {
     if (argc > 1 && std::string(argv[1]) == "cli") {
         KVStore store("stdb_production");
@@ -702,6 +2678,37 @@ int main(int argc, char* argv[]) {
     test_bloom_checksum_coverage(dir);
     test_bloom_invariant_disabling(dir);
 
+    // Phase 6 tests.
+    test_group_commit(dir);
+    test_write_batch_atomicity(dir);
+    test_durability_modes(dir);
+    test_vlog_as_wal(dir);
+    test_wal_recycling(dir);
+    test_io_backends(dir);
+    test_zero_copy_appends(dir);
+    test_checksum_types(dir);
+    test_parallel_wal_replay(dir);
+    test_recovery_reuses_vlog(dir);
+    test_background_flush(dir);
+    test_background_compaction(dir);
+    test_concurrent_readers(dir);
+    test_skiplist_memtable();
+    test_hash_memtable(dir);
+    test_immutable_memtable_queue(dir);
+    test_block_sstable(dir);
+    test_block_cache(dir);
+    test_prefix_compressed_sstable(dir);
+    test_mmap_sstable(dir);
+    test_leveled_compaction(dir);
+    test_streaming_merge(dir);
+    test_subcompactions(dir);
+    test_universal_compaction(dir);
+    test_trivial_move(dir);
+    test_universal_stall_limits(dir);
+    test_gc_concurrent_readers(dir);
+    test_gc_concurrent_writers(dir);
+    test_gc_keeps_newer_writes(dir);
+
     clean_dir(dir);
 
     std::cout << "\n──────────────────────────────\n"
@@ -0,0 +1,41 @@
+#include "arena.h"
+
+#include <cstdint>
+
+char* Arena::allocate(size_t bytes) {
+    std::lock_guard<std::mutex> lock(mu_);
+    return allocate_locked(bytes, 1);
+}
+
+char* Arena::allocate_aligned(size_t bytes) {
+    std::lock_guard<std::mutex> lock(mu_);
+    return allocate_locked(bytes, alignof(std::max_align_t));
+}
+
+char* Arena::allocate_locked(size_t bytes, size_t align) {
+    size_t misalign = reinterpret_cast<uintptr_t>(ptr_) & (align - 1);
+    size_t pad = misalign ? align - misalign : 0;
+    if (bytes + pad <= remaining_) {
+        char* result = ptr_ + pad;
+        ptr_       += bytes + pad;
+        remaining_ -= bytes + pad;
+        return result;
+    }
+
+    // Big allocations get their own block so the current block's tail is
+    // not wasted on them. new[] memory is max_align_t aligned.
+    if (bytes > BLOCK_SIZE / 4) return new_block(bytes);
+
+    ptr_       = new_block(BLOCK_SIZE);
+    remaining_ = BLOCK_SIZE;
+    char* result = ptr_;
+    ptr_       += bytes;
+    remaining_ -= bytes;
+    return result;
+}
+
+char* Arena::new_block(size_t bytes) {
+    blocks_.emplace_back(new char[bytes]);
+    memory_usage_.fetch_add(bytes + sizeof(char*), std::memory_order_relaxed);
+    return blocks_.back().get();
+}
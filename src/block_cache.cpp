@@ -0,0 +1,67 @@
+#include "block_cache.h"
+#include "bloom.h"
+
+BlockCache::BlockCache(size_t capacity_bytes, int shard_bits)
+    : capacity_(capacity_bytes), shards_(size_t{1} << (shard_bits < 0 ? 0 : shard_bits)) {}
+
+size_t BlockCache::KeyHash::operator()(const Key& k) const {
+    uint64_t words[2] = {k.owner ^ (static_cast<uint64_t>(k.file_seq) << 32), k.offset};
+    return static_cast<size_t>(hash64(words, sizeof(words), 0x626c6b63));
+}
+
+std::shared_ptr<const SSTableBlock> BlockCache::lookup(uint64_t owner, uint32_t file_seq, uint64_t offset) {
+    Key key{owner, offset, file_seq};
+    Shard& shard = shard_for(KeyHash()(key));
+    std::lock_guard<std::mutex> lock(shard.mu);
+    auto it = shard.map.find(key);
+    if (it == shard.map.end()) {
+        misses_.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+    hits_.fetch_add(1, std::memory_order_relaxed);
+    return it->second->block;
+}
+
+size_t BlockCache::insert(uint64_t owner, uint32_t file_seq, uint64_t offset,
+                          std::shared_ptr<const SSTableBlock> block, size_t charge) {
+    Key key{owner, offset, file_seq};
+    Shard& shard = shard_for(KeyHash()(key));
+
+    // Pinned metadata comes out of every shard's share.
+    size_t pinned = pinned_usage();
+    size_t shard_capacity = (capacity_ > pinned ? capacity_ - pinned : 0) / shards_.size();
+
+    std::lock_guard<std::mutex> lock(shard.mu);
+    auto it = shard.map.find(key);
+    if (it != shard.map.end()) {
+        shard.usage -= it->second->charge;
+        shard.lru.erase(it->second);
+        shard.map.erase(it);
+    }
+    if (charge > shard_capacity) return 0;   // would evict everything and still not fit
+
+    shard.lru.push_front(Entry{key, std::move(block), charge});
+    shard.map[key] = shard.lru.begin();
+    shard.usage += charge;
+
+    size_t evicted = 0;
+    while (shard.usage > shard_capacity) {
+        Entry& victim = shard.lru.back();
+        shard.usage -= victim.charge;
+        shard.map.erase(victim.key);
+        shard.lru.pop_back();
+        evicted++;
+    }
+    evictions_.fetch_add(evicted, std::memory_order_relaxed);
+    return evicted;
+}
+
+size_t BlockCache::usage() const {
+    size_t total = 0;
+    for (const auto& shard : shards_) {
+        std::lock_guard<std::mutex> lock(shard.mu);
+        total += shard.usage;
+    }
+    return total;
+}
@@ -101,8 +101,23 @@ void BloomFilter::cleanup() {
 }
 
 void BloomFilter::build(const std::vector<std::string>& keys, double fp_rate) {
+    build(std::vector<std::string_view>(keys.begin(), keys.end()), fp_rate);
+}
+
+uint64_t BloomFilter::key_hash(std::string_view key) {
+    return hash64(key.data(), static_cast<int>(key.size()), 0x9747b28c);
+}
+
+void BloomFilter::build(const std::vector<std::string_view>& keys, double fp_rate) {
+    std::vector<uint64_t> hashes;
+    hashes.reserve(keys.size());
+    for (const auto& key : keys) hashes.push_back(key_hash(key));
+    build_from_hashes(hashes, fp_rate);
+}
+
+void BloomFilter::build_from_hashes(const std::vector<uint64_t>& hashes, double fp_rate) {
     cleanup();
-    size_t n = keys.size();
+    size_t n = hashes.size();
     if (n == 0) { k_ = 0; m_ = 0; return; }
 
     // Calculate optimal sizing
@@ -117,8 +132,7 @@ void BloomFilter::build(const std::vector<std::string>& keys, double fp_rate) {
     m_ = byte_size * 8; // Force exactly strict explicit native 8-bit evaluations mathematically aligning disk layouts natively smoothly elegantly fluently
     bits_.assign(byte_size, 0);
 
-    for (const auto& key : keys) {
-        uint64_t base = hash64(key.data(), key.size(), 0x9747b28c);
+    for (uint64_t base : hashes) {
         uint64_t h1 = base;
         uint64_t h2 = (base >> 33) | (base << 31);
 
@@ -130,6 +144,23 @@ void BloomFilter::build(const std::vector<std::string>& keys, double fp_rate) {
     mmap_ptr_ = bits_.data();
 }
 
+void BloomFilter::load(std::vector<uint8_t> bits, uint32_t k) {
+    cleanup();
+    if (bits.empty()) return;
+    k_ = k;
+    m_ = static_cast<uint64_t>(bits.size()) * 8;
+    bits_ = std::move(bits);
+    mmap_ptr_ = bits_.data();
+}
+
+void BloomFilter::load_view(const uint8_t* bits, size_t size, uint32_t k) {
+    cleanup();
+    if (size == 0) return;
+    k_ = k;
+    m_ = static_cast<uint64_t>(size) * 8;
+    mmap_ptr_ = bits;
+}
+
 bool BloomFilter::load(const std::string& file_path, uint64_t file_offset, uint32_t bloom_size, uint32_t k) {
     cleanup();
     if (bloom_size == 0) return true;
@@ -204,10 +235,10 @@ bool BloomFilter::load(const std::string& file_path, uint64_t file_offset, uint3
 }
 
 bool BloomFilter::may_contain(const std::string& key) const {
-    const uint8_t* ptr = mmap_view_ ? mmap_ptr_ : (bits_.empty() ? nullptr : bits_.data());
+    const uint8_t* ptr = mmap_ptr_;   // heap bits, a mapped view or borrowed bytes
     if (!ptr || m_ == 0 || k_ == 0) return true; // Safe fallback (false positive equivalent)
 
-    uint64_t base = hash64(key.data(), key.size(), 0x9747b28c);
+    uint64_t base = key_hash(key);
     uint64_t h1 = base;
     uint64_t h2 = (base >> 33) | (base << 31);
 
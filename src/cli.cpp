@@ -65,17 +65,29 @@ void CLI::parse_command(KVStore& store, const std::string& cmd_line) {
                 std::cerr << "Error: load requires positive integer.\n";
                 return;
             }
+            // Ingest in batches: one WAL record and one fsync per 1000 keys.
+            WriteBatch batch;
             for (int i = 0; i < n; ++i) {
-                store.put("load_" + std::to_string(i), "val_" + std::to_string(i));
+                batch.put("load_" + std::to_string(i), "val_" + std::to_string(i));
+                if (batch.count() == 1000) { store.write(batch); batch.clear(); }
             }
+            store.write(batch);
             std::cout << "Loaded " << n << " keys.\n";
         }
         else if (cmd == "bench") {
             std::string type;
             iss >> type;
+            if (type == "append") {
+                Benchmark::run_append_micro();
+                return;
+            }
+            if (type == "crc") {
+                Benchmark::run_checksum_micro();
+                return;
+            }
             if (type != "random_write" && type != "sequential_write" && 
                 type != "random_read" && type != "mixed") {
-                std::cerr << "Error: valid types are random_write, sequential_write, random_read, mixed.\n";
+                std::cerr << "Error: valid types are random_write, sequential_write, random_read, mixed, append, crc.\n";
                 return;
             }
             std::cout << "Running benchmark " << type << " (20,000 ops)... " << std::flush;
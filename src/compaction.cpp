@@ -1,154 +1,415 @@
 #include "compaction.h"
 #include "kvstore.h"
+#include "merge_iterator.h"
 
+#include <algorithm>
+#include <cstdint>
+#include <exception>
 #include <filesystem>
 #include <iostream>
-#include <map>
-#include <set>
 #include <stdexcept>
+#include <string>
+#include <thread>
 #include <vector>
 
-void run_compaction(KVStore* store) {
-    auto& manifest = store->manifest_;
-    if (manifest.l0_seqs.empty()) return;
+// True if a table of some level in `levels` covers `key`. Each level is
+// sorted by key and disjoint, so one binary search per level.
+static bool any_level_covers(const std::vector<std::vector<SSTableHandle>>& levels,
+                             const std::string& key) {
+    for (const auto& level : levels) {
+        auto it = std::lower_bound(level.begin(), level.end(), key,
+            [](const SSTableHandle& t, const std::string& k) { return t->max_key() < k; });
+        if (it != level.end() && (*it)->overlaps(key, key)) return true;
+    }
+    return false;
+}
+
+// Removes the tables in `gone` from `tables`.
+static void remove_tables(std::vector<SSTableHandle>& tables, const std::vector<SSTableHandle>& gone) {
+    tables.erase(std::remove_if(tables.begin(), tables.end(),
+                                [&](const SSTableHandle& r) {
+                                    return std::find(gone.begin(), gone.end(), r) != gone.end();
+                                }),
+                 tables.end());
+}
+
+// Start keys of up to max_ranges - 1 key ranges splitting the merge of
+// `tables` into parts of roughly equal size, or none if the tables hold no
+// more than one target_file_size. Boundaries come from block separators
+// sampled evenly from every table.
+static std::vector<std::string> split_points(const std::vector<SSTableHandle>& tables,
+                                             size_t max_ranges, uint64_t target_file_size) {
+    uint64_t bytes = 0;
+    for (const auto& t : tables) bytes += t->file_size();
+    size_t ranges = std::min<uint64_t>(max_ranges, bytes / std::max<uint64_t>(target_file_size, 1));
+    if (ranges < 2) return {};
+
+    const size_t per_table = 4 * ranges;
+    std::vector<std::string> samples;
+    for (const auto& t : tables) {
+        size_t blocks = t->entry_count() == 0 ? 0 : t->block_count();
+        size_t n = std::min(blocks, per_table);
+        for (size_t i = 0; i < n; ++i) samples.push_back(t->block_separator(i * blocks / n));
+    }
+    std::sort(samples.begin(), samples.end());
+    samples.erase(std::unique(samples.begin(), samples.end()), samples.end());
+    if (samples.empty()) return {};
+
+    std::vector<std::string> bounds;
+    for (size_t j = 1; j < ranges; ++j) {
+        const std::string& b = samples[j * samples.size() / ranges];
+        if (!b.empty() && (bounds.empty() || bounds.back() < b)) bounds.push_back(b);
+    }
+    return bounds;
+}
 
-    // 1. Snapshot inputs.
-    std::vector<uint32_t> l0_inputs = manifest.l0_seqs;
-    std::string global_min = "\xFF", global_max = "";
+// One sorted run under universal compaction: an L0 table (`index` is its
+// position in L0) or a whole deeper level.
+struct SortedRun {
+    size_t   level;
+    size_t   index;
+    uint64_t bytes;
+};
 
-    auto get_l0_reader = [&](uint32_t seq) -> const SSTableReader* {
-        for (const auto& r : store->l0_sstables_) {
-            if (r.sequence() == seq) return &r;
+// The sorted runs of `levels`, newest first.
+static std::vector<SortedRun> sorted_runs(const std::vector<std::vector<SSTableHandle>>& levels) {
+    std::vector<SortedRun> runs;
+    for (size_t i = 0; i < levels[0].size(); ++i) runs.push_back({0, i, levels[0][i]->file_size()});
+    for (size_t n = 1; n < levels.size(); ++n) {
+        if (levels[n].empty()) continue;
+        uint64_t bytes = 0;
+        for (const auto& t : levels[n]) bytes += t->file_size();
+        runs.push_back({n, 0, bytes});
+    }
+    return runs;
+}
+
+// Picks the newest-first runs [first, last] a universal compaction merges
+// (see Options::universal_run_trigger). With fewer runs than the trigger
+// every run is merged. False if there is at most one run.
+static bool pick_universal(const std::vector<SortedRun>& runs, const Options& opts,
+                           size_t& first, size_t& last) {
+    const size_t k = runs.size();
+    const size_t trigger = std::max<uint32_t>(opts.universal_run_trigger, 2);
+    if (k < 2) return false;
+    first = 0;
+    last = k - 1;
+    if (k < trigger) return true;
+
+    // Space amplification: at worst everything newer than the oldest run
+    // only overwrites or deletes what it holds.
+    uint64_t newer = 0;
+    for (size_t i = 0; i + 1 < k; ++i) newer += runs[i].bytes;
+    if (newer * 100 > runs[k - 1].bytes * opts.universal_max_space_amp) return true;
+
+    // Size ratio: grow a window of runs while the next older run is no
+    // larger than the window so far (plus the ratio).
+    for (size_t start = 0; start + 1 < k; ++start) {
+        uint64_t window = runs[start].bytes;
+        size_t end = start;
+        while (end + 1 < k && runs[end + 1].bytes * 100 <= window * (100 + opts.universal_size_ratio))
+            window += runs[++end].bytes;
+        if (end > start) {
+            first = start;
+            last = end;
+            return true;
         }
-        return nullptr;
-    };
-
-    for (uint32_t seq : l0_inputs) {
-        auto r = get_l0_reader(seq);
-        if (!r) continue;
-        if (r->min_key() < global_min) global_min = r->min_key();
-        if (r->max_key() > global_max) global_max = r->max_key();
     }
 
-    // 2. Find overlapping L1 files.
-    std::vector<uint32_t> l1_inputs;
-    std::vector<uint32_t> l1_retained;
+    // Runs of steeply growing size: merge just enough of the newest to get
+    // below the trigger.
+    last = k - trigger + 1;
+    return true;
+}
 
-    auto get_l1_reader = [&](uint32_t seq) -> const SSTableReader* {
-        for (const auto& r : store->l1_sstables_) {
-            if (r.sequence() == seq) return &r;
+bool run_compaction(KVStore* store) {
+    std::unique_lock<std::mutex> lock(store->mu_);
+    store->compaction_done_cv_.wait(lock, [&] { return !store->compaction_running_; });
+
+    auto& manifest = store->manifest_;
+    auto& levels = store->levels_;
+    const bool universal = store->options_.compaction_style == CompactionStyle::kUniversal;
+
+    // Snapshot inputs. The handles keep the tables alive while mu_ is
+    // dropped. `inputs` go newest first, then the overlapping `next_inputs`
+    // of the output level; `deeper` holds the older levels that decide
+    // which tombstones may go.
+    size_t level = 0, output = 1;
+    std::vector<SSTableHandle> inputs, next_inputs, moved;
+    KVStore::Levels deeper;
+    std::vector<SortedRun> runs;
+    size_t first = 0, last = 0;
+    bool to_l0 = false;
+    std::string compacted_to;   // leveled, level > 0: next compact pointer
+    if (universal) {
+        // 1-3. Pick consecutive sorted runs. A caller with nothing due
+        //      merges every run.
+        runs = sorted_runs(levels);
+        if (!pick_universal(runs, store->options_, first, last)) return false;
+        for (size_t i = first; i <= last; ++i) {
+            if (runs[i].level == 0) inputs.push_back(levels[0][runs[i].index]);
+            else inputs.insert(inputs.end(), levels[runs[i].level].begin(), levels[runs[i].level].end());
+        }
+        // L0 tables overlap, so each older one is a level of its own here.
+        for (size_t i = last + 1; i < runs.size(); ++i) {
+            if (runs[i].level == 0) deeper.push_back({levels[0][runs[i].index]});
+            else deeper.push_back(levels[runs[i].level]);
+        }
+        // Output newer than an L0 table left behind stays in L0, as one
+        // table so it stays one run.
+        to_l0 = runs[last].level == 0 && runs[last].index + 1 < levels[0].size();
+    } else {
+        // 1. Pick the level to move down. A caller with nothing due still
+        //    pushes L0 into L1.
+        if (store->compaction_score(level) < 1) {
+            level = 0;
+            if (levels[0].empty()) return false;
         }
-        return nullptr;
-    };
-
-    for (uint32_t seq : manifest.l1_seqs) {
-        auto r = get_l1_reader(seq);
-        if (!r) continue;
-        // Overlap detection via key range intersection.
-        if (r->overlaps(global_min, global_max)) {
-            l1_inputs.push_back(seq);
+        output = level + 1;
+
+        // 2. L0 tables overlap, so all of L0 (newest-first) goes down at
+        //    once; a deeper level gives up one table, the first past its
+        //    compact pointer, so successive compactions cycle through its
+        //    keys.
+        if (level == 0) {
+            inputs = levels[0];
         } else {
-            l1_retained.push_back(seq);
+            const auto& tables = levels[level];
+            const std::string& after = store->compact_pointer_[level];
+            auto it = std::find_if(tables.begin(), tables.end(),
+                                   [&](const SSTableHandle& t) { return t->min_key() > after; });
+            inputs.push_back(it == tables.end() ? tables.front() : *it);
         }
-    }
+        if (level > 0) compacted_to = inputs.front()->max_key();
 
-    // 3. Collect keys from input L1 files (for safe tombstone eviction).
-    std::set<std::string> l1_keys;
-    for (uint32_t seq : l1_inputs) {
-        auto r = get_l1_reader(seq);
-        for (const auto& e : r->entries()) {
-            l1_keys.insert(e.key);
+        // Trivial move: an input overlapping no other input and no table of
+        // the output level only changes level, with no data I/O. Its keys
+        // then fence the merge output, so output tables cannot straddle it.
+        for (const auto& r : inputs) {
+            if (r->entry_count() == 0) continue;
+            auto overlaps_r = [&](const SSTableHandle& o) {
+                return o != r && o->overlaps(r->min_key(), r->max_key());
+            };
+            if (std::none_of(inputs.begin(), inputs.end(), overlaps_r) &&
+                std::none_of(levels[output].begin(), levels[output].end(), overlaps_r))
+                moved.push_back(r);
         }
-    }
+        remove_tables(inputs, moved);
 
-    // 4. K-Way merge (Duplicate Resolution: newest version wins).
-    // COMPACTION ORDERING (STRICT PRIORITY):
-    // std::map::insert ignores duplicates. By inserting sources in strictly newest-to-oldest order
-    // (Newest L0 -> Oldest L0 -> L1), we naturally guarantee that only the newest sequence 
-    // of any given key is retained. Older overlapping sequences are explicitly discarded.
-    std::map<std::string, VLogPointer> merged;
-
-    // Precedence 1: Newest L0 to Oldest L0.
-    // L0 files are appended normally, so reverse order = newest first.
-    for (auto it = l0_inputs.rbegin(); it != l0_inputs.rend(); ++it) {
-        auto r = get_l0_reader(*it);
-        if (!r) continue;
-        for (const auto& e : r->entries()) {
-            merged.insert({e.key, e.pointer}); // insert only succeeds if key not already present
+        std::string global_min = "\xFF", global_max = "";
+        for (const auto& r : inputs) {
+            if (r->entry_count() == 0) continue;
+            if (r->min_key() < global_min) global_min = r->min_key();
+            if (r->max_key() > global_max) global_max = r->max_key();
         }
-    }
 
-    // Precedence 2: L1 inputs.
-    for (uint32_t seq : l1_inputs) {
-        auto r = get_l1_reader(seq);
-        if (!r) continue;
-        for (const auto& e : r->entries()) {
-            merged.insert({e.key, e.pointer});
+        // 3. Find overlapping files of the output level.
+        for (const auto& r : levels[output]) {
+            // Overlap detection via key range intersection.
+            if (!inputs.empty() && r->overlaps(global_min, global_max)) next_inputs.push_back(r);
         }
+        deeper.assign(levels.begin() + output + 1, levels.end());
     }
 
-    // 5. Filter tombstones according to safety rules.
-    for (auto it = merged.begin(); it != merged.end(); ) {
-        if (is_tombstone(it->second)) {
-            // ONLY drop tombstone if key does NOT exist in input L1 files.
-            if (l1_keys.find(it->first) == l1_keys.end()) {
-                it = merged.erase(it);
-                continue;
-            }
+    store->compaction_running_ = true;
+    std::vector<SSTableHandle> new_tables;
+    KVStore::Levels next_levels;
+    uint64_t storage_bytes = 0;
+    size_t ranges = 1;
+    try {
+        lock.unlock();
+
+        // 4. Split the key range for parallel subcompactions. Each range
+        //    merges the same inputs from its own start key, so ranges share
+        //    nothing but the tables, which are read-only.
+        std::vector<SSTableHandle> all = inputs;
+        all.insert(all.end(), next_inputs.begin(), next_inputs.end());
+        size_t max_ranges = store->options_.max_subcompactions;
+        if (max_ranges == 0) max_ranges = std::max(1u, std::thread::hardware_concurrency());
+        const uint64_t table_bytes = to_l0 ? UINT64_MAX : store->options_.target_file_size;
+        std::vector<std::string> bounds =
+            to_l0 ? std::vector<std::string>() : split_points(all, max_ranges, table_bytes);
+        ranges = bounds.size() + 1;
+        if (ranges > 1 && !store->compaction_pool_) {
+            store->compaction_pool_ = std::make_unique<ThreadPool>(max_ranges - 1);
         }
-        ++it;
-    }
 
-    // 6. Write new L1 SSTables (chunked by threshold).
-    std::vector<uint32_t> new_l1_seqs;
-    std::map<std::string, VLogPointer> chunk;
-    size_t chunk_size = 0;
-
-    auto flush_chunk = [&]() {
-        if (chunk.empty()) return;
-        uint32_t seq = store->next_sst_sequence();
-        std::string path = store->sst_path(seq);
-        if (!SSTableWriter::write(path, chunk)) {
-            throw std::runtime_error("[Compaction] Failed to write new L1 SSTable");
+        // 5. Streaming k-way merge of range j, [bounds[j-1], bounds[j]).
+        //    Sources go in strictly newest-to-oldest order (newest L0 ->
+        //    oldest L0 -> output level), so the merge keeps only the newest
+        //    version of each key. Memory is one data block per source.
+        //    Output tables are cut at target_file_size (not in L0).
+        std::vector<std::vector<SSTableHandle>> outputs(ranges);
+        std::vector<uint64_t> output_bytes(ranges, 0);
+        std::vector<std::string> fences;   // min keys of the moved tables
+        for (const auto& r : moved) fences.push_back(r->min_key());
+        std::sort(fences.begin(), fences.end());
+        auto subcompact = [&](size_t j) {
+            std::vector<std::unique_ptr<KeyIterator>> sources;
+            for (const auto& r : all) sources.push_back(std::make_unique<SSTableKeyIterator>(r));
+            MergingIterator merged(std::move(sources));
+
+            SSTableBuilder builder(store->io_.get());
+            bool building = false;
+            auto fence = fences.end();   // first fence above the table being built
+            auto finish_table = [&]() {
+                building = false;
+                if (!builder.finish()) {
+                    throw std::runtime_error("[Compaction] Failed to write new SSTable");
+                }
+                output_bytes[j] += builder.file_size();
+                auto reader = std::make_shared<SSTableReader>();
+                if (!reader->load(builder.path(), store->sst_read_context())) {
+                    throw std::runtime_error("[Compaction] Failed to load new SSTable");
+                }
+                outputs[j].push_back(std::move(reader));
+            };
+
+            if (j == 0) merged.seek_to_first();
+            else merged.seek(bounds[j - 1]);
+            for (; merged.valid(); merged.next()) {
+                if (j < bounds.size() && merged.key() >= bounds[j]) break;
+                // 6. Filter tombstones. Older versions in the inputs are
+                //    merged away under the tombstone, so it may go unless a
+                //    deeper level still holds an older version it has to hide.
+                if (is_tombstone(merged.pointer()) && !any_level_covers(deeper, std::string(merged.key())))
+                    continue;
+                auto above = std::upper_bound(fences.begin(), fences.end(), merged.key());
+                if (building && above != fence) finish_table();
+                fence = above;
+                if (!building) {
+                    uint32_t seq;
+                    {
+                        std::lock_guard<std::mutex> seq_lock(store->mu_);
+                        seq = store->next_sst_sequence();
+                    }
+                    if (!builder.open(store->sst_path(seq))) {
+                        throw std::runtime_error("[Compaction] Failed to write new SSTable");
+                    }
+                    building = true;
+                }
+                builder.add(merged.key(), merged.pointer());
+                if (builder.file_size() >= table_bytes) finish_table();
+            }
+            // A data block that fails its checksum aborts the compaction
+            // rather than dropping keys.
+            if (!merged.ok()) {
+                throw std::runtime_error("[Compaction] Corrupt data block in an input SSTable");
+            }
+            if (building) finish_table();
+        };
+
+        // Range 0 runs here, the rest on the pool. Every range is waited
+        // for before the first error is rethrown: they all use this frame.
+        std::vector<std::future<void>> jobs;
+        for (size_t j = 1; j < ranges; ++j) {
+            jobs.push_back(store->compaction_pool_->submit([&subcompact, j] { subcompact(j); }));
         }
-        store->add_storage_bytes(24); // Footer approx byte cost for the new L1 chunk
-        new_l1_seqs.push_back(seq);
-        
-        // Emulate KVStore next_sst_sequence advancement for multi-chunk
-        // Since next_sst_sequence derives from filesystem, the creation of the file
-        // on disk automatically updates the sequence logically! 
-        // But to be absolutely safe, let's keep chunking logic independent.
-
-        chunk.clear();
-        chunk_size = 0;
-    };
-
-    for (const auto& [k, v] : merged) {
-        chunk[k] = v;
-        chunk_size += k.size() + 20; // key + VLogPointer
-        store->add_storage_bytes(k.size() + 20); // Metric tracking
-        if (chunk_size >= KVStore::FLUSH_THRESHOLD) flush_chunk();
-    }
-    flush_chunk();
+        std::exception_ptr error;
+        try {
+            subcompact(0);
+        } catch (...) {
+            error = std::current_exception();
+        }
+        for (auto& job : jobs) {
+            try {
+                job.get();
+            } catch (...) {
+                if (!error) error = std::current_exception();
+            }
+        }
+        for (size_t j = 0; j < ranges; ++j) {
+            new_tables.insert(new_tables.end(), outputs[j].begin(), outputs[j].end());
+            storage_bytes += output_bytes[j];
+        }
+        if (error) std::rethrow_exception(error);
+        lock.lock();
 
-    // 7. Atomic Manifest Update (Visibility strictly tied to commit).
-    manifest.version++;
-    manifest.l0_seqs.clear(); // all L0 compacted
-    manifest.l1_seqs = l1_retained;
-    manifest.l1_seqs.insert(manifest.l1_seqs.end(), new_l1_seqs.begin(), new_l1_seqs.end());
+        // 7. Atomic Manifest Update (Visibility strictly tied to commit).
+        //    Only the input runs or levels change; tables flushed into L0
+        //    while we merged are newer than every input and stay there.
+        auto by_key = [](const SSTableHandle& a, const SSTableHandle& b) { return a->min_key() < b->min_key(); };
+        next_levels = levels;
+        if (universal) {
+            // The output run takes the place of the input runs: in L0 where
+            // the newest input was, or as the level of the newest input
+            // level (L1 if all inputs were in L0). Emptied levels go.
+            auto& l0 = next_levels[0];
+            auto at = std::find_if(l0.begin(), l0.end(), [&](const SSTableHandle& r) {
+                return std::find(inputs.begin(), inputs.end(), r) != inputs.end();
+            });
+            size_t pos = static_cast<size_t>(at - l0.begin());
+            remove_tables(l0, inputs);
+            for (size_t i = first; i <= last; ++i)
+                if (runs[i].level > 0) next_levels[runs[i].level].clear();
+            std::sort(new_tables.begin(), new_tables.end(), by_key);
+            if (to_l0) {
+                l0.insert(l0.begin() + pos, new_tables.begin(), new_tables.end());
+            } else if (!new_tables.empty()) {
+                output = runs[first].level > 0 ? runs[first].level : 1;
+                next_levels.insert(next_levels.begin() + output, new_tables);
+            }
+            next_levels.erase(std::remove_if(next_levels.begin() + 1, next_levels.end(),
+                                             [](const std::vector<SSTableHandle>& l) { return l.empty(); }),
+                              next_levels.end());
+        } else {
+            remove_tables(next_levels[level], inputs);
+            remove_tables(next_levels[level], moved);
+            auto& down = next_levels[output];
+            remove_tables(down, next_inputs);
+            down.insert(down.end(), new_tables.begin(), new_tables.end());
+            down.insert(down.end(), moved.begin(), moved.end());
+            std::sort(down.begin(), down.end(), by_key);
+        }
 
-    if (!manifest.commit(store->manifest_path())) {
-        throw std::runtime_error("[Compaction] Manifest atomic rename failed");
+        Manifest next = manifest;
+        next.version++;
+        KVStore::describe_levels(next_levels, next);
+        if (!next.commit(store->manifest_path())) {
+            throw std::runtime_error("[Compaction] Manifest atomic rename failed");
+        }
+        manifest = next;
+    } catch (...) {
+        if (!lock.owns_lock()) lock.lock();
+        store->compaction_running_ = false;
+        store->compaction_done_cv_.notify_all();
+        throw;
     }
 
-    std::cout << "[Compaction] Merged " << l0_inputs.size() << " L0 and " 
-              << l1_inputs.size() << " L1 files into " 
-              << new_l1_seqs.size() << " new L1 files.\n";
+    // 8. Swap the table lists so the read path sees the committed state.
+    levels = std::move(next_levels);
+    store->compact_pointer_.resize(levels.size());
+    if (level > 0) store->compact_pointer_[level] = compacted_to;
+    store->install_version();
+    store->add_storage_bytes(storage_bytes);
+    store->metrics_.compaction_bytes_written += storage_bytes;
+    store->metrics_.trivial_moves += moved.size();
+    if (ranges > 1) store->metrics_.subcompactions += ranges;
+    store->compaction_running_ = false;
+    store->compaction_done_cv_.notify_all();
+    lock.unlock();
 
-    // 8. Safely delete old compacted files from disk.
-    for (uint32_t seq : l0_inputs) std::filesystem::remove(store->sst_path(seq));
-    for (uint32_t seq : l1_inputs) std::filesystem::remove(store->sst_path(seq));
+    if (universal) {
+        std::cout << "[Compaction] Merged " << last - first + 1 << " sorted runs (" << inputs.size()
+                  << " files) into " << new_tables.size() << " new " << (to_l0 ? "L0" : "L" + std::to_string(output))
+                  << " files";
+    } else if (inputs.empty()) {
+        std::cout << "[Compaction] Moved " << moved.size() << " L" << level << " files to L" << output;
+    } else {
+        std::cout << "[Compaction] Merged " << inputs.size() << " L" << level << " and "
+                  << next_inputs.size() << " L" << output << " files into "
+                  << new_tables.size() << " new L" << output << " files";
+        if (!moved.empty()) std::cout << ", moved " << moved.size() << " L" << level << " files";
+    }
+    if (ranges > 1) std::cout << " in " << ranges << " subcompactions";
+    std::cout << ".\n";
 
-    // 9. Reload state so read path sees the new manifest state correctly.
-    store->load_sstables();
+    // 9. Safely delete old compacted files from disk. Readers still pinning
+    //    an older Version keep reading blocks through their open fds (on
+    //    Windows the open file cannot be removed; it is left behind, outside
+    //    the manifest).
+    std::error_code ec;
+    for (const auto& r : inputs) std::filesystem::remove(r->path(), ec);
+    for (const auto& r : next_inputs) std::filesystem::remove(r->path(), ec);
+    return true;
 }
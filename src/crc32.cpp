@@ -1,37 +1,149 @@
 #include "crc32.h"
 #include <cstring>
-#include <vector>
-
-// CRC32 lookup table (IEEE 802.3 polynomial, reflected).
-static uint32_t crc32_table[256];
-static bool     crc32_table_initialized = false;
-
-static void init_crc32_table() {
-    for (uint32_t i = 0; i < 256; ++i) {
-        uint32_t crc = i;
-        for (int j = 0; j < 8; ++j)
-            crc = (crc >> 1) ^ (0xEDB88320 & (-(crc & 1)));
-        crc32_table[i] = crc;
+
+// ── Platform abstraction ───────────────────────────────────────
+// SSE4.2 code is compiled with a per-function target attribute so the rest
+// of the binary still runs on CPUs without it; the CPU is checked at runtime.
+#if defined(__x86_64__) || defined(_M_X64)
+  #define STDB_CRC32C_SSE42 1
+  #include <nmmintrin.h>
+  #if defined(_MSC_VER) && !defined(__clang__)
+    #include <intrin.h>
+    #define STDB_TARGET_SSE42
+    static bool cpu_has_sse42() {
+        int info[4];
+        __cpuid(info, 1);
+        return (info[2] >> 20) & 1;
+    }
+  #else
+    #define STDB_TARGET_SSE42 __attribute__((target("sse4.2")))
+    static bool cpu_has_sse42() { return __builtin_cpu_supports("sse4.2"); }
+  #endif
+#endif
+
+// ── Slicing-by-8 (portable) ────────────────────────────────────
+// tables[0] is the classic byte-at-a-time table for the reflected
+// polynomial; tables[k][b] advances the CRC of byte b by k more zero bytes,
+// so eight table lookups consume eight input bytes per iteration. Built once
+// per polynomial, on first use; function-local static init is thread-safe.
+template <uint32_t Poly>
+struct SlicingTables {
+    uint32_t t[8][256];
+    SlicingTables() {
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t crc = i;
+            for (int j = 0; j < 8; ++j)
+                crc = (crc >> 1) ^ (Poly & (0u - (crc & 1)));
+            t[0][i] = crc;
+        }
+        for (uint32_t i = 0; i < 256; ++i)
+            for (int k = 1; k < 8; ++k)
+                t[k][i] = (t[k - 1][i] >> 8) ^ t[0][t[k - 1][i] & 0xFF];
+    }
+};
+
+static constexpr uint32_t POLY_CRC32  = 0xEDB88320;   // IEEE 802.3, reflected
+static constexpr uint32_t POLY_CRC32C = 0x82F63B78;   // Castagnoli, reflected
+
+// On-disk integers are little-endian throughout, and so is this loop.
+template <uint32_t Poly>
+static uint32_t slicing_by_8(uint32_t crc, const uint8_t* p, size_t len) {
+    static const SlicingTables<Poly> tables;
+    const auto& t = tables.t;
+    uint32_t c = crc ^ 0xFFFFFFFF;
+    while (len >= 8) {
+        uint32_t lo, hi;
+        std::memcpy(&lo, p,     sizeof(uint32_t));
+        std::memcpy(&hi, p + 4, sizeof(uint32_t));
+        lo ^= c;
+        c = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24] ^
+            t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^ t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+        p   += 8;
+        len -= 8;
+    }
+    while (len-- > 0) c = (c >> 8) ^ t[0][(c ^ *p++) & 0xFF];
+    return c ^ 0xFFFFFFFF;
+}
+
+// ── SSE4.2 CRC32C ──────────────────────────────────────────────
+#ifdef STDB_CRC32C_SSE42
+STDB_TARGET_SSE42
+static uint32_t crc32c_sse42(uint32_t crc, const uint8_t* p, size_t len) {
+    uint64_t c = crc ^ 0xFFFFFFFF;
+    while (len >= 8) {
+        uint64_t v;
+        std::memcpy(&v, p, sizeof(uint64_t));
+        c = _mm_crc32_u64(c, v);
+        p   += 8;
+        len -= 8;
     }
-    crc32_table_initialized = true;
+    uint32_t c32 = static_cast<uint32_t>(c);
+    while (len-- > 0) c32 = _mm_crc32_u8(c32, *p++);
+    return c32 ^ 0xFFFFFFFF;
+}
+#endif
+
+// ── Runtime dispatch ───────────────────────────────────────────
+using CRCFunction = uint32_t (*)(uint32_t, const uint8_t*, size_t);
+
+static CRCFunction resolve_crc32c() {
+#ifdef STDB_CRC32C_SSE42
+    if (cpu_has_sse42()) return crc32c_sse42;
+#endif
+    return slicing_by_8<POLY_CRC32C>;
+}
+
+static CRCFunction crc32c_function() {
+    static const CRCFunction fn = resolve_crc32c();
+    return fn;
+}
+
+const char* crc32c_implementation() {
+#ifdef STDB_CRC32C_SSE42
+    if (crc32c_function() == crc32c_sse42) return "sse4.2";
+#endif
+    return "slicing-by-8";
+}
+
+// ── Public API ─────────────────────────────────────────────────
+
+uint32_t crc32_extend(uint32_t crc, const void* data, size_t len) {
+    return slicing_by_8<POLY_CRC32>(crc, static_cast<const uint8_t*>(data), len);
+}
+
+uint32_t crc32c_extend(uint32_t crc, const void* data, size_t len) {
+    return crc32c_function()(crc, static_cast<const uint8_t*>(data), len);
+}
+
+uint32_t crc32c_extend_portable(uint32_t crc, const void* data, size_t len) {
+    return slicing_by_8<POLY_CRC32C>(crc, static_cast<const uint8_t*>(data), len);
+}
+
+uint32_t checksum_extend(ChecksumType type, uint32_t crc, const void* data, size_t len) {
+    return type == ChecksumType::kCRC32C ? crc32c_extend(crc, data, len)
+                                         : crc32_extend(crc, data, len);
 }
 
 uint32_t compute_crc32(const uint8_t* data, size_t len) {
-    if (!crc32_table_initialized) init_crc32_table();
-    uint32_t crc = 0xFFFFFFFF;
-    for (size_t i = 0; i < len; ++i)
-        crc = (crc >> 8) ^ crc32_table[(crc ^ data[i]) & 0xFF];
-    return crc ^ 0xFFFFFFFF;
+    return crc32_extend(0, data, len);
 }
 
 uint32_t record_checksum(uint32_t key_size, uint32_t value_size,
-                         const std::string& key, const std::string& value) {
+                         std::string_view key, std::string_view value) {
     // Checksum covers: key_size + value_size + key_bytes + value_bytes
-    std::vector<uint8_t> buf(sizeof(uint32_t) * 2 + key.size() + value.size());
-    size_t off = 0;
-    std::memcpy(buf.data() + off, &key_size, sizeof(uint32_t));   off += sizeof(uint32_t);
-    std::memcpy(buf.data() + off, &value_size, sizeof(uint32_t)); off += sizeof(uint32_t);
-    std::memcpy(buf.data() + off, key.data(), key.size());        off += key.size();
-    std::memcpy(buf.data() + off, value.data(), value.size());
-    return compute_crc32(buf.data(), buf.size());
+    uint32_t crc = crc32_extend(0,   &key_size,   sizeof(uint32_t));
+    crc          = crc32_extend(crc, &value_size, sizeof(uint32_t));
+    crc          = crc32_extend(crc, key.data(),   key.size());
+    return         crc32_extend(crc, value.data(), value.size());
+}
+
+uint32_t record_checksum(ChecksumType type, uint32_t log_number,
+                         uint32_t key_size, uint32_t value_size,
+                         std::string_view key, std::string_view value) {
+    // Checksum covers: log_number + key_size + value_size + key_bytes + value_bytes
+    uint32_t crc = checksum_extend(type, 0,   &log_number, sizeof(uint32_t));
+    crc          = checksum_extend(type, crc, &key_size,   sizeof(uint32_t));
+    crc          = checksum_extend(type, crc, &value_size, sizeof(uint32_t));
+    crc          = checksum_extend(type, crc, key.data(),   key.size());
+    return         checksum_extend(type, crc, value.data(), value.size());
 }
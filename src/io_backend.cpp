@@ -0,0 +1,557 @@
+#include "io_backend.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+// ── Platform abstraction ───────────────────────────────────────
+#ifdef _WIN32
+  #ifndef NOMINMAX
+    #define NOMINMAX
+  #endif
+  #include <windows.h>
+  #include <io.h>
+  #define io_lseek(fd, o, w)    _lseeki64(fd, o, w)
+  #define io_write(fd, b, n)    _write(fd, b, static_cast<unsigned int>(n))
+  #define io_fsync(fd)          _commit(fd)
+  #ifndef EINTR
+    #define EINTR 0
+  #endif
+#else
+  #include <unistd.h>
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <sys/uio.h>
+  #include <climits>
+  #define io_fsync(fd)          fdatasync(fd)
+#endif
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+  #define STDB_HAVE_IO_URING 1
+  #include <linux/io_uring.h>
+  #include <sys/mman.h>
+  #include <sys/syscall.h>
+#endif
+
+// ── POSIX helpers (also the io_uring fallback path) ────────────
+
+// Write `len` bytes at `offset`, retrying on EINTR and short writes.
+static bool write_fully(int fd, const void* buf, size_t len, uint64_t offset) {
+    const uint8_t* p = static_cast<const uint8_t*>(buf);
+#ifdef _WIN32
+    if (io_lseek(fd, static_cast<long long>(offset), SEEK_SET) < 0) return false;
+#endif
+    while (len > 0) {
+#ifdef _WIN32
+        auto n = io_write(fd, p, len);
+#else
+        auto n = ::pwrite(fd, p, len, static_cast<off_t>(offset));
+#endif
+        if (n < 0) { if (errno == EINTR) continue; return false; }
+        if (n == 0) return false;
+        p      += n;
+        len    -= static_cast<size_t>(n);
+        offset += static_cast<uint64_t>(n);
+    }
+    return true;
+}
+
+#ifdef _WIN32
+// The Win32 pread: ReadFile with the offset in an OVERLAPPED, so concurrent
+// readers of one fd never race on a shared file position.
+static long long win_pread(int fd, void* buf, size_t len, uint64_t offset) {
+    HANDLE h = reinterpret_cast<HANDLE>(_get_osfhandle(fd));
+    OVERLAPPED ov = {};
+    ov.Offset     = static_cast<DWORD>(offset);
+    ov.OffsetHigh = static_cast<DWORD>(offset >> 32);
+    DWORD n = 0;
+    DWORD want = static_cast<DWORD>(std::min<size_t>(len, 1u << 30));
+    if (!ReadFile(h, buf, want, &n, &ov))
+        return GetLastError() == ERROR_HANDLE_EOF ? 0 : -1;
+    return n;
+}
+#endif
+
+// Read exactly `len` bytes at `offset`; false on error or EOF. Positioned
+// on every platform: safe to call from many threads on the same fd.
+static bool read_fully(int fd, void* buf, size_t len, uint64_t offset) {
+    uint8_t* p = static_cast<uint8_t*>(buf);
+    while (len > 0) {
+#ifdef _WIN32
+        auto n = win_pread(fd, p, len, offset);
+#else
+        auto n = ::pread(fd, p, len, static_cast<off_t>(offset));
+#endif
+        if (n < 0) { if (errno == EINTR) continue; return false; }
+        if (n == 0) return false;   // EOF
+        p      += n;
+        len    -= static_cast<size_t>(n);
+        offset += static_cast<uint64_t>(n);
+    }
+    return true;
+}
+
+// Write slices starting `skip` bytes into the logical buffer they form.
+static bool write_slices_from(int fd, const std::vector<IOSlice>& slices,
+                              uint64_t offset, size_t skip) {
+    for (const auto& s : slices) {
+        if (skip >= s.len) { skip -= s.len; offset += s.len; continue; }
+        const uint8_t* p = static_cast<const uint8_t*>(s.data) + skip;
+        size_t n = s.len - skip;
+        if (!write_fully(fd, p, n, offset + skip)) return false;
+        offset += s.len;
+        skip = 0;
+    }
+    return true;
+}
+
+// ── GatherBuffer ───────────────────────────────────────────────
+
+static std::atomic<uint64_t> g_copied_bytes{0};
+static std::atomic<uint64_t> g_referenced_bytes{0};
+
+void GatherBuffer::clear() {
+    arena_.clear();
+    pieces_.clear();
+    total_ = 0;
+}
+
+size_t GatherBuffer::copy(const void* data, size_t len) {
+    size_t off = arena_.size();
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    arena_.insert(arena_.end(), p, p + len);
+    // Extend the previous arena piece when contiguous: fewer iovecs.
+    if (!pieces_.empty() && !pieces_.back().external &&
+        pieces_.back().offset + pieces_.back().len == off) {
+        pieces_.back().len += len;
+    } else {
+        pieces_.push_back({nullptr, off, len});
+    }
+    total_ += len;
+    g_copied_bytes.fetch_add(len, std::memory_order_relaxed);
+    return off;
+}
+
+void GatherBuffer::add(const void* data, size_t len) {
+    if (len == 0) return;
+    if (len < COPY_THRESHOLD) {
+        copy(data, len);
+        return;
+    }
+    pieces_.push_back({data, 0, len});
+    total_ += len;
+    g_referenced_bytes.fetch_add(len, std::memory_order_relaxed);
+}
+
+void GatherBuffer::patch(size_t arena_offset, const void* data, size_t len) {
+    std::memcpy(arena_.data() + arena_offset, data, len);
+}
+
+const std::vector<IOSlice>& GatherBuffer::slices() {
+    // Resolved only now: arena_ may have moved while pieces were added.
+    slices_.clear();
+    for (const auto& p : pieces_)
+        slices_.push_back({p.external ? p.external : arena_.data() + p.offset, p.len});
+    return slices_;
+}
+
+uint64_t GatherBuffer::copied_bytes()     { return g_copied_bytes.load(std::memory_order_relaxed); }
+uint64_t GatherBuffer::referenced_bytes() { return g_referenced_bytes.load(std::memory_order_relaxed); }
+
+// ── MappedFile ─────────────────────────────────────────────────
+
+MappedFile::~MappedFile() { close(); }
+
+bool MappedFile::open(const std::string& path) {
+    close();
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                              NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER len;
+    if (!GetFileSizeEx(file, &len)) { CloseHandle(file); return false; }
+    size_ = static_cast<size_t>(len.QuadPart);
+    if (size_ == 0) { CloseHandle(file); return true; }
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);   // the mapping keeps its own reference
+    if (!mapping) { size_ = 0; return false; }
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if (!view) { size_ = 0; return false; }
+    data_ = static_cast<const uint8_t*>(view);
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0) { ::close(fd); return false; }
+    size_ = static_cast<size_t>(st.st_size);
+    if (size_ == 0) { ::close(fd); return true; }
+    void* view = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);   // the mapping keeps the file referenced
+    if (view == MAP_FAILED) { size_ = 0; return false; }
+    madvise(view, size_, MADV_SEQUENTIAL);
+    data_ = static_cast<const uint8_t*>(view);
+#endif
+    return true;
+}
+
+void MappedFile::close() {
+    if (data_) {
+#ifdef _WIN32
+        UnmapViewOfFile(data_);
+#else
+        munmap(const_cast<uint8_t*>(data_), size_);
+#endif
+    }
+    data_ = nullptr;
+    size_ = 0;
+}
+
+// ── POSIX backend ──────────────────────────────────────────────
+
+namespace {
+
+class PosixIOBackend : public IOBackend {
+public:
+    const char* name() const override { return "posix"; }
+
+    bool write(int fd, const std::vector<IOSlice>& slices, uint64_t offset, bool sync) override {
+#ifdef _WIN32
+        if (!write_slices_from(fd, slices, offset, 0)) return false;
+#else
+        // One pwritev per IOV_MAX slices; a short write finishes slice by slice.
+        size_t done = 0, total = 0;
+        for (const auto& s : slices) total += s.len;
+        std::vector<iovec> iov;
+        iov.reserve(std::min<size_t>(slices.size(), IOV_MAX));
+        for (size_t i = 0; i < slices.size(); ) {
+            iov.clear();
+            size_t batch = 0;
+            for (; i < slices.size() && iov.size() < IOV_MAX; ++i) {
+                iov.push_back({const_cast<void*>(slices[i].data), slices[i].len});
+                batch += slices[i].len;
+            }
+            ssize_t n;
+            do {
+                n = ::pwritev(fd, iov.data(), static_cast<int>(iov.size()),
+                              static_cast<off_t>(offset + done));
+            } while (n < 0 && errno == EINTR);
+            if (n < 0) return false;
+            done += static_cast<size_t>(n);
+            if (static_cast<size_t>(n) < batch) {
+                if (!write_slices_from(fd, slices, offset, done)) return false;
+                done = total;
+                break;
+            }
+        }
+#endif
+        return !sync || this->sync(fd);
+    }
+
+    bool read(std::vector<IORead>& reads) override {
+        bool all = true;
+        for (auto& r : reads) {
+            r.ok = read_fully(r.fd, r.buf, r.len, r.offset);
+            all = all && r.ok;
+        }
+        return all;
+    }
+
+    bool sync(int fd) override { return io_fsync(fd) == 0; }
+};
+
+} // namespace
+
+IOBackend* default_io_backend() {
+    static PosixIOBackend posix;
+    return &posix;
+}
+
+// ── io_uring backend (Linux) ───────────────────────────────────
+//
+// Talks to the kernel through the raw io_uring_setup / io_uring_enter
+// syscalls; no liburing dependency. Each thread lazily creates its own small
+// ring, so submissions need no locking. Any completion the ring cannot
+// fully handle (short transfer, -EAGAIN) is finished with the POSIX helpers.
+
+#ifdef STDB_HAVE_IO_URING
+namespace {
+
+class Ring {
+public:
+    static constexpr unsigned ENTRIES = 64;
+
+    Ring() {
+        io_uring_params p;
+        std::memset(&p, 0, sizeof(p));
+        int fd = static_cast<int>(::syscall(__NR_io_uring_setup, ENTRIES, &p));
+        if (fd < 0) return;
+        fd_ = fd;
+
+        sq_size_ = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        cq_size_ = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+        bool single = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single) sq_size_ = cq_size_ = std::max(sq_size_, cq_size_);
+
+        sq_ptr_ = ::mmap(nullptr, sq_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                         fd_, IORING_OFF_SQ_RING);
+        if (sq_ptr_ == MAP_FAILED) { sq_ptr_ = nullptr; return; }
+        cq_ptr_ = single ? sq_ptr_
+                         : ::mmap(nullptr, cq_size_, PROT_READ | PROT_WRITE,
+                                  MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_CQ_RING);
+        if (cq_ptr_ == MAP_FAILED) { cq_ptr_ = nullptr; return; }
+        sqes_size_ = p.sq_entries * sizeof(io_uring_sqe);
+        void* sqes = ::mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                            fd_, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED) return;
+        sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+        auto* sq = static_cast<uint8_t*>(sq_ptr_);
+        sq_tail_  = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+        sq_mask_  = *reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+        sq_array_ = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+        auto* cq = static_cast<uint8_t*>(cq_ptr_);
+        cq_head_  = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+        cq_tail_  = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+        cq_mask_  = *reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+        cqes_     = reinterpret_cast<io_uring_cqe*>(cq + p.cq_off.cqes);
+        ok_ = true;
+    }
+
+    ~Ring() {
+        if (sqes_) ::munmap(sqes_, sqes_size_);
+        if (cq_ptr_ && cq_ptr_ != sq_ptr_) ::munmap(cq_ptr_, cq_size_);
+        if (sq_ptr_) ::munmap(sq_ptr_, sq_size_);
+        if (fd_ >= 0) ::close(fd_);
+    }
+
+    Ring(const Ring&) = delete;
+    Ring& operator=(const Ring&) = delete;
+
+    bool ok() const { return ok_; }
+
+    // Queue one SQE; the caller fills it. At most ENTRIES per run().
+    io_uring_sqe* next_sqe() {
+        unsigned idx = pending_tail_ & sq_mask_;
+        io_uring_sqe* sqe = &sqes_[idx];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sq_array_[idx] = idx;
+        ++pending_tail_;
+        ++queued_;
+        return sqe;
+    }
+
+    // Submit everything queued with one io_uring_enter() and wait for all of
+    // it; res[user_data] receives each completion. False on a ring error.
+    bool run(std::vector<int>& res) {
+        __atomic_store_n(sq_tail_, pending_tail_, __ATOMIC_RELEASE);
+        unsigned to_submit = queued_, outstanding = queued_;
+        queued_ = 0;
+        while (outstanding > 0) {
+            int n = static_cast<int>(::syscall(__NR_io_uring_enter, fd_, to_submit, 1u,
+                                               IORING_ENTER_GETEVENTS, nullptr, 0));
+            if (n < 0) {
+                if (errno == EINTR || errno == EAGAIN || errno == EBUSY) continue;
+                ok_ = false;   // ring state unknown — stop using it
+                return false;
+            }
+            to_submit -= std::min<unsigned>(to_submit, static_cast<unsigned>(n));
+
+            unsigned head = *cq_head_;
+            unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+            for (; head != tail; ++head) {
+                const io_uring_cqe& cqe = cqes_[head & cq_mask_];
+                if (cqe.user_data < res.size()) res[cqe.user_data] = cqe.res;
+                --outstanding;
+            }
+            __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+        }
+        return true;
+    }
+
+private:
+    bool          ok_ = false;
+    int           fd_ = -1;
+    void*         sq_ptr_ = nullptr;
+    void*         cq_ptr_ = nullptr;
+    size_t        sq_size_ = 0, cq_size_ = 0, sqes_size_ = 0;
+    io_uring_sqe* sqes_ = nullptr;
+    unsigned*     sq_tail_ = nullptr;
+    unsigned*     sq_array_ = nullptr;
+    unsigned      sq_mask_ = 0;
+    unsigned*     cq_head_ = nullptr;
+    unsigned*     cq_tail_ = nullptr;
+    unsigned      cq_mask_ = 0;
+    io_uring_cqe* cqes_ = nullptr;
+    unsigned      pending_tail_ = 0;   // local copy of the SQ tail
+    unsigned      queued_ = 0;
+};
+
+// The calling thread's ring, or nullptr if io_uring is unavailable.
+Ring* thread_ring() {
+    thread_local Ring ring;
+    return ring.ok() ? &ring : nullptr;
+}
+
+class IoUringBackend : public IOBackend {
+public:
+    // Writes are split so that large SSTables keep several requests in
+    // flight instead of one giant one.
+    static constexpr size_t CHUNK_BYTES = 1u * 1024u * 1024u;
+
+    const char* name() const override { return "io_uring"; }
+
+    bool write(int fd, const std::vector<IOSlice>& slices, uint64_t offset, bool sync) override {
+        Ring* ring = thread_ring();
+        if (!ring) return posix()->write(fd, slices, offset, sync);
+
+        // Cut the slices into chunks of iovecs; each chunk is one WRITEV.
+        struct Chunk { size_t first_iov, iov_count, len; uint64_t offset; };
+        std::vector<iovec> iov;
+        std::vector<Chunk> chunks;
+        uint64_t pos = offset;
+        for (const auto& s : slices) {
+            const uint8_t* p = static_cast<const uint8_t*>(s.data);
+            size_t left = s.len;
+            while (left > 0) {
+                if (chunks.empty() || chunks.back().len == CHUNK_BYTES ||
+                    chunks.back().iov_count == IOV_MAX)
+                    chunks.push_back({iov.size(), 0, 0, pos});
+                size_t n = std::min(left, CHUNK_BYTES - chunks.back().len);
+                iov.push_back({const_cast<uint8_t*>(p), n});
+                chunks.back().iov_count++;
+                chunks.back().len += n;
+                p += n; left -= n; pos += n;
+            }
+        }
+
+        // Submit in windows that fit the ring; the fdatasync rides in the
+        // last window — linked to a lone write, or draining behind several.
+        bool fixed_up = false;
+        int  sync_res = 0;
+        const size_t window = Ring::ENTRIES - 1;
+        for (size_t start = 0; start < chunks.size() || (sync && start == 0); start += window) {
+            size_t end = std::min(chunks.size(), start + window);
+            bool last = end == chunks.size();
+            std::vector<int> res(end - start + 1, 0);
+            for (size_t i = start; i < end; ++i) {
+                io_uring_sqe* sqe = ring->next_sqe();
+                sqe->opcode    = IORING_OP_WRITEV;
+                sqe->fd        = fd;
+                sqe->addr      = reinterpret_cast<uint64_t>(&iov[chunks[i].first_iov]);
+                sqe->len       = static_cast<uint32_t>(chunks[i].iov_count);
+                sqe->off       = chunks[i].offset;
+                sqe->user_data = i - start;
+                if (sync && last && end - start == 1) sqe->flags |= IOSQE_IO_LINK;
+            }
+            if (sync && last) {
+                io_uring_sqe* sqe = ring->next_sqe();
+                sqe->opcode      = IORING_OP_FSYNC;
+                sqe->fd          = fd;
+                sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+                sqe->user_data   = end - start;
+                if (end - start > 1) sqe->flags |= IOSQE_IO_DRAIN;
+            }
+            if (!ring->run(res)) return posix()->write(fd, slices, offset, sync);
+
+            for (size_t i = start; i < end; ++i) {
+                int r = res[i - start];
+                if (r == -EAGAIN || r == -EINTR) r = 0;
+                if (r < 0) return false;
+                if (static_cast<size_t>(r) < chunks[i].len) {
+                    // Short write: finish the chunk synchronously.
+                    const Chunk& c = chunks[i];
+                    std::vector<IOSlice> rest;
+                    for (size_t k = 0; k < c.iov_count; ++k)
+                        rest.push_back({iov[c.first_iov + k].iov_base, iov[c.first_iov + k].iov_len});
+                    if (!write_slices_from(fd, rest, c.offset, static_cast<size_t>(r))) return false;
+                    fixed_up = true;
+                }
+            }
+            if (sync && last) sync_res = res[end - start];
+            if (last) break;
+        }
+
+        // A canceled / failed link or a fixed-up chunk needs a fresh sync.
+        if (sync && (sync_res < 0 || fixed_up)) return this->sync(fd);
+        return true;
+    }
+
+    bool read(std::vector<IORead>& reads) override {
+        Ring* ring = thread_ring();
+        if (!ring) return posix()->read(reads);
+
+        bool all = true;
+        std::vector<iovec> iov(reads.size());
+        for (size_t start = 0; start < reads.size(); start += Ring::ENTRIES) {
+            size_t end = std::min(reads.size(), start + Ring::ENTRIES);
+            std::vector<int> res(end - start, 0);
+            for (size_t i = start; i < end; ++i) {
+                iov[i] = {reads[i].buf, reads[i].len};
+                io_uring_sqe* sqe = ring->next_sqe();
+                sqe->opcode    = IORING_OP_READV;
+                sqe->fd        = reads[i].fd;
+                sqe->addr      = reinterpret_cast<uint64_t>(&iov[i]);
+                sqe->len       = 1;
+                sqe->off       = reads[i].offset;
+                sqe->user_data = i - start;
+            }
+            if (!ring->run(res)) {
+                std::vector<IORead> rest(reads.begin() + start, reads.end());
+                bool ok = posix()->read(rest);
+                std::copy(rest.begin(), rest.end(), reads.begin() + start);
+                return all && ok;
+            }
+            for (size_t i = start; i < end; ++i) {
+                IORead& r = reads[i];
+                int n = res[i - start];
+                if (n == -EAGAIN || n == -EINTR) n = 0;
+                if (n < 0) {
+                    r.ok = false;
+                } else {
+                    // Short read (or retry): finish with pread; EOF fails.
+                    size_t got = static_cast<size_t>(n);
+                    r.ok = got >= r.len ||
+                           read_fully(r.fd, static_cast<uint8_t*>(r.buf) + got, r.len - got, r.offset + got);
+                }
+                all = all && r.ok;
+            }
+        }
+        return all;
+    }
+
+    bool sync(int fd) override {
+        Ring* ring = thread_ring();
+        if (!ring) return posix()->sync(fd);
+        io_uring_sqe* sqe = ring->next_sqe();
+        sqe->opcode      = IORING_OP_FSYNC;
+        sqe->fd          = fd;
+        sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+        sqe->user_data   = 0;
+        std::vector<int> res(1, 0);
+        if (!ring->run(res)) return posix()->sync(fd);
+        return res[0] == 0;
+    }
+
+private:
+    static IOBackend* posix() { return default_io_backend(); }
+};
+
+} // namespace
+#endif // STDB_HAVE_IO_URING
+
+std::unique_ptr<IOBackend> make_io_backend(IOBackendKind kind) {
+    if (kind == IOBackendKind::kIoUring) {
+#ifdef STDB_HAVE_IO_URING
+        if (thread_ring()) return std::make_unique<IoUringBackend>();
+        std::cerr << "[IO] WARNING: io_uring unavailable (errno=" << errno
+                  << "), falling back to POSIX I/O\n";
+#else
+        std::cerr << "[IO] WARNING: io_uring not supported on this platform, using POSIX I/O\n";
+#endif
+    }
+    return std::make_unique<PosixIOBackend>();
+}
@@ -1,12 +1,17 @@
 #include "kvstore.h"
+#include "merge_iterator.h"
 #include "compaction.h"
 
 #include <algorithm>
+#include <chrono>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <filesystem>
 #include <iostream>
+#include <optional>
 #include <stdexcept>
+#include <thread>
 
 // ── Path helpers ───────────────────────────────────────────────
 
@@ -26,18 +31,24 @@ std::string KVStore::sst_path(uint32_t seq) const {
 
 std::string KVStore::manifest_path() const { return data_dir_ + "/MANIFEST"; }
 
-uint32_t KVStore::next_sst_sequence() const {
-    uint32_t max_seq = 0;
-    if (!std::filesystem::exists(data_dir_)) return 1;
-    for (const auto& entry : std::filesystem::directory_iterator(data_dir_)) {
-        auto name = entry.path().filename().string();
-        if (name.size() > 4 && name.substr(0, 4) == "sst_" &&
-            name.substr(name.size() - 4) == ".sst") {
-            uint32_t seq = static_cast<uint32_t>(std::strtoul(name.c_str()+4, nullptr, 10));
-            if (seq > max_seq) max_seq = seq;
-        }
-    }
-    return max_seq + 1;
+// A retired WAL kept for Options::recycle_wal. Not named wal_*.log, so
+// recovery never replays it.
+std::string KVStore::spare_wal_path() const { return data_dir_ + "/spare_wal.log"; }
+
+// Caller holds mu_. A flush takes its sequence before the file exists, so
+// sequences come from a counter seeded from the directory by recover().
+uint32_t KVStore::next_sst_sequence() {
+    return next_sst_seq_++;
+}
+
+SSTableReadContext KVStore::sst_read_context() const {
+    SSTableReadContext ctx;
+    ctx.io          = io_.get();
+    ctx.cache       = block_cache_.get();
+    ctx.cache_owner = cache_owner_;
+    ctx.metrics     = &metrics_;
+    ctx.mmap        = options_.sstable_mmap;
+    return ctx;
 }
 
 // Scan data_dir_ for wal_*.log files. Returns sorted paths and max id found.
@@ -62,199 +73,788 @@ void KVStore::scan_wal_files(std::vector<std::string>& paths, uint32_t& max_id)
 
 // ── Constructor ────────────────────────────────────────────────
 
-KVStore::KVStore(const std::string& data_dir)
-    : data_dir_(data_dir) {
+KVStore::KVStore(const std::string& data_dir, const Options& options)
+    : data_dir_(data_dir), options_(options), io_(make_io_backend(options.io_backend)),
+      block_cache_(options.block_cache) {
+    if (!block_cache_ && options_.block_cache_capacity > 0)
+        block_cache_ = std::make_shared<BlockCache>(options_.block_cache_capacity);
+    if (block_cache_) cache_owner_ = block_cache_->new_owner_id();
     std::filesystem::create_directories(data_dir_);
     recover();
+    sync_thread_  = std::thread(&KVStore::background_sync_loop, this);
+    flush_thread_ = std::thread(&KVStore::background_flush_loop, this);
+    compaction_thread_ = std::thread(&KVStore::background_compaction_loop, this);
+}
+
+// Clean close: finish a pending flush and a running compaction, stop the syncer and make every
+// acknowledged write durable, including kPeriodic / kNone writes that were
+// never fsynced.
+KVStore::~KVStore() {
+    {
+        std::lock_guard<std::mutex> lock(mu_);
+        shutting_down_ = true;
+    }
+    sync_cv_.notify_all();
+    flush_cv_.notify_all();
+    compaction_cv_.notify_all();
+    if (compaction_thread_.joinable()) compaction_thread_.join();
+    if (flush_thread_.joinable()) flush_thread_.join();
+    if (sync_thread_.joinable()) sync_thread_.join();
+
+    if (wal_)  wal_->sync();
+    if (vlog_) vlog_->sync();
 }
 
 // ── Write path ─────────────────────────────────────────────────
 
-void KVStore::delete_key(const std::string& key) {
-    maybe_flush();
-    if (!wal_->append_delete(key))
-        throw std::runtime_error("[KVStore] WAL append_delete failed");
-    if (!wal_->sync())
-        throw std::runtime_error("[KVStore] WAL sync failed");
+// One queued put/delete waiting for (or leading) a commit group.
+struct KVStore::Writer {
+    const std::string*      key   = nullptr;
+    const std::string*      value = nullptr; // nullptr → tombstone
+    const WriteBatch*       batch = nullptr; // set → key/value unused
+    SyncMode                sync  = SyncMode::kSync;
+    const std::function<void()>* exclusive = nullptr; // run_exclusive() task
+    const VLogPointer*      expected = nullptr; // rewrite_value(): put only if key still maps here
+    bool                    skipped = false;    // set when `expected` was stale
+    bool                    done = false;
+    std::string             error;        // set by the leader on failure
+    std::condition_variable cv;
+};
+
+void KVStore::delete_key(const std::string& key, const WriteOptions& opts) {
+    Writer w;
+    w.key   = &key;
+    w.value = nullptr;
+    w.sync  = opts.sync;
+    write_record(w);
+}
 
-    VLogPointer ptr;
-    ptr.length = 0;
-    ptr.offset = std::numeric_limits<uint64_t>::max();
-    ptr.file_id = current_wal_id_;
-    active_->put(key, ptr);
+void KVStore::put(const std::string& key, const std::string& value,
+                  const WriteOptions& opts) {
+    Writer w;
+    w.key   = &key;
+    w.value = &value;
+    w.sync  = opts.sync;
+    write_record(w);
 }
 
-void KVStore::put(const std::string& key, const std::string& value) {
-    maybe_flush();
+void KVStore::write(const WriteBatch& batch, const WriteOptions& opts) {
+    if (batch.empty()) return;
+    if (batch.rep().size() > WAL::MAX_BATCH_SIZE)
+        throw std::runtime_error("[KVStore] WriteBatch exceeds maximum batch size");
+    Writer w;
+    w.batch = &batch;
+    w.sync  = opts.sync;
+    write_record(w);
+}
 
-    // Step 1: WAL append (full key + value).
-    // Write Amp Metric additions
-    metrics_.user_bytes_written += key.size() + value.size();
-    metrics_.storage_bytes_written += 12 + key.size() + value.size(); // WAL struct overhead
-    metrics_.storage_bytes_written += 4 + value.size();               // VLog overhead
+bool KVStore::rewrite_value(const std::string& key, const std::string& value,
+                            const VLogPointer& expected) {
+    Writer w;
+    w.key      = &key;
+    w.value    = &value;
+    w.expected = &expected;
+    write_record(w);
+    return !w.skipped;
+}
 
-    if (!wal_->append(key, value))
-        throw std::runtime_error("[KVStore] WAL append failed");
+void KVStore::write_record(Writer& w) {
+    std::unique_lock<std::mutex> lock(mu_);
+    writers_.push_back(&w);
+    while (!w.done && &w != writers_.front()) w.cv.wait(lock);
 
-    // Step 2: WAL sync — durability boundary.
-    if (!wal_->sync())
-        throw std::runtime_error("[KVStore] WAL sync failed");
+    if (w.done) {
+        // A leader already committed (or failed) this record for us.
+        if (!w.error.empty()) throw std::runtime_error(w.error);
+        return;
+    }
 
-    // Step 3: VLog append — returns pointer.
-    VLogPointer ptr;
-    if (!vlog_->append(value, ptr))
-        throw std::runtime_error("[KVStore] VLog append failed");
+    // This writer is the leader for the group starting at writers_.front().
+    Writer* last = &w;
+    std::string error;
+    if (w.exclusive) {
+        // Maintenance task: runs alone, under mu_, with no group I/O and no
+        // flush in flight.
+        drain_immutables(lock);
+        try { (*w.exclusive)(); } catch (const std::exception& e) { error = e.what(); }
+        writers_.pop_front();
+        if (!writers_.empty()) writers_.front()->cv.notify_one();
+        if (!error.empty()) throw std::runtime_error(error);
+        return;
+    }
+    if (w.expected) {
+        // Conditional rewrite: compared here and, if still current, committed
+        // in a group of its own, so no other write can land in between.
+        VLogPointer current;
+        try {
+            auto v = current_version();
+            w.skipped = !find_pointer(*v, *w.key, current) || current.file_id != w.expected->file_id ||
+                        current.offset != w.expected->offset || current.length != w.expected->length;
+        } catch (const std::exception& e) {
+            error = e.what();
+        }
+        if (w.skipped || !error.empty()) {
+            writers_.pop_front();
+            if (!writers_.empty()) writers_.front()->cv.notify_one();
+            if (!error.empty()) throw std::runtime_error(error);
+            return;
+        }
+    }
+    try {
+        maybe_flush(lock);
+
+        // Collect the group: every queued writer up to the next exclusive
+        // task or conditional rewrite, which then leads alone, capped by
+        // MAX_GROUP_BYTES.
+        std::vector<Writer*> group;
+        size_t group_bytes = 0, periodic_bytes = 0;
+        bool   need_sync = false;
+        for (Writer* q : writers_) {
+            if (q->exclusive || (!group.empty() && (q->expected || w.expected))) break;
+            size_t bytes = q->batch ? q->batch->rep().size()
+                                    : q->key->size() + (q->value ? q->value->size() : 0);
+            if (!group.empty() && group_bytes + bytes > MAX_GROUP_BYTES) break;
+            group.push_back(q);
+            group_bytes += bytes;
+            if (q->sync == SyncMode::kSync)     need_sync = true;
+            if (q->sync == SyncMode::kPeriodic) periodic_bytes += bytes;
+            last = q;
+        }
+        if (group.size() > 1) metrics_.grouped_commits++;
+
+        // Flatten the group into operations in commit order, each with its
+        // own sequence number. Every view borrows from a writer that is
+        // blocked until this group retires.
+        std::vector<VLogRecordRef> ops;
+        for (Writer* q : group) {
+            if (q->batch) {
+                size_t first = ops.size();
+                q->batch->for_each([&](uint8_t type, std::string_view k, std::string_view v) {
+                    ops.push_back({k, v, ++last_sequence_, type == WriteBatch::kTypeDeletion, 0});
+                });
+                ops[first].batch_size = q->batch->count();
+            } else {
+                std::string_view v = q->value ? std::string_view(*q->value) : std::string_view();
+                ops.push_back({*q->key, v, ++last_sequence_, q->value == nullptr, 0});
+            }
+        }
+        for (const auto& op : ops) {
+            if (op.is_tombstone) continue;
+            // Write Amp Metric additions
+            metrics_.user_bytes_written += op.key.size() + op.value.size();
+        }
+        if (need_sync) metrics_.wal_syncs++;
+
+        // Steps 1–4 run without mu_ so later writers can queue behind us.
+        // Only the front-of-queue leader appends to wal_/vlog_ here, and the
+        // memtable switch (which swaps wal_) only ever runs on that same leader.
+        std::vector<VLogPointer> ptrs;   // aligned with ops
+        uint64_t storage_bytes = 0;
+        lock.unlock();
+        error = options_.vlog_as_wal ? commit_to_vlog(ops, need_sync, ptrs, storage_bytes)
+                                     : commit_to_wal(group, ops, need_sync, ptrs, storage_bytes);
+        lock.lock();
+        metrics_.storage_bytes_written += storage_bytes;
+
+        // A sync group made everything before it durable too.
+        if (need_sync) {
+            periodic_unsynced_bytes_ = 0;
+        } else if (periodic_bytes > 0) {
+            periodic_unsynced_bytes_ += periodic_bytes;
+            if (periodic_unsynced_bytes_ >= options_.sync_bytes) sync_cv_.notify_one();
+        }
 
-    // Step 4: VLog sync — pointer validity boundary.
-    if (!vlog_->sync())
-        throw std::runtime_error("[KVStore] VLog sync failed — pointer NOT inserted");
+        // Step 5: Memtable put in queue order (later writers win, I8).
+        if (error.empty()) {
+            for (size_t i = 0; i < ops.size(); ++i) {
+                if (!ops[i].is_tombstone) {
+                    active_->put(ops[i].key, ptrs[i]);
+                    continue;
+                }
+                VLogPointer ptr;
+                ptr.length = 0;
+                ptr.offset = std::numeric_limits<uint64_t>::max();
+                ptr.file_id = current_wal_id_;
+                active_->put(ops[i].key, ptr);
+            }
+        }
+    } catch (const std::exception& e) {
+        if (!lock.owns_lock()) lock.lock();
+        error = e.what();
+    }
 
-    // Step 5: Memtable put — only reached if all above succeeded.
-    active_->put(key, ptr);
+    // Retire the group and hand leadership to the next queued writer.
+    while (true) {
+        Writer* ready = writers_.front();
+        writers_.pop_front();
+        if (ready != &w) {
+            ready->error = error;
+            ready->done  = true;
+            ready->cv.notify_one();
+        }
+        if (ready == last) break;
+    }
+    if (!writers_.empty()) writers_.front()->cv.notify_one();
+
+    if (!error.empty()) throw std::runtime_error(error);
 }
 
-// ── Read path ──────────────────────────────────────────────────
+// Steps 1–4 for one group in WAL mode: WAL records (batches stay one
+// record each), one WAL write + fsync, then the values as plain VLog records
+// with one write + fsync. Returns an error message or "".
+std::string KVStore::commit_to_wal(const std::vector<Writer*>& group,
+                                   const std::vector<VLogRecordRef>& ops, bool need_sync,
+                                   std::vector<VLogPointer>& ptrs, uint64_t& storage_bytes) {
+    std::vector<std::string_view> values;
+    for (const auto& op : ops) {
+        if (op.is_tombstone) continue;
+        values.push_back(op.value);
+        storage_bytes += 4 + op.value.size();                           // VLog overhead
+    }
 
-bool KVStore::get(const std::string& key, std::string& out_value) const {
-    metrics_.get_calls++;
-    VLogPointer ptr;
+    // Values land in the VLog at vlog_base, in op order. Logging that lets
+    // recovery find them there instead of appending them again.
+    std::vector<WALRecordRef> records;
+    records.reserve(group.size() + 1);
+    uint64_t vlog_base = vlog_->tail_offset();
+    if (!values.empty() && wal_->records_vlog_base()) {
+        records.push_back({std::string_view(reinterpret_cast<const char*>(&vlog_base), sizeof(vlog_base)),
+                           std::string_view(), WALRecordType::kVLogBase});
+        storage_bytes += 16 + sizeof(vlog_base);                        // VLog base record
+    }
+    for (Writer* q : group) {
+        if (q->batch) {
+            records.push_back({std::string_view(), q->batch->rep(), WALRecordType::kBatch});
+            storage_bytes += 16 + q->batch->rep().size();               // WAL batch record
+        } else if (q->value) {
+            records.push_back({*q->key, *q->value, WALRecordType::kValue});
+            storage_bytes += 16 + q->key->size() + q->value->size();    // WAL struct overhead
+        } else {
+            records.push_back({*q->key, std::string_view(), WALRecordType::kTombstone});
+        }
+    }
 
-    // 1. Active memtable.
-    if (active_ && active_->get(key, ptr)) {
-        if (is_tombstone(ptr)) return false;
-        metrics_.vlog_reads++;
-        return vlog_->read_at(ptr, out_value);
+    // Each write is submitted together with its fdatasync when syncing.
+    std::vector<VLogPointer> value_ptrs;
+    if (!wal_->append_group(records, need_sync))
+        return "[KVStore] WAL append/sync failed";
+    if (!values.empty() && !vlog_->append_group(values, value_ptrs, need_sync))
+        return "[KVStore] VLog append/sync failed — pointer NOT inserted";
+
+    ptrs.resize(ops.size());
+    size_t vi = 0;
+    for (size_t i = 0; i < ops.size(); ++i)
+        if (!ops[i].is_tombstone) ptrs[i] = value_ptrs[vi++];
+    return "";
+}
+
+// Steps 1–4 for one group in log mode (Options::vlog_as_wal): keyed records
+// carry key, sequence and checksum, so the single VLog write + fsync is the
+// durability boundary and no WAL copy of the value exists.
+std::string KVStore::commit_to_vlog(const std::vector<VLogRecordRef>& ops, bool need_sync,
+                                    std::vector<VLogPointer>& ptrs, uint64_t& storage_bytes) {
+    for (const auto& op : ops) {
+        storage_bytes += 24 + op.key.size() + (op.is_tombstone ? 0 : op.value.size());
+        if (op.batch_size > 0) storage_bytes += 16;                     // batch envelope
     }
+    if (!vlog_->append_keyed_group(ops, ptrs, need_sync))
+        return "[KVStore] VLog append/sync failed — pointer NOT inserted";
+    return "";
+}
+
+// Runs fn once every earlier commit group has retired and before any later
+// one starts, holding mu_. Used by maintenance that swaps wal_/vlog_ or scans
+// the memtables (VLog GC).
+void KVStore::run_exclusive(const std::function<void()>& fn) {
+    Writer w;
+    w.exclusive = &fn;
+    write_record(w);
+}
+
+// ── Background sync (SyncMode::kPeriodic) ──────────────────────
+
+void KVStore::background_sync_loop() {
+    std::unique_lock<std::mutex> lock(mu_);
+    const auto interval = std::chrono::milliseconds(options_.sync_interval_ms);
+    while (!shutting_down_) {
+        sync_cv_.wait_for(lock, interval, [this] {
+            return shutting_down_ || periodic_unsynced_bytes_ >= options_.sync_bytes;
+        });
+        if (shutting_down_ || periodic_unsynced_bytes_ == 0) continue;
+        periodic_unsynced_bytes_ = 0;
+
+        // fsync without mu_ so writers keep flowing; sync_mu_ keeps wal_ and
+        // vlog_ alive until we are done.
+        lock.unlock();
+        bool ok;
+        {
+            std::lock_guard<std::mutex> sync_lock(sync_mu_);
+            ok = (!wal_ || wal_->sync()) && vlog_->sync();
+        }
+        lock.lock();
 
-    // 2. Immutable memtable (exists during flush).
-    if (immutable_ && immutable_->get(key, ptr)) {
-        if (is_tombstone(ptr)) return false;
-        metrics_.vlog_reads++;
-        return vlog_->read_at(ptr, out_value);
+        if (ok) {
+            metrics_.background_syncs++;
+        } else {
+            std::cerr << "[KVStore] WARNING: background sync failed, retrying next interval\n";
+            periodic_unsynced_bytes_ = std::max<uint64_t>(periodic_unsynced_bytes_, 1);
+        }
     }
+}
+
+// ── Read path ──────────────────────────────────────────────────
+
+// Publish the writer-side state as the new Version. Caller holds mu_.
+void KVStore::install_version() {
+    auto v = std::make_shared<Version>();
+    v->active    = active_;
+    for (auto it = immutables_.rbegin(); it != immutables_.rend(); ++it)
+        v->immutables.push_back(it->mem);
+    v->levels    = levels_;
+    v->vlog      = vlog_;
+    v->retired_vlog = retired_vlog_;
+    std::lock_guard<std::mutex> lock(version_mu_);
+    current_ = std::move(v);
+}
+
+std::shared_ptr<const KVStore::Version> KVStore::current_version() const {
+    std::lock_guard<std::mutex> lock(version_mu_);
+    return current_;
+}
+
+// Newest-first search for key's pointer (tombstones included) in a pinned
+// Version. Throws at a table that cannot tell whether it holds the key, since
+// an older level may still hold a stale or deleted value for it.
+bool KVStore::find_pointer(const Version& v, const std::string& key, VLogPointer& ptr) const {
+    // 1. Active memtable.
+    if (v.active && v.active->get(key, ptr)) return true;
+
+    // 2. Immutable memtables waiting for flush, newest first.
+    for (const auto& mem : v.immutables)
+        if (mem->get(key, ptr)) return true;
 
     // 3. L0 SSTables — newest first.
-    for (const auto& sst : l0_sstables_) {
+    for (const auto& sst : v.levels[0]) {
         metrics_.sst_considered++;
-        if (!disable_bloom_ && !sst.bloom().may_contain(key)) {
+        if (!disable_bloom_ && !sst->bloom().may_contain(key)) {
             metrics_.bloom_skips++;
             continue; // SKIP completely
         }
         
         metrics_.sst_searches++; // Only count actual binary search checks
-        if (sst.get(key, ptr)) {
-            if (is_tombstone(ptr)) return false;
-            metrics_.vlog_reads++;
-            return vlog_->read_at(ptr, out_value);
-        }
+        if (table_get(*sst, key, ptr)) return true;
     }
 
-    // 4. L1 SSTables — binary search file boundaries.
-    for (const auto& sst : l1_sstables_) {
-        // Find the overlapping file:
-        if (sst.overlaps(key, key)) {
-            metrics_.sst_considered++;
-            if (!disable_bloom_ && !sst.bloom().may_contain(key)) {
-                metrics_.bloom_skips++;
-                continue; // SKIP completely
-            }
-            
-            metrics_.sst_searches++;
-            if (sst.get(key, ptr)) {
-                if (is_tombstone(ptr)) return false;
-                metrics_.vlog_reads++;
-                return vlog_->read_at(ptr, out_value);
-            }
+    // 4. Deeper levels, upper first — binary search file boundaries. Tables
+    //    of a level are disjoint, so at most one can hold the key.
+    for (size_t n = 1; n < v.levels.size(); ++n) {
+        const auto& level = v.levels[n];
+        auto it = std::lower_bound(level.begin(), level.end(), key,
+            [](const SSTableHandle& t, const std::string& k) { return t->max_key() < k; });
+        if (it == level.end() || !(*it)->overlaps(key, key)) continue;
+        const auto& sst = *it;
+        metrics_.sst_considered++;
+        if (!disable_bloom_ && !sst->bloom().may_contain(key)) {
+            metrics_.bloom_skips++;
+            continue; // SKIP completely
         }
+
+        metrics_.sst_searches++;
+        if (table_get(*sst, key, ptr)) return true;
     }
 
     return false;
 }
 
+const VLog* KVStore::vlog_for(const Version& v, const VLogPointer& ptr) {
+    if (const VLog* vlog = v.vlog_for(ptr)) return vlog;
+    throw std::runtime_error("[KVStore] Pointer into unknown VLog file " + std::to_string(ptr.file_id));
+}
+
+bool KVStore::table_get(const SSTableReader& sst, const std::string& key, VLogPointer& ptr) {
+    switch (sst.get(key, ptr)) {
+    case SSTableLookup::kFound:   return true;
+    case SSTableLookup::kAbsent:  return false;
+    case SSTableLookup::kCorrupt: break;
+    }
+    throw std::runtime_error("[KVStore] Corrupt data block in " + sst.path());
+}
+
+bool KVStore::get(const std::string& key, std::string& out_value) const {
+    auto v = current_version();
+    metrics_.get_calls++;
+    VLogPointer ptr;
+    if (!find_pointer(*v, key, ptr) || is_tombstone(ptr)) return false;
+    const VLog* vlog = vlog_for(*v, ptr);
+    metrics_.vlog_reads++;
+    return vlog->read_at(ptr, out_value);
+}
+
+void KVStore::multi_get(const std::vector<std::string>& keys,
+                        std::vector<std::string>& values, std::vector<bool>& found) const {
+    auto v = current_version();
+    values.assign(keys.size(), std::string());
+    found.assign(keys.size(), false);
+
+    // Resolve every pointer first, then read all live values in one batch.
+    std::vector<VLogPointer> ptrs;
+    std::vector<size_t>      slots;
+    for (size_t i = 0; i < keys.size(); ++i) {
+        metrics_.get_calls++;
+        VLogPointer ptr;
+        if (!find_pointer(*v, keys[i], ptr) || is_tombstone(ptr)) continue;
+        vlog_for(*v, ptr);   // throws on a dangling pointer
+        ptrs.push_back(ptr);
+        slots.push_back(i);
+    }
+    if (ptrs.empty()) return;
+
+    // One batch per log; only VLog GC leaves values in a second one.
+    for (const VLog* vlog : {v->vlog.get(), v->retired_vlog.get()}) {
+        if (!vlog) continue;
+        std::vector<VLogPointer> batch;
+        std::vector<size_t>      batch_slots;
+        for (size_t j = 0; j < ptrs.size(); ++j) {
+            if (v->vlog_for(ptrs[j]) != vlog) continue;
+            batch.push_back(ptrs[j]);
+            batch_slots.push_back(slots[j]);
+        }
+        if (batch.empty()) continue;
+        std::vector<std::string> read;
+        std::vector<bool>        ok;
+        metrics_.vlog_reads += batch.size();
+        vlog->read_batch(batch, read, ok);
+        for (size_t j = 0; j < batch_slots.size(); ++j) {
+            values[batch_slots[j]] = std::move(read[j]);
+            found[batch_slots[j]]  = ok[j];
+        }
+    }
+}
+
 // ── Flush ──────────────────────────────────────────────────────
 
-void KVStore::maybe_flush() {
-    // BACKPRESSURE SAFETY CHECK (I21):
-    // Put() calls maybe_flush(), which directly and synchronously executes compaction 
-    // when L0 threshold is exceeded. Because Phase 3 is explicitly single-threaded 
-    // and holds no cross-thread locks, there is NO deadlock risk.
-    if (l0_sstables_.size() > L0_HARD_LIMIT) {
-        compact_l0_to_l1();
+void KVStore::maybe_flush(std::unique_lock<std::mutex>& lock) {
+    // BACKPRESSURE (I21): compaction runs on compaction_thread_. While L0 is
+    // backed up the leader holds its group back, a little longer for every
+    // table past l0_slowdown_trigger(), and not at all past l0_stop_trigger()
+    // until compaction has caught up. Waiting drops mu_, so reads, the
+    // flusher and the compactor keep going; queued writers stay queued.
+    size_t l0 = levels_[0].size();
+    size_t slowdown = l0_slowdown_trigger(), stop = l0_stop_trigger();
+    if (l0 >= slowdown && compaction_error_.empty()) {
+        auto start = std::chrono::steady_clock::now();
+        compaction_cv_.notify_one();
+        if (l0 < stop) {
+            metrics_.write_slowdowns++;
+            lock.unlock();
+            std::this_thread::sleep_for(std::chrono::milliseconds(l0 - slowdown + 1));
+            lock.lock();
+        } else {
+            metrics_.write_stops++;
+            compaction_done_cv_.wait(lock, [this, stop] {
+                return levels_[0].size() < stop || !compaction_error_.empty();
+            });
+        }
+        metrics_.stall_micros += std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start).count();
     }
+    if (!compaction_error_.empty()) throw std::runtime_error(compaction_error_);
+    if (!flush_error_.empty()) throw std::runtime_error(flush_error_);
     if (!active_ || active_->byte_size() < FLUSH_THRESHOLD) return;
-    flush();
+
+    // At most max_immutable_memtables may wait for the flusher.
+    size_t max_queued = std::max<uint32_t>(options_.max_immutable_memtables, 1);
+    if (immutables_.size() >= max_queued) {
+        auto start = std::chrono::steady_clock::now();
+        metrics_.flush_waits++;
+        flush_done_cv_.wait(lock, [&] {
+            return immutables_.size() < max_queued || !flush_error_.empty();
+        });
+        metrics_.stall_micros += std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start).count();
+        if (!flush_error_.empty()) throw std::runtime_error(flush_error_);
+    }
+    freeze_memtable();
+    flush_cv_.notify_one();
 }
 
+// Synchronous flush for recovery and exclusive maintenance. Caller holds mu_
+// and no other flush is in flight; anything still queued is flushed too.
 void KVStore::flush() {
     if (!active_ || active_->size() == 0) return;
+    freeze_memtable();
+    flush_immutable(nullptr);
+}
 
-    // 1. Freeze active → immutable.
-    immutable_ = std::move(active_);
-    active_ = std::make_unique<Memtable>();
+std::shared_ptr<Memtable> KVStore::new_memtable() const {
+    return std::make_shared<Memtable>(options_.memtable_rep, options_.memtable_hash_buckets);
+}
+
+// Active → back of immutables_. Caller holds mu_ on the leader or
+// exclusively, so no group is mid-append: every VLog record below the tail
+// and every sequence up to last_sequence_ belongs to this or an older
+// frozen memtable.
+void KVStore::freeze_memtable() {
+    FrozenMemtable frozen;
+    frozen.mem           = std::move(active_);
+    frozen.vlog_tail     = vlog_->tail_offset();
+    frozen.last_sequence = last_sequence_;
+    frozen.wal_id        = current_wal_id_;
+    immutables_.push_back(std::move(frozen));
+    active_ = new_memtable();
+    install_version();
+    switch_wal();
+}
 
-    // 2. Write SSTable from immutable memtable.
+// Writes every memtable queued in immutables_ to one new L0 SSTable and
+// commits it. Caller holds mu_; with a `lock`, mu_ is released while the
+// file is written and reloaded. Memtables frozen meanwhile wait for the
+// next flush. Nothing else removes from immutables_ or swaps vlog_.
+void KVStore::flush_immutable(std::unique_lock<std::mutex>* lock) {
     uint32_t seq = next_sst_sequence();
     std::string path = sst_path(seq);
+    const size_t count = immutables_.size();
+    const FrozenMemtable newest = immutables_.back();
+
+    // Merged newest first, so the newest version of each key wins. Frozen
+    // memtables take no more writes.
+    std::vector<std::unique_ptr<KeyIterator>> sources;
+    for (size_t i = count; i-- > 0;)
+        sources.push_back(std::make_unique<MemtableKeyIterator>(immutables_[i].mem));
+    MergingIterator merged(std::move(sources));
+    uint64_t sst_bytes = 0;   // write amplification of the flush
+
+    if (lock) lock->unlock();
+    std::string error;
+    SSTableReader reader;
+    try {
+        // 1. Values referenced by the new SSTable must be durable before it
+        //    becomes visible (I12) — kPeriodic / kNone writes may not be yet.
+        bool synced;
+        {
+            std::lock_guard<std::mutex> sync_lock(sync_mu_);
+            synced = vlog_->sync();
+        }
+        // 2. Stream the merged memtables into the SSTable, then load it back.
+        SSTableBuilder builder(io_.get());
+        if (synced && builder.open(path)) {
+            for (merged.seek_to_first(); merged.valid(); merged.next())
+                builder.add(merged.key(), merged.pointer());
+        }
+        if (!synced)
+            error = "[KVStore] VLog sync failed during flush";
+        else if (!builder.finish())
+            error = "[KVStore] SSTable flush failed";
+        else if (!reader.load(path, sst_read_context()))
+            error = "[KVStore] Failed to load flushed SSTable";
+        sst_bytes = builder.file_size();
+    } catch (const std::exception& e) {
+        error = e.what();
+    }
+    if (lock) lock->lock();
+    if (!error.empty()) throw std::runtime_error(error);
+    add_storage_bytes(sst_bytes);
+
+    // 3. Update manifest atomically. New SST forms L0 and is visible AFTER
+    //    commit; the replay offset and sequence are those of the newest
+    //    freeze it covers.
+    Levels next_levels = levels_;
+    next_levels[0].insert(next_levels[0].begin(),
+                          std::make_shared<const SSTableReader>(std::move(reader)));
+    Manifest next = manifest_;
+    next.version++;
+    describe_levels(next_levels, next);
+    next.vlog_replay_offset = newest.vlog_tail;
+    next.last_sequence = newest.last_sequence;
+    if (!next.commit(manifest_path()))
+        throw std::runtime_error("[KVStore] Manifest commit failed during flush");
+    manifest_ = std::move(next);
 
-    // Track write amplification for SST flush
-    size_t sst_est = 24; // footer approx
-    for (const auto& [k,v] : immutable_->entries()) sst_est += 20 + k.size();
-    add_storage_bytes(sst_est);
+    // 4. Publish the SSTable and discard its memtables together, so a
+    //    reader sees exactly one of them.
+    levels_ = std::move(next_levels);
+    immutables_.erase(immutables_.begin(), immutables_.begin() + count);
+    install_version();
+    if (count > 1) metrics_.flush_merges++;
 
-    if (!SSTableWriter::write(path, immutable_->entries()))
-        throw std::runtime_error("[KVStore] SSTable flush failed");
+    // 5. The flushed memtables' WALs are now covered by the SSTable.
+    retire_wals(newest.wal_id);
+    flush_done_cv_.notify_all();
+    size_t due_level;
+    if (compaction_score(due_level) >= 1) compaction_cv_.notify_one();
 
-    // 3. Update manifest atomically. New SST forms L0 and is visible AFTER commit.
-    manifest_.version++;
-    manifest_.l0_seqs.push_back(seq);
-    if (!manifest_.commit(manifest_path()))
-        throw std::runtime_error("[KVStore] Manifest commit failed during flush");
+    std::cout << "[KVStore] Flushed SSTable sst_"
+              << std::string(6 - std::to_string(seq).size(), '0') + std::to_string(seq);
+    if (count > 1) std::cout << " from " << count << " memtables";
+    std::cout << "\n";
+}
 
-    // 4. Load the new SSTable.
-    SSTableReader reader;
-    if (!reader.load(path))
-        throw std::runtime_error("[KVStore] Failed to load flushed SSTable");
+void KVStore::background_flush_loop() {
+    std::unique_lock<std::mutex> lock(mu_);
+    const size_t min_merge = std::clamp<uint32_t>(options_.min_memtables_to_merge, 1,
+                                                  std::max<uint32_t>(options_.max_immutable_memtables, 1));
+    while (true) {
+        flush_cv_.wait(lock, [&] {
+            bool ready = immutables_.size() >= min_merge ||
+                         (!immutables_.empty() && drain_waiters_ > 0);
+            return shutting_down_ || (ready && flush_error_.empty());
+        });
+        // Frozen memtables are flushed even when shutting down.
+        if (immutables_.empty() || !flush_error_.empty()) return;
+        try {
+            size_t count = immutables_.size();
+            flush_immutable(&lock);
+            metrics_.background_flushes += count;
+        } catch (const std::exception& e) {
+            std::cerr << "[KVStore] ERROR: background flush failed: " << e.what() << "\n";
+            flush_error_ = e.what();
+            flush_done_cv_.notify_all();
+        }
+    }
+}
 
-    l0_sstables_.insert(l0_sstables_.begin(), std::move(reader));
+void KVStore::background_compaction_loop() {
+    std::unique_lock<std::mutex> lock(mu_);
+    while (true) {
+        compaction_cv_.wait(lock, [this] {
+            size_t level;
+            return shutting_down_ || (compaction_score(level) >= 1 && compaction_error_.empty());
+        });
+        if (shutting_down_) return;
+
+        lock.unlock();
+        std::string error;
+        bool compacted = false;
+        try {
+            compacted = run_compaction(this);
+        } catch (const std::exception& e) {
+            error = e.what();
+        }
+        lock.lock();
+        if (compacted) metrics_.background_compactions++;
+        if (!error.empty()) {
+            std::cerr << "[KVStore] ERROR: background compaction failed: " << error << "\n";
+            compaction_error_ = error;
+            compaction_done_cv_.notify_all();
+        }
+    }
+}
 
-    // 5. WAL rotation (crash-safe: create-before-delete, I19).
-    rotate_wal();
+void KVStore::wait_for_flush() {
+    std::unique_lock<std::mutex> lock(mu_);
+    drain_immutables(lock);
+    if (!flush_error_.empty()) throw std::runtime_error(flush_error_);
+}
 
-    // 6. Discard immutable memtable.
-    immutable_.reset();
+void KVStore::wait_for_compaction() {
+    std::unique_lock<std::mutex> lock(mu_);
+    drain_immutables(lock);
+    if (!flush_error_.empty()) throw std::runtime_error(flush_error_);
+    compaction_cv_.notify_one();
+    compaction_done_cv_.wait(lock, [this] {
+        size_t level;
+        return (!compaction_running_ && compaction_score(level) < 1) || !compaction_error_.empty();
+    });
+    if (!compaction_error_.empty()) throw std::runtime_error(compaction_error_);
+}
 
-    std::cout << "[KVStore] Flushed SSTable sst_"
-              << std::string(6 - std::to_string(seq).size(), '0') + std::to_string(seq)
-              << "\n";
+// Wait until every queued memtable is flushed, or a flush failed. Caller
+// holds mu_ through `lock`. Waiters make the flusher start even when fewer
+// than min_memtables_to_merge are queued.
+void KVStore::drain_immutables(std::unique_lock<std::mutex>& lock) {
+    drain_waiters_++;
+    flush_cv_.notify_one();
+    flush_done_cv_.wait(lock, [this] { return immutables_.empty() || !flush_error_.empty(); });
+    drain_waiters_--;
 }
 
-// ── WAL rotation (crash-safe, I19) ─────────────────────────────
+// ── WAL switch and retirement (crash-safe, I19) ────────────────
 //
 // Sequence:
-//   1. Create NEW WAL at wal_{id+1}.log → fsync
-//   2. Switch KVStore to new WAL (close old fd)
-//   3. Delete old WAL at wal_{id}.log
+//   1. Freeze: fsync the current WAL, create NEW WAL at wal_{id+1}.log →
+//      fsync → switch. The old log stays on disk.
+//   2. Flush commits the SSTable of the oldest queued memtables.
+//   3. Retire: delete every WAL up to the newest of those memtables' logs,
+//      never the current one.
 //
-// Old WAL is NEVER deleted before new WAL is durable.
-// If crash between steps 1 and 3: both WAL files exist on disk.
+// Old WAL is NEVER deleted before its records are in a committed SSTable.
+// If crash before step 3: several WAL files exist on disk.
 // Recovery replays all WAL files in order — duplicates resolved by I8.
+// The old log is fsynced at the switch so a later sync write on the new log
+// never becomes durable ahead of unsynced records in the old one.
+//
+// With Options::recycle_wal the newest retired log is not deleted but kept
+// as spare_wal.log. The next switch reuses it: WAL::recycle() restamps it
+// with a higher log number (making its records stale) and renames it to
+// wal_{id+1}.log. Its blocks stay allocated, so the next appends are pure
+// overwrites and fdatasync has no file-size metadata to flush.
+//
+// In log mode (Options::vlog_as_wal) there is no active WAL: the manifest's
+// VLog replay offset advanced in the same commit as the SSTable, so any WAL
+// left over from an earlier open is fully covered and simply removed.
 
-void KVStore::rotate_wal() {
-    uint32_t old_id = current_wal_id_;
-    uint32_t new_id = old_id + 1;
-    std::string old_wp = wal_path(old_id);
-    std::string new_wp = wal_path(new_id);
+void KVStore::switch_wal() {
+    if (options_.vlog_as_wal) return;
 
-    // 1. Create new WAL, fsync (durable BEFORE we touch old).
-    auto new_wal = std::make_unique<WAL>(new_wp);
-    new_wal->sync();
+    // Log numbers only grow, even if a crash left a restamped log under
+    // its old name.
+    uint32_t new_id = std::max(current_wal_id_, wal_->log_number()) + 1;
+    std::string new_wp = wal_path(new_id);
+    if (!wal_->sync())
+        throw std::runtime_error("[KVStore] WAL sync failed during rotation");
+
+    // 1. Reuse the spare, or create a new WAL, fsync (durable BEFORE switch).
+    std::unique_ptr<WAL> new_wal;
+    std::string spare = spare_wal_path();
+    if (options_.recycle_wal && std::filesystem::exists(spare)) {
+        auto recycled = std::make_unique<WAL>(spare, 0, 0, io_.get());
+        if (recycled->recycle(new_wp, new_id)) {
+            new_wal = std::move(recycled);
+        } else {
+            recycled.reset();
+            std::filesystem::remove(spare);
+        }
+    }
+    if (!new_wal) {
+        new_wal = std::make_unique<WAL>(new_wp, new_id, wal_preallocate_bytes(), io_.get());
+        new_wal->sync();
+    }
 
-    // 2. Switch: old WAL destructor closes its fd.
-    wal_ = std::move(new_wal);
+    // 2. Switch: old WAL destructor closes its fd. The background syncer
+    //    may be mid-fsync on the old WAL, so swap under sync_mu_.
+    {
+        std::lock_guard<std::mutex> sync_lock(sync_mu_);
+        wal_ = std::move(new_wal);
+    }
     current_wal_id_ = new_id;
+}
+
+void KVStore::retire_wals(uint32_t upto_id) {
+    std::vector<std::string> stale;
+    uint32_t max_id = 0;
+    scan_wal_files(stale, max_id);
+    if (!options_.vlog_as_wal) {
+        // Logs of memtables still queued for flush stay.
+        stale.erase(std::remove_if(stale.begin(), stale.end(),
+                                   [&](const std::string& p) {
+                                       uint32_t id = static_cast<uint32_t>(std::strtoul(
+                                           std::filesystem::path(p).filename().string().c_str() + 4,
+                                           nullptr, 10));
+                                       return id > upto_id || id == current_wal_id_;
+                                   }),
+                    stale.end());
+    }
 
-    // 3. NOW safe to delete old WAL (new WAL is durable).
-    std::filesystem::remove(old_wp);
+    // Newest first, so the spare is the most recently written log.
+    for (auto it = stale.rbegin(); it != stale.rend(); ++it) {
+        if (options_.recycle_wal && !options_.vlog_as_wal &&
+            !std::filesystem::exists(spare_wal_path())) {
+            std::error_code ec;
+            std::filesystem::rename(*it, spare_wal_path(), ec);
+            if (!ec) continue;
+        }
+        std::filesystem::remove(*it);
+    }
 }
 
 // ── Recovery ───────────────────────────────────────────────────
@@ -263,62 +863,183 @@ void KVStore::recover() {
     // Load existing SSTables (validate each).
     load_sstables();
 
+    // New SSTables are numbered above every file on disk, listed or not.
+    next_sst_seq_ = 1;
+    for (const auto& entry : std::filesystem::directory_iterator(data_dir_)) {
+        auto name = entry.path().filename().string();
+        if (name.size() > 4 && name.substr(0, 4) == "sst_" &&
+            name.substr(name.size() - 4) == ".sst") {
+            uint32_t seq = static_cast<uint32_t>(std::strtoul(name.c_str()+4, nullptr, 10));
+            if (seq >= next_sst_seq_) next_sst_seq_ = seq + 1;
+        }
+    }
+    if (!options_.recycle_wal) std::filesystem::remove(spare_wal_path());
+
     // Scan for WAL files.
     std::vector<std::string> wal_files;
     uint32_t max_wal_id = 0;
     scan_wal_files(wal_files, max_wal_id);
 
     // VLog handling:
-    //   If SSTables exist → keep vlog (SST pointers reference it).
-    //   If no SSTables    → safe to recreate vlog from WAL.
+    //   Keyed records past the manifest's replay offset are unflushed log-mode
+    //   writes (Options::vlog_as_wal). Scan them first; the scan also finds
+    //   the end of valid data, and anything after it is a torn tail.
+    //   If SSTables exist or keyed records remain → keep vlog.
+    //   Otherwise → safe to recreate vlog from WAL.
     auto vp = vlog_path();
-    if (l0_sstables_.empty() && l1_sstables_.empty())
-        std::filesystem::remove(vp);
+    vlog_ = std::make_unique<VLog>(vp, io_.get(), manifest_.vlog_file_id);
+
+    struct KeyedEntry { std::string key; VLogPointer ptr; uint64_t seq; };
+    std::vector<KeyedEntry> keyed;
+    uint64_t valid_end = vlog_->scan_keyed(manifest_.vlog_replay_offset,
+        [&](const VLogScanEntry& e) {
+            keyed.push_back({std::string(e.key), e.pointer, e.seq});
+        });
+    if (valid_end < vlog_->tail_offset()) {
+        std::cerr << "[KVStore] Truncating torn VLog tail at byte " << valid_end << "\n";
+        vlog_->truncate(valid_end);
+    }
 
-    vlog_ = std::make_unique<VLog>(vp);
+    // WAL records may point at values already in the VLog, so it is only
+    // recreated when nothing at all can reference it.
+    bool no_tables = std::all_of(levels_.begin(), levels_.end(),
+                                 [](const auto& level) { return level.empty(); });
+    if (no_tables && keyed.empty() && wal_files.empty()) {
+        vlog_.reset();
+        std::filesystem::remove(vp);
+        vlog_ = std::make_unique<VLog>(vp, io_.get(), manifest_.vlog_file_id);
+        if (manifest_.vlog_replay_offset != 0) {
+            // The fresh VLog starts at 0; a stale offset would hide its records.
+            manifest_.vlog_replay_offset = 0;
+            if (!manifest_.commit(manifest_path()))
+                throw std::runtime_error("[KVStore] Manifest commit failed during recovery");
+        }
+    }
 
-    // Replay ALL WAL files in order (oldest → newest).
-    active_ = std::make_unique<Memtable>();
+    // Replay ALL WAL files in order (oldest → newest), then the keyed VLog
+    // tail. At most one of them holds unflushed data: a mode switch flushes
+    // the other source below before accepting writes.
+    active_ = new_memtable();
+    last_sequence_ = manifest_.last_sequence;
     size_t total_entries = 0;
+    size_t wal_entries = 0;
     bool   any_tainted = false;
 
-    for (const auto& wf : wal_files) {
-        WAL temp_wal(wf);
-        auto result = temp_wal.replay();
-        any_tainted = any_tainted || result.tainted;
-
-        for (const auto& e : result.entries) {
-            if (e.is_tombstone) {
-                VLogPointer ptr;
-                ptr.length = 0;
-                ptr.offset = std::numeric_limits<uint64_t>::max();
-                ptr.file_id = 0;
-                active_->put(e.key, ptr);
-                continue;
-            }
-
+    std::optional<uint64_t> newest_valid_bytes;
+    bool newest_tainted = false;
+
+    // Entries stream from the mapped WAL straight into the memtable; the
+    // pool verifies checksums of the chunks ahead of the one being applied.
+    std::unique_ptr<ThreadPool> replay_pool;
+    if (!wal_files.empty()) replay_pool = std::make_unique<ThreadPool>(options_.recovery_threads);
+
+    // A value whose plain VLog record survived the crash sits, byte for
+    // byte, at the offset its group's kVLogBase record implies. Anything
+    // else (VLog write lost or torn, log from before base records, VLog
+    // rewritten by GC) is appended again. Only the pre-recovery contents are
+    // mapped, so values appended below are never matched.
+    MappedFile vlog_map;
+    if (!wal_files.empty()) vlog_map.open(vp);
+    size_t reused_values = 0;
+    auto in_vlog = [&](const WALEntryView& e) {
+        if (e.vlog_offset >= vlog_map.size() ||
+            vlog_map.size() - e.vlog_offset < sizeof(uint32_t) + e.value.size()) return false;
+        const uint8_t* rec = vlog_map.data() + e.vlog_offset;
+        uint32_t value_size;
+        std::memcpy(&value_size, rec, sizeof(uint32_t));
+        return value_size == e.value.size() &&
+               std::memcmp(rec + sizeof(uint32_t), e.value.data(), e.value.size()) == 0;
+    };
+
+    auto apply = [&](const WALEntryView& e) {
+        ++last_sequence_;
+        if (e.is_tombstone) {
             VLogPointer ptr;
-            if (!vlog_->append(e.value, ptr)) {
-                std::cerr << "[KVStore] ERROR: vlog append failed during recovery\n";
-                continue;
-            }
+            ptr.length = 0;
+            ptr.offset = std::numeric_limits<uint64_t>::max();
+            ptr.file_id = 0;
             active_->put(e.key, ptr);
+            return;
         }
-        total_entries += result.entries.size();
+
+        VLogPointer ptr;
+        if (in_vlog(e)) {
+            ptr.file_id = vlog_->file_id();
+            ptr.offset  = e.vlog_offset;
+            ptr.length  = static_cast<uint32_t>(e.value.size());
+            ++reused_values;
+        } else if (!vlog_->append(e.value, ptr)) {
+            std::cerr << "[KVStore] ERROR: vlog append failed during recovery\n";
+            return;
+        }
+        active_->put(e.key, ptr);
+    };
+
+    for (const auto& wf : wal_files) {
+        WAL temp_wal(wf);
+        auto result = temp_wal.replay(apply, replay_pool.get());
+        any_tainted = any_tainted || result.tainted;
+        newest_valid_bytes = result.valid_bytes;
+        newest_tainted = result.tainted;
+        wal_entries += result.entries;
     }
+    replay_pool.reset();
+    vlog_map.close();
     vlog_->sync();
 
+    for (const auto& e : keyed) {
+        active_->put(e.key, e.ptr);
+        last_sequence_ = std::max(last_sequence_, e.seq);
+    }
+    total_entries = wal_entries + keyed.size();
+
     // Set current WAL id and open the active WAL.
     current_wal_id_ = (max_wal_id > 0) ? max_wal_id : 1;
 
-    // If WAL files existed, the newest is already the active one.
-    // If no WAL files existed, create the first one.
-    wal_ = std::make_unique<WAL>(wal_path(current_wal_id_));
+    if (options_.vlog_as_wal) {
+        // Log mode: WAL-sourced entries only live in the memtable and the
+        // plain VLog records just appended, so persist them before the WAL
+        // files go away (flush → retire_wals removes them).
+        if (wal_entries > 0) {
+            flush();
+        } else {
+            retire_wals(current_wal_id_);
+        }
+    } else {
+        // If WAL files existed, the newest is already the active one.
+        // If no WAL files existed, create the first one.
+        //
+        // A torn tail (crash during an unsynced or in-flight write) must be cut
+        // off before appending, otherwise new records would sit behind the
+        // corrupt one and never be replayed (I4). A preallocated or recycled
+        // log is cut back too and re-extended with zeros by the WAL, so no
+        // stale bytes of this log number can follow the next append.
+        if (newest_valid_bytes && std::filesystem::exists(wal_path(current_wal_id_)) &&
+            std::filesystem::file_size(wal_path(current_wal_id_)) > *newest_valid_bytes) {
+            if (newest_tainted)
+                std::cerr << "[KVStore] Truncating torn WAL tail at byte " << *newest_valid_bytes << "\n";
+            std::filesystem::resize_file(wal_path(current_wal_id_), *newest_valid_bytes);
+        }
+        wal_ = std::make_unique<WAL>(wal_path(current_wal_id_), current_wal_id_,
+                                     wal_preallocate_bytes(), io_.get());
+
+        // Unflushed log-mode writes are not in any WAL; flush them so the
+        // WAL once again covers everything above the SSTables.
+        if (!keyed.empty()) flush();
+    }
+
+    install_version();
 
     std::cout << "[KVStore] Recovered " << total_entries << " entries from "
               << wal_files.size() << " WAL(s)";
-    if (!l0_sstables_.empty() || !l1_sstables_.empty())
-        std::cout << ", loaded " << (l0_sstables_.size() + l1_sstables_.size()) << " SSTables";
+    if (!keyed.empty())
+        std::cout << " and the VLog tail";
+    if (reused_values > 0)
+        std::cout << " (" << reused_values << " values already in the VLog)";
+    size_t tables = 0;
+    for (const auto& level : levels_) tables += level.size();
+    if (tables > 0)
+        std::cout << ", loaded " << tables << " SSTables";
     if (any_tainted)
         std::cout << " (WAL TAINTED)";
     std::cout << "\n";
@@ -327,46 +1048,96 @@ void KVStore::recover() {
 // ── SSTable loading ────────────────────────────────────────────
 
 void KVStore::load_sstables() {
-    l0_sstables_.clear();
-    l1_sstables_.clear();
+    levels_.assign(std::max<uint32_t>(options_.num_levels, 2), {});
+    compact_pointer_.assign(levels_.size(), std::string());
     if (!std::filesystem::exists(data_dir_)) return;
 
     if (!manifest_.load(manifest_path())) {
         manifest_.version = 0;
         return; // No manifest yet
     }
+    // A store reopened with fewer levels keeps its deeper tables.
+    if (manifest_.levels.size() > levels_.size()) {
+        levels_.resize(manifest_.levels.size());
+        compact_pointer_.resize(levels_.size());
+    }
 
-    // Load L0 files. Reverse order since l0_seqs are appended in flush (oldest first).
-    // The vector l0_sstables_ must be newest-first for correct reading.
-    for (auto it = manifest_.l0_seqs.rbegin(); it != manifest_.l0_seqs.rend(); ++it) {
-        SSTableReader reader;
-        if (reader.load(sst_path(*it))) {
-            l0_sstables_.push_back(std::move(reader));
-        } else {
-            std::cerr << "[KVStore] WARNING: Manifest invalid L0 SSTable " << *it << "\n";
+    for (size_t n = 0; n < manifest_.levels.size(); ++n) {
+        for (uint32_t seq : manifest_.levels[n]) {
+            SSTableReader reader;
+            if (reader.load(sst_path(seq), sst_read_context())) {
+                levels_[n].push_back(std::make_shared<const SSTableReader>(std::move(reader)));
+            } else {
+                std::cerr << "[KVStore] WARNING: Manifest invalid L" << n << " SSTable " << seq << "\n";
+            }
         }
     }
+    // L0 is listed oldest first (flush appends) but read newest first.
+    // Manifests written before deeper levels were kept sorted list L1 in
+    // output order.
+    std::reverse(levels_[0].begin(), levels_[0].end());
+    for (size_t n = 1; n < levels_.size(); ++n)
+        std::sort(levels_[n].begin(), levels_[n].end(),
+                  [](const SSTableHandle& a, const SSTableHandle& b) { return a->min_key() < b->min_key(); });
+}
 
-    // Load L1 files.
-    for (uint32_t seq : manifest_.l1_seqs) {
-        SSTableReader reader;
-        if (reader.load(sst_path(seq))) {
-            l1_sstables_.push_back(std::move(reader));
-        } else {
-            std::cerr << "[KVStore] WARNING: Manifest invalid L1 SSTable " << seq << "\n";
+void KVStore::describe_levels(const Levels& levels, Manifest& m) {
+    m.levels.assign(levels.size(), {});
+    m.level_bytes.assign(levels.size(), 0);
+    for (size_t n = 0; n < levels.size(); ++n) {
+        for (const auto& t : levels[n]) {
+            m.levels[n].push_back(t->sequence());
+            m.level_bytes[n] += t->file_size();
         }
     }
+    std::reverse(m.levels[0].begin(), m.levels[0].end());   // oldest first
+}
+
+uint64_t KVStore::level_max_bytes(size_t level) const {
+    uint64_t bytes = options_.level_base_bytes;
+    for (size_t n = 1; n < level; ++n) bytes *= std::max<uint32_t>(options_.level_size_ratio, 2);
+    return bytes;
+}
+
+size_t KVStore::l0_slowdown_trigger() const {
+    // Universal compaction lets L0 grow to universal_run_trigger tables
+    // before it merges, so stalls start proportionally later.
+    if (options_.compaction_style == CompactionStyle::kUniversal)
+        return std::max<uint32_t>(options_.universal_run_trigger, 2) *
+               L0_SLOWDOWN_TRIGGER / L0_COMPACTION_TRIGGER;
+    return L0_SLOWDOWN_TRIGGER;
 }
 
-void KVStore::compact_l0_to_l1() {
-    run_compaction(this);
+size_t KVStore::l0_stop_trigger() const {
+    return l0_slowdown_trigger() + (L0_HARD_LIMIT - L0_SLOWDOWN_TRIGGER);
+}
+
+double KVStore::compaction_score(size_t& level) const {
+    level = 0;
+    if (options_.compaction_style == CompactionStyle::kUniversal) {
+        size_t runs = levels_[0].size();
+        for (size_t n = 1; n < levels_.size(); ++n) runs += !levels_[n].empty();
+        return static_cast<double>(runs) / std::max<uint32_t>(options_.universal_run_trigger, 2);
+    }
+    double best = static_cast<double>(levels_[0].size()) / L0_COMPACTION_TRIGGER;
+    for (size_t n = 1; n + 1 < levels_.size(); ++n) {
+        uint64_t bytes = 0;
+        for (const auto& t : levels_[n]) bytes += t->file_size();
+        double score = static_cast<double>(bytes) / static_cast<double>(level_max_bytes(n));
+        if (score > best) {
+            best = score;
+            level = n;
+        }
+    }
+    return best;
 }
 
 // ── Diagnostics ────────────────────────────────────────────────
 
 size_t KVStore::memtable_size() const {
+    std::lock_guard<std::mutex> lock(mu_);
     size_t n = active_ ? active_->size() : 0;
-    if (immutable_) n += immutable_->size();
+    for (const auto& f : immutables_) n += f.mem->size();
     return n;
 }
 
@@ -57,24 +57,36 @@ bool Manifest::load(const std::string& path) {
     if (!(in >> token >> v) || token != "VERSION") return false;
     version = v;
 
-    l0_seqs.clear();
-    l1_seqs.clear();
+    levels.clear();
+    level_bytes.clear();
+    vlog_replay_offset = 0;
+    vlog_file_id = 0;
+    last_sequence = 0;
 
     while (in >> token) {
-        if (token == "L0") {
+        if (token.size() > 1 && token[0] == 'L' &&
+            token.find_first_not_of("0123456789", 1) == std::string::npos) {
+            // "L<n> <count>" followed by the level's sequence numbers.
+            size_t n = std::stoul(token.substr(1));
             size_t count;
-            if (!(in >> count)) return false;
+            if (n > 255 || !(in >> count)) return false;
+            if (levels.size() <= n) levels.resize(n + 1);
             for (size_t i = 0; i < count; ++i) {
                 uint32_t seq;
-                if (in >> seq) l0_seqs.push_back(seq);
+                if (in >> seq) levels[n].push_back(seq);
             }
-        } else if (token == "L1") {
+        } else if (token == "LEVEL_BYTES") {
             size_t count;
             if (!(in >> count)) return false;
-            for (size_t i = 0; i < count; ++i) {
-                uint32_t seq;
-                if (in >> seq) l1_seqs.push_back(seq);
-            }
+            level_bytes.resize(count);
+            for (auto& b : level_bytes)
+                if (!(in >> b)) return false;
+        } else if (token == "VLOG_REPLAY") {
+            if (!(in >> vlog_replay_offset)) return false;
+        } else if (token == "VLOG_FILE") {
+            if (!(in >> vlog_file_id)) return false;
+        } else if (token == "LAST_SEQ") {
+            if (!(in >> last_sequence)) return false;
         }
     }
     return true;
@@ -86,11 +98,17 @@ bool Manifest::commit(const std::string& path) const {
     // Generate manifest payload
     std::ostringstream oss;
     oss << "VERSION " << version << "\n";
-    oss << "L0 " << l0_seqs.size() << "\n";
-    for (uint32_t seq : l0_seqs) oss << seq << " ";
-    oss << "\nL1 " << l1_seqs.size() << "\n";
-    for (uint32_t seq : l1_seqs) oss << seq << " ";
+    for (size_t n = 0; n < levels.size(); ++n) {
+        oss << "L" << n << " " << levels[n].size() << "\n";
+        for (uint32_t seq : levels[n]) oss << seq << " ";
+        oss << "\n";
+    }
+    oss << "LEVEL_BYTES " << level_bytes.size();
+    for (uint64_t b : level_bytes) oss << " " << b;
     oss << "\n";
+    oss << "VLOG_REPLAY " << vlog_replay_offset << "\n";
+    oss << "VLOG_FILE " << vlog_file_id << "\n";
+    oss << "LAST_SEQ " << last_sequence << "\n";
 
     std::string payload = oss.str();
 
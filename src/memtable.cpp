@@ -1,17 +1,158 @@
 #include "memtable.h"
+#include "bloom.h"
 
-void Memtable::put(const std::string& key, const VLogPointer& pointer) {
-    auto [it, inserted] = table_.insert_or_assign(key, pointer);
-    if (inserted)
-        byte_size_ += key.size() + sizeof(VLogPointer);
+#include <cstring>
+#include <new>
+#include <random>
+#include <thread>
+
+Memtable::Memtable(MemtableRep rep, uint32_t hash_buckets) {
+    head_ = new_node(std::string_view(), nullptr, MAX_HEIGHT);
+    if (rep == MemtableRep::kHashIndex && hash_buckets > 0) {
+        bucket_count_ = hash_buckets;
+        char* mem = arena_.allocate_aligned(sizeof(std::atomic<Node*>) * bucket_count_);
+        buckets_ = reinterpret_cast<std::atomic<Node*>*>(mem);
+        for (uint32_t i = 0; i < bucket_count_; ++i) new (&buckets_[i]) std::atomic<Node*>(nullptr);
+    }
+}
+
+std::atomic<Memtable::Node*>* Memtable::bucket(std::string_view key) const {
+    uint64_t h = hash64(key.data(), static_cast<int>(key.size()), 0x6d656d74);
+    return &buckets_[h % bucket_count_];
 }
 
-bool Memtable::get(const std::string& key, VLogPointer& out_pointer) const {
-    auto it = table_.find(key);
-    if (it == table_.end()) return false;
-    out_pointer = it->second;
+Memtable::Node* Memtable::hash_find(std::string_view key) const {
+    for (Node* n = bucket(key)->load(std::memory_order_acquire); n;
+         n = n->hash_next.load(std::memory_order_acquire))
+        if (n->key() == key) return n;
+    return nullptr;
+}
+
+Memtable::Node* Memtable::new_node(std::string_view key, const VLogPointer* value, int height) {
+    size_t bytes = sizeof(Node) + sizeof(std::atomic<Node*>) * (height - 1);
+    char* mem = arena_.allocate_aligned(bytes + key.size());
+    Node* n = new (mem) Node;
+    for (int i = 1; i < height; ++i) new (&n->next_[i]) std::atomic<Node*>();
+    for (int i = 0; i < height; ++i) n->next_[i].store(nullptr, std::memory_order_relaxed);
+
+    char* key_data = mem + bytes;
+    if (!key.empty()) std::memcpy(key_data, key.data(), key.size());
+    n->hash_next.store(nullptr, std::memory_order_relaxed);
+    n->key_data = key_data;
+    n->key_size = static_cast<uint32_t>(key.size());
+    n->value.store(value, std::memory_order_relaxed);
+    return n;
+}
+
+const VLogPointer* Memtable::copy_pointer(const VLogPointer& pointer) {
+    char* mem = arena_.allocate_aligned(sizeof(VLogPointer));
+    return new (mem) VLogPointer(pointer);
+}
+
+// Height h with probability (1/BRANCHING)^(h-1). Per-thread generator, so
+// concurrent inserters do not contend on it.
+int Memtable::random_height() {
+    thread_local std::minstd_rand rng(
+        static_cast<unsigned>(std::hash<std::thread::id>()(std::this_thread::get_id())));
+    int height = 1;
+    while (height < MAX_HEIGHT && rng() % BRANCHING == 0) ++height;
+    return height;
+}
+
+Memtable::Node* Memtable::find_prev(std::string_view key, Node* start, int level, Node*& out_next) {
+    Node* x = start;
+    while (true) {
+        Node* next = x->next(level);
+        if (!next || next->key() >= key) {
+            out_next = next;
+            return x;
+        }
+        x = next;
+    }
+}
+
+void Memtable::put(std::string_view key, const VLogPointer& pointer) {
+    const VLogPointer* value = copy_pointer(pointer);
+    if (buckets_) {
+        if (Node* existing = hash_find(key)) {
+            existing->value.store(value, std::memory_order_release);
+            return;
+        }
+    }
+
+    // Predecessor and successor of key on every level, top down.
+    Node* prev[MAX_HEIGHT];
+    Node* next[MAX_HEIGHT];
+    int top = max_height_.load(std::memory_order_relaxed);
+    for (int level = MAX_HEIGHT - 1; level >= top; --level) {
+        prev[level] = head_;
+        next[level] = nullptr;
+    }
+    Node* x = head_;
+    for (int level = top - 1; level >= 0; --level)
+        x = prev[level] = find_prev(key, x, level, next[level]);
+
+    if (next[0] && next[0]->key() == key) {
+        next[0]->value.store(value, std::memory_order_release);
+        return;
+    }
+
+    int height = random_height();
+    int cur = max_height_.load(std::memory_order_relaxed);
+    while (height > cur && !max_height_.compare_exchange_weak(cur, height)) {}
+
+    // Link bottom-up. A failed CAS means another insert got between prev
+    // and next on that level: search forward again from prev, which stays a
+    // valid predecessor because nodes are never removed.
+    Node* node = new_node(key, value, height);
+    for (int level = 0; level < height; ++level) {
+        while (true) {
+            node->next_[level].store(next[level], std::memory_order_relaxed);
+            if (prev[level]->next_[level].compare_exchange_strong(next[level], node,
+                                                                 std::memory_order_release))
+                break;
+            prev[level] = find_prev(key, prev[level], level, next[level]);
+            if (level == 0 && next[0] && next[0]->key() == key) {
+                // A concurrent put linked the same key first; the unlinked
+                // node stays in the arena unused.
+                next[0]->value.store(value, std::memory_order_release);
+                return;
+            }
+        }
+    }
+    if (buckets_) {
+        std::atomic<Node*>* head = bucket(key);
+        Node* first = head->load(std::memory_order_relaxed);
+        do {
+            node->hash_next.store(first, std::memory_order_relaxed);
+        } while (!head->compare_exchange_weak(first, node, std::memory_order_release,
+                                              std::memory_order_relaxed));
+    }
+    count_.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool Memtable::get(std::string_view key, VLogPointer& out_pointer) const {
+    if (buckets_) {
+        // A node is chained after it is linked, so a put still in flight
+        // may be missed; a completed put never is.
+        Node* n = hash_find(key);
+        if (!n) return false;
+        out_pointer = *n->value.load(std::memory_order_acquire);
+        return true;
+    }
+    Node* x = head_;
+    Node* next = nullptr;
+    for (int level = max_height_.load(std::memory_order_relaxed) - 1; level >= 0; --level)
+        x = find_prev(key, x, level, next);
+    if (!next || next->key() != key) return false;
+    out_pointer = *next->value.load(std::memory_order_acquire);
     return true;
 }
 
-size_t Memtable::size() const { return table_.size(); }
-size_t Memtable::byte_size() const { return byte_size_; }
+void Memtable::Iterator::seek(std::string_view target) {
+    Node* x = mem_->head_;
+    Node* next = nullptr;
+    for (int level = mem_->max_height_.load(std::memory_order_relaxed) - 1; level >= 0; --level)
+        x = find_prev(target, x, level, next);
+    node_ = next;
+}
@@ -0,0 +1,57 @@
+#include "merge_iterator.h"
+
+#include <algorithm>
+
+MergingIterator::MergingIterator(std::vector<std::unique_ptr<KeyIterator>> sources)
+    : sources_(std::move(sources)) {
+    heap_.reserve(sources_.size());
+}
+
+bool MergingIterator::after(size_t a, size_t b) const {
+    int c = sources_[a]->key().compare(sources_[b]->key());
+    return c != 0 ? c > 0 : a > b;
+}
+
+void MergingIterator::push(size_t i) {
+    heap_.push_back(i);
+    std::push_heap(heap_.begin(), heap_.end(), [this](size_t a, size_t b) { return after(a, b); });
+}
+
+size_t MergingIterator::pop() {
+    std::pop_heap(heap_.begin(), heap_.end(), [this](size_t a, size_t b) { return after(a, b); });
+    size_t i = heap_.back();
+    heap_.pop_back();
+    return i;
+}
+
+void MergingIterator::rebuild() {
+    heap_.clear();
+    for (size_t i = 0; i < sources_.size(); ++i)
+        if (sources_[i]->valid()) push(i);
+}
+
+void MergingIterator::seek_to_first() {
+    for (auto& s : sources_) s->seek_to_first();
+    rebuild();
+}
+
+void MergingIterator::seek(std::string_view target) {
+    for (auto& s : sources_) s->seek(target);
+    rebuild();
+}
+
+void MergingIterator::next() {
+    // Step past the current key in every source that has it: the top entry
+    // and any older source tied with it.
+    skip_.assign(key());
+    while (!heap_.empty() && sources_[heap_.front()]->key() == skip_) {
+        size_t i = pop();
+        sources_[i]->next();
+        if (sources_[i]->valid()) push(i);
+    }
+}
+
+bool MergingIterator::ok() const {
+    return std::all_of(sources_.begin(), sources_.end(),
+                       [](const std::unique_ptr<KeyIterator>& s) { return s->ok(); });
+}
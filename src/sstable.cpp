@@ -1,5 +1,6 @@
 #include "sstable.h"
 #include "crc32.h"
+#include "block_cache.h"
 
 #include <algorithm>
 #include <cstdio>
@@ -8,65 +9,269 @@
 #include <iostream>
 #include <vector>
 
+// ── Platform abstraction ───────────────────────────────────────
+#ifdef _WIN32
+  #ifndef NOMINMAX
+    #define NOMINMAX
+  #endif
+  #include <windows.h>
+  #include <io.h>
+  #include <fcntl.h>
+  #include <sys/stat.h>
+  #define sst_open(p, f, m)  _open(p, f, m)
+  #define sst_close(fd)      _close(fd)
+  #define sst_lseek(fd, o, w) _lseeki64(fd, o, w)
+  static constexpr int SST_WRITE_FLAGS = _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY;
+  static constexpr int SST_READ_FLAGS  = _O_RDONLY | _O_BINARY;
+  static constexpr int SST_MODE        = _S_IREAD | _S_IWRITE;
+#else
+  #include <sys/mman.h>
+  #include <unistd.h>
+  #include <fcntl.h>
+  #define sst_open(p, f, m)  ::open(p, f, m)
+  #define sst_close(fd)      ::close(fd)
+  #define sst_lseek(fd, o, w) lseek(fd, o, w)
+  static constexpr int SST_WRITE_FLAGS = O_WRONLY | O_CREAT | O_TRUNC;
+  static constexpr int SST_READ_FLAGS  = O_RDONLY;
+  static constexpr int SST_MODE        = 0644;
+#endif
+
+// Appends a finished section followed by its checksum.
+static void append_section(std::vector<uint8_t>& out, const std::vector<uint8_t>& section) {
+    uint32_t crc = compute_checksum(kDefaultChecksumType, section.data(), section.size());
+    out.insert(out.end(), section.begin(), section.end());
+    out.insert(out.end(), reinterpret_cast<const uint8_t*>(&crc),
+               reinterpret_cast<const uint8_t*>(&crc) + sizeof(crc));
+}
+
+template <class T>
+static void put_fixed(std::vector<uint8_t>& out, T v) {
+    out.insert(out.end(), reinterpret_cast<const uint8_t*>(&v), reinterpret_cast<const uint8_t*>(&v) + sizeof(T));
+}
+
+static void put_varint(std::vector<uint8_t>& out, uint64_t v) {
+    while (v >= 0x80) {
+        out.push_back(static_cast<uint8_t>(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(v));
+}
+
+// Decodes a varint from [*p, end); false if truncated or longer than 10 bytes.
+static bool get_varint(const uint8_t*& p, const uint8_t* end, uint64_t& v) {
+    v = 0;
+    for (int shift = 0; shift < 64 && p < end; shift += 7) {
+        uint64_t byte = *p++;
+        v |= (byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return true;
+    }
+    return false;
+}
+
+static uint64_t zigzag(uint64_t delta) {
+    return (delta << 1) ^ static_cast<uint64_t>(static_cast<int64_t>(delta) >> 63);
+}
+static uint64_t unzigzag(uint64_t v) { return (v >> 1) ^ (~(v & 1) + 1); }
+
+// Shortest string s with a <= s < b, for index keys (b > a).
+static std::string shortest_separator(std::string_view a, std::string_view b) {
+    size_t i = 0;
+    while (i < a.size() && i < b.size() && a[i] == b[i]) ++i;
+    if (i < a.size() && i < b.size()) {
+        auto c = static_cast<uint8_t>(a[i]);
+        if (c < 0xFF && c + 1 < static_cast<uint8_t>(b[i])) {
+            std::string s(a.substr(0, i + 1));
+            s[i] = static_cast<char>(c + 1);
+            return s;
+        }
+    }
+    return std::string(a);
+}
+
+// ── SSTableBuilder ─────────────────────────────────────────────
+
+SSTableBuilder::SSTableBuilder(IOBackend* io) : io_(io ? io : default_io_backend()) {}
+
+SSTableBuilder::~SSTableBuilder() { close(true); }
+
+bool SSTableBuilder::open(const std::string& path) {
+    close(true);
+    path_ = path;
+    fd_ = sst_open(path.c_str(), SST_WRITE_FLAGS, SST_MODE);
+    ok_ = fd_ >= 0;
+    offset_ = 0;
+    buffer_.clear();
+    block_.clear();
+    restarts_.clear();
+    in_interval_ = 0;
+    last_key_.clear();
+    pending_cut_ = false;
+    entry_count_ = 0;
+    handles_.clear();
+    key_hashes_.clear();
+    return ok_;
+}
+
+void SSTableBuilder::close(bool remove) {
+    if (fd_ < 0) return;
+    sst_close(fd_);
+    fd_ = -1;
+    if (remove) std::remove(path_.c_str());
+}
+
+// Writes the buffered blocks at the end of what is already on disk.
+void SSTableBuilder::flush_buffer(bool sync) {
+    if (!ok_ || (buffer_.empty() && !sync)) return;
+    ok_ = io_->write(fd_, {{buffer_.data(), buffer_.size()}}, offset_, sync);
+    offset_ += buffer_.size();
+    buffer_.clear();
+}
+
+void SSTableBuilder::finish_block(std::string_view separator) {
+    for (uint32_t r : restarts_) put_fixed<uint32_t>(block_, r);
+    put_fixed<uint32_t>(block_, static_cast<uint32_t>(restarts_.size()));
+    handles_.push_back({std::string(separator), file_size(), static_cast<uint32_t>(block_.size())});
+    append_section(buffer_, block_);
+    block_.clear();
+    restarts_.clear();
+    in_interval_ = 0;
+    pending_cut_ = false;
+    if (buffer_.size() >= SSTABLE_WRITE_BUFFER) flush_buffer(false);
+}
+
+void SSTableBuilder::add(std::string_view key, const VLogPointer& ptr) {
+    if (!ok_) return;
+    // A full block is cut here, now that the separator can be chosen.
+    if (pending_cut_) finish_block(shortest_separator(last_key_, key));
+
+    size_t shared = 0;
+    if (in_interval_ == 0) {
+        restarts_.push_back(static_cast<uint32_t>(block_.size()));
+        prev_offset_ = 0;
+    } else {
+        while (shared < key.size() && shared < last_key_.size() && key[shared] == last_key_[shared]) ++shared;
+    }
+    put_varint(block_, shared);
+    put_varint(block_, key.size() - shared);
+    block_.insert(block_.end(), key.begin() + shared, key.end());
+    put_varint(block_, ptr.file_id);
+    put_varint(block_, zigzag(ptr.offset - prev_offset_));
+    put_varint(block_, ptr.length);
+    prev_offset_ = ptr.offset;
+    last_key_.assign(key);
+    in_interval_ = (in_interval_ + 1) % SSTABLE_RESTART_INTERVAL;
+    entry_count_++;
+    key_hashes_.push_back(BloomFilter::key_hash(key));
+    pending_cut_ = block_.size() + (restarts_.size() + 1) * sizeof(uint32_t) >= SSTABLE_BLOCK_SIZE;
+}
+
+bool SSTableBuilder::finish() {
+    if (ok_) {
+        if (!block_.empty()) finish_block(last_key_);
+
+        std::vector<uint8_t> index;
+        put_varint(index, handles_.size());
+        for (const auto& h : handles_) {
+            put_varint(index, h.separator.size());
+            index.insert(index.end(), h.separator.begin(), h.separator.end());
+            put_varint(index, h.offset);
+            put_varint(index, h.size);
+        }
+
+        // Bloom Filter from the hashes collected along the way.
+        BloomFilter bloom;
+        bloom.build_from_hashes(key_hashes_, 0.01); // 1% false positive target
+        std::vector<uint8_t> bloom_block;
+        put_fixed<uint32_t>(bloom_block, bloom.num_hashes());
+        bloom_block.insert(bloom_block.end(), bloom.data().begin(), bloom.data().end());
+        uint64_t bloom_offset = file_size();
+        append_section(buffer_, bloom_block);
+
+        uint64_t index_offset = file_size();
+        append_section(buffer_, index);
+
+        // Footer: index_offset, index_size, bloom_offset, bloom_size, entry_count,
+        // checksum_type, format_version, checksum, magic. The checksum covers the
+        // footer bytes before it.
+        std::vector<uint8_t> footer;
+        put_fixed<uint64_t>(footer, index_offset);
+        put_fixed<uint32_t>(footer, static_cast<uint32_t>(index.size()));
+        put_fixed<uint64_t>(footer, bloom_offset);
+        put_fixed<uint32_t>(footer, static_cast<uint32_t>(bloom_block.size()));
+        put_fixed<uint32_t>(footer, entry_count_);
+        put_fixed<uint32_t>(footer, static_cast<uint32_t>(kDefaultChecksumType));
+        put_fixed<uint32_t>(footer, SSTABLE_FORMAT_VERSION);
+        put_fixed<uint32_t>(footer, compute_checksum(kDefaultChecksumType, footer.data(), footer.size()));
+        put_fixed<uint32_t>(footer, SSTABLE_BLOCK_MAGIC);
+        buffer_.insert(buffer_.end(), footer.begin(), footer.end());
+
+        // The rest of the file, then make it durable: the manifest may
+        // reference it as soon as we return.
+        flush_buffer(true);
+    }
+    close(!ok_);
+    return ok_;
+}
+
 // ── SSTableWriter ──────────────────────────────────────────────
 
 bool SSTableWriter::write(const std::string& path,
-                          const std::map<std::string, VLogPointer>& entries) {
-    // Serialize the data section into a buffer.
-    std::vector<uint8_t> data;
-
-    for (const auto& [key, ptr] : entries) {
-        uint32_t ks = static_cast<uint32_t>(key.size());
-        size_t old = data.size();
-        data.resize(old + sizeof(uint32_t) + ks + sizeof(uint32_t) + sizeof(uint64_t) + sizeof(uint32_t));
-        uint8_t* p = data.data() + old;
-
-        std::memcpy(p, &ks, sizeof(uint32_t));           p += sizeof(uint32_t);
-        std::memcpy(p, key.data(), ks);                   p += ks;
-        std::memcpy(p, &ptr.file_id, sizeof(uint32_t));   p += sizeof(uint32_t);
-        std::memcpy(p, &ptr.offset,  sizeof(uint64_t));   p += sizeof(uint64_t);
-        std::memcpy(p, &ptr.length,  sizeof(uint32_t));
-    }
-
-    // Step 2: Build Bloom Filter
-    std::vector<std::string> keys;
-    keys.reserve(entries.size());
-    for (const auto& [key, ptr] : entries) keys.push_back(key);
-    
-    BloomFilter bloom;
-    bloom.build(keys, 0.01); // 1% false positive target
-
-    uint32_t bloom_offset = static_cast<uint32_t>(data.size());
-    uint32_t k = bloom.num_hashes();
-    uint32_t bloom_size_total = 4 + static_cast<uint32_t>(bloom.data().size());
-    
-    size_t old = data.size();
-    data.resize(old + bloom_size_total);
-    std::memcpy(data.data() + old, &k, 4);
-    std::memcpy(data.data() + old + 4, bloom.data().data(), bloom.data().size());
-
-    // Footer: entry_count, bloom_offset, bloom_size, checksum
-    uint32_t entry_count = static_cast<uint32_t>(entries.size());
-    uint32_t checksum    = compute_crc32(data.data(), data.size());
-
-    // Write data section + bloom section + footer to file.
-    std::ofstream out(path, std::ios::binary | std::ios::trunc);
-    if (!out.is_open()) return false;
-
-    out.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(data.size()));
-    out.write(reinterpret_cast<const char*>(&entry_count),  sizeof(uint32_t));
-    out.write(reinterpret_cast<const char*>(&bloom_offset), sizeof(uint32_t));
-    out.write(reinterpret_cast<const char*>(&bloom_size_total),sizeof(uint32_t));
-    out.write(reinterpret_cast<const char*>(&checksum),     sizeof(uint32_t));
-    out.flush();
-
-    if (!out.good()) return false;
-    out.close();
-    return true;
+                          const std::vector<SSTableEntryRef>& entries,
+                          IOBackend* io) {
+    SSTableBuilder builder(io);
+    if (!builder.open(path)) return false;
+    for (const auto& [key, ptr] : entries) builder.add(key, ptr);
+    return builder.finish();
+}
+
+bool SSTableWriter::write(const std::string& path,
+                          const std::map<std::string, VLogPointer>& entries,
+                          IOBackend* io) {
+    SSTableBuilder builder(io);
+    if (!builder.open(path)) return false;
+    for (const auto& [key, ptr] : entries) builder.add(key, ptr);
+    return builder.finish();
 }
 
 // ── SSTableReader ──────────────────────────────────────────────
 
+// Locates and verifies the footer of a whole-file image in an earlier
+// format. A file ending in SSTABLE_FOOTER_MAGIC has the format 1 footer;
+// one whose checksum type is unknown or which fails verification is retried
+// as a legacy 16-byte footer (IEEE CRC32 over the payload), so a legacy
+// checksum that happens to equal the magic is still read correctly. False
+// if neither layout verifies.
+static bool parse_footer(const std::vector<uint8_t>& file, uint32_t& entry_count,
+                         uint32_t& bloom_offset, uint32_t& bloom_size, size_t& payload_size) {
+    if (file.size() >= FOOTER_SIZE) {
+        uint32_t footer[6];
+        std::memcpy(footer, file.data() + file.size() - FOOTER_SIZE, FOOTER_SIZE);
+        if (footer[5] == SSTABLE_FOOTER_MAGIC && is_known_checksum_type(footer[3])) {
+            auto type = static_cast<ChecksumType>(footer[3]);
+            size_t payload = file.size() - FOOTER_SIZE;
+            uint32_t crc = compute_checksum(type, file.data(), payload);
+            crc = checksum_extend(type, crc, footer, sizeof(uint32_t) * 4);
+            if (crc == footer[4]) {
+                entry_count  = footer[0];
+                bloom_offset = footer[1];
+                bloom_size   = footer[2];
+                payload_size = payload;
+                return true;
+            }
+        }
+    }
+
+    uint32_t footer[4];
+    std::memcpy(footer, file.data() + file.size() - LEGACY_FOOTER_SIZE, LEGACY_FOOTER_SIZE);
+    size_t payload = file.size() - LEGACY_FOOTER_SIZE;
+    if (compute_crc32(file.data(), payload) != footer[3]) return false;
+    entry_count  = footer[0];
+    bloom_offset = footer[1];
+    bloom_size   = footer[2];
+    payload_size = payload;
+    return true;
+}
+
 // Extract sequence number from filename like "sst_000001.sst".
 static uint32_t parse_sequence(const std::string& path) {
     auto pos = path.rfind("sst_");
@@ -74,83 +279,537 @@ static uint32_t parse_sequence(const std::string& path) {
     return static_cast<uint32_t>(std::strtoul(path.c_str() + pos + 4, nullptr, 10));
 }
 
-bool SSTableReader::load(const std::string& path) {
-    path_ = path;
-    sequence_ = parse_sequence(path);
-    entries_.clear();
+// Parses `count` entries (or, with count == 0, every entry) from the first
+// `size` bytes of block->data. False if an entry runs past the end.
+static bool parse_entries(SSTableBlock& block, size_t size, uint32_t count) {
+    const uint8_t* base = block.bytes();
+    size_t off = 0;
+    while (count == 0 ? off < size : block.entries.size() < count) {
+        if (off + sizeof(uint32_t) > size) return false;
 
-    // Read entire file.
-    std::ifstream in(path, std::ios::binary | std::ios::ate);
-    if (!in.is_open()) return false;
+        uint32_t ks = 0;
+        std::memcpy(&ks, base + off, sizeof(uint32_t)); off += sizeof(uint32_t);
 
-    auto file_size = in.tellg();
-    if (file_size < 16) return false;   // too small for footer
+        if (off + ks + sizeof(uint32_t) + sizeof(uint64_t) + sizeof(uint32_t) > size)
+            return false;
 
-    // Read footer (last 16 bytes).
-    in.seekg(file_size - 16, std::ios::beg);
-    uint32_t footer[4];
-    in.read(reinterpret_cast<char*>(footer), 16);
-    if (!in.good()) return false;
+        SSTableEntryRef e;
+        e.key = std::string_view(reinterpret_cast<const char*>(base + off), ks); off += ks;
+        std::memcpy(&e.pointer.file_id, base + off, sizeof(uint32_t)); off += sizeof(uint32_t);
+        std::memcpy(&e.pointer.offset,  base + off, sizeof(uint64_t)); off += sizeof(uint64_t);
+        std::memcpy(&e.pointer.length,  base + off, sizeof(uint32_t)); off += sizeof(uint32_t);
+        block.entries.push_back(e);
+    }
+    return true;
+}
 
-    uint32_t entry_count     = footer[0];
-    uint32_t bloom_offset    = footer[1];
-    uint32_t bloom_size_total= footer[2];
-    uint32_t stored_checksum = footer[3];
+// Prepares a verified block of `size` bytes for SSTableBlockCursor: format 2
+// entries are parsed, format 3 only has its restart array located.
+static bool init_block(SSTableBlock& block, uint32_t format, uint32_t size) {
+    if (format == 2) return parse_entries(block, size, 0);
+    uint32_t n = 0;
+    if (size < 4) return false;
+    std::memcpy(&n, block.bytes() + size - 4, 4);
+    if (n == 0 || (static_cast<uint64_t>(n) + 1) * 4 > size) return false;
+    block.num_restarts = n;
+    block.restarts = size - (n + 1) * 4;
+    return true;
+}
 
-    if (entry_count == 0) return false;
+// Verification state of a mapped block (SSTableReader::block_state_).
+enum : uint8_t { kBlockUnchecked = 0, kBlockVerified, kBlockCorrupt };
+
+SSTableReader::~SSTableReader() { release(); }
+
+SSTableReader::SSTableReader(SSTableReader&& other) noexcept { *this = std::move(other); }
+
+SSTableReader& SSTableReader::operator=(SSTableReader&& other) noexcept {
+    if (this != &other) {
+        release();
+        path_          = std::move(other.path_);
+        sequence_      = other.sequence_;
+        ctx_           = other.ctx_;
+        pinned_bytes_  = other.pinned_bytes_;
+        fd_            = other.fd_;
+        map_           = other.map_;
+        map_size_      = other.map_size_;
+        block_state_   = std::move(other.block_state_);
+        format_        = other.format_;
+        checksum_type_ = other.checksum_type_;
+        entry_count_   = other.entry_count_;
+        file_size_     = other.file_size_;
+        min_key_       = std::move(other.min_key_);
+        index_         = std::move(other.index_);
+        resident_      = std::move(other.resident_);
+        bloom_         = std::move(other.bloom_);
+        other.fd_ = -1;
+        other.map_ = nullptr;
+        other.map_size_ = 0;
+        other.pinned_bytes_ = 0;
+        other.entry_count_ = 0;
+    }
+    return *this;
+}
+
+void SSTableReader::close_file() {
+    if (fd_ >= 0) sst_close(fd_);
+    fd_ = -1;
+}
+
+// Maps the whole file read-only; the descriptor is not needed afterwards.
+bool SSTableReader::map_file(uint64_t file_size) {
+#ifdef _WIN32
+    HANDLE file = reinterpret_cast<HANDLE>(_get_osfhandle(fd_));
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!mapping) return false;
+    void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);   // the view keeps the mapping alive
+    if (!view) return false;
+#else
+    void* view = mmap(nullptr, file_size, PROT_READ, MAP_SHARED, fd_, 0);
+    if (view == MAP_FAILED) return false;
+#endif
+    map_ = static_cast<const uint8_t*>(view);
+    map_size_ = file_size;
+    close_file();
+    return true;
+}
+
+void SSTableReader::unmap_file() {
+    if (!map_) return;
+#ifdef _WIN32
+    UnmapViewOfFile(map_);
+#else
+    munmap(const_cast<uint8_t*>(map_), map_size_);
+#endif
+    map_ = nullptr;
+    map_size_ = 0;
+    block_state_.reset();
+}
+
+void SSTableReader::release() {
+    close_file();
+    unmap_file();
+    if (ctx_.cache && pinned_bytes_) ctx_.cache->unpin(pinned_bytes_);
+    pinned_bytes_ = 0;
+}
+
+bool SSTableReader::load(const std::string& path, IOBackend* io) {
+    SSTableReadContext ctx;
+    ctx.io = io;
+    return load(path, ctx);
+}
+
+bool SSTableReader::load(const std::string& path, const SSTableReadContext& ctx) {
+    release();
+    path_ = path;
+    sequence_ = parse_sequence(path);
+    ctx_ = ctx;
+    if (!ctx_.io) ctx_.io = default_io_backend();
+    entry_count_ = 0;
+    min_key_.clear();
+    index_.clear();
+    resident_.reset();
+    bloom_ = BloomFilter();
 
-    size_t payload_size = file_size - 16;
-    std::vector<uint8_t> buf(payload_size);
-    in.seekg(0, std::ios::beg);
-    in.read(reinterpret_cast<char*>(buf.data()), payload_size);
-    if (!in.good()) return false;
+    fd_ = sst_open(path.c_str(), SST_READ_FLAGS, 0);
+    if (fd_ < 0) return false;
+    auto end = sst_lseek(fd_, 0, SEEK_END);
+    if (end < static_cast<decltype(end)>(LEGACY_FOOTER_SIZE)) return false;   // too small for footer
+    uint64_t file_size = static_cast<uint64_t>(end);
+    file_size_ = file_size;
 
-    // Validate CRC32 over data section + bloom section.
-    uint32_t computed = compute_crc32(buf.data(), payload_size);
-    if (computed != stored_checksum) {
+    // The footer decides the format; earlier formats are read whole.
+    std::vector<uint8_t> tail(std::min<uint64_t>(file_size, BLOCK_FOOTER_SIZE));
+    std::vector<IORead> reads{{fd_, tail.data(), tail.size(), file_size - tail.size()}};
+    if (!ctx_.io->read(reads)) return false;
+    uint32_t magic = 0;
+    std::memcpy(&magic, tail.data() + tail.size() - sizeof(uint32_t), sizeof(uint32_t));
+    if (magic != SSTABLE_BLOCK_MAGIC || tail.size() < BLOCK_FOOTER_SIZE)
+        return load_whole_file(file_size);
+
+    uint64_t index_offset, bloom_offset;
+    uint32_t index_size, bloom_size, type_raw, version, footer_crc;
+    const uint8_t* f = tail.data();
+    std::memcpy(&index_offset, f, 8);      std::memcpy(&index_size, f + 8, 4);
+    std::memcpy(&bloom_offset, f + 12, 8); std::memcpy(&bloom_size, f + 20, 4);
+    std::memcpy(&entry_count_, f + 24, 4); std::memcpy(&type_raw, f + 28, 4);
+    std::memcpy(&version, f + 32, 4);      std::memcpy(&footer_crc, f + 36, 4);
+    if (!is_known_checksum_type(type_raw) ||
+        compute_checksum(static_cast<ChecksumType>(type_raw), f, 36) != footer_crc) {
+        std::cerr << "[SSTable] WARNING: checksum mismatch in footer of " << path << "\n";
+        return false;
+    }
+    if (version != 2 && version != SSTABLE_FORMAT_VERSION) {
+        std::cerr << "[SSTable] WARNING: unsupported format version " << version << " in " << path << "\n";
+        return false;
+    }
+    checksum_type_ = static_cast<ChecksumType>(type_raw);
+    format_ = version;
+    if (entry_count_ == 0) return false;
+    uint64_t body = file_size - BLOCK_FOOTER_SIZE;
+    if (index_offset + index_size + 4 > body || bloom_offset + bloom_size + 4 > index_offset) return false;
+    if (ctx_.mmap && !map_file(file_size))
+        std::cerr << "[SSTable] WARNING: cannot map " << path << ", reading it with pread\n";
+
+    // Index and bloom blocks, each followed by its checksum.
+    std::vector<uint8_t> index_buf, bloom_buf;
+    const uint8_t* index;
+    const uint8_t* bloom;
+    if (map_) {
+        index = map_ + index_offset;
+        bloom = map_ + bloom_offset;
+    } else {
+        index_buf.resize(index_size + 4);
+        bloom_buf.resize(bloom_size + 4);
+        reads = {{fd_, index_buf.data(), index_buf.size(), index_offset},
+                 {fd_, bloom_buf.data(), bloom_buf.size(), bloom_offset}};
+        if (!ctx_.io->read(reads)) return false;
+        index = index_buf.data();
+        bloom = bloom_buf.data();
+    }
+    auto verify = [&](const uint8_t* section, uint32_t size) {
+        uint32_t crc;
+        std::memcpy(&crc, section + size, 4);
+        return compute_checksum(checksum_type_, section, size) == crc;
+    };
+    if (!verify(index, index_size) || !verify(bloom, bloom_size)) {
         std::cerr << "[SSTable] WARNING: checksum mismatch in " << path << "\n";
         return false;
     }
 
-    // Parse entries from data section.
-    size_t off = 0;
-    for (uint32_t i = 0; i < entry_count; ++i) {
-        if (off + sizeof(uint32_t) > bloom_offset) return false;
+    if (!(format_ == 2 ? parse_index_v2(index, index_size)
+                       : parse_index(index, index_size)))
+        return false;
+    for (const auto& e : index_)
+        if (e.offset + e.size + 4 > bloom_offset) return false;
+    if (index_.empty()) return false;
 
-        uint32_t ks = 0;
-        std::memcpy(&ks, buf.data() + off, sizeof(uint32_t)); off += sizeof(uint32_t);
+    if (bloom_size >= 4) {
+        uint32_t k;
+        std::memcpy(&k, bloom, 4);
+        if (map_) bloom_.load_view(bloom + 4, bloom_size - 4, k);
+        else bloom_.load(std::vector<uint8_t>(bloom + 4, bloom + bloom_size), k);
+    }
+    block_state_ = std::make_unique<std::atomic<uint8_t>[]>(index_.size());
 
-        if (off + ks + sizeof(uint32_t) + sizeof(uint64_t) + sizeof(uint32_t) > bloom_offset)
-            return false;
+    // The first block gives min_key() and proves the data is readable.
+    SSTableBlockCursor first(read_block(0));
+    first.seek_to_first();
+    if (!first.valid()) return false;
+    min_key_ = std::string(first.key());
 
-        SSTableEntry e;
-        e.key.assign(reinterpret_cast<const char*>(buf.data() + off), ks); off += ks;
-        std::memcpy(&e.pointer.file_id, buf.data() + off, sizeof(uint32_t)); off += sizeof(uint32_t);
-        std::memcpy(&e.pointer.offset,  buf.data() + off, sizeof(uint64_t)); off += sizeof(uint64_t);
-        std::memcpy(&e.pointer.length,  buf.data() + off, sizeof(uint32_t)); off += sizeof(uint32_t);
+    pinned_bytes_ = (map_ ? 0 : bloom_size) + index_size + index_.size() * sizeof(IndexEntry);
+    if (ctx_.cache) ctx_.cache->pin(pinned_bytes_);
+    return true;
+}
 
-        entries_.push_back(std::move(e));
+bool SSTableReader::parse_index(const uint8_t* p, size_t size) {
+    const uint8_t* end = p + size;
+    uint64_t count = 0;
+    if (!get_varint(p, end, count)) return false;
+    for (uint64_t i = 0; i < count; ++i) {
+        uint64_t ks = 0, offset = 0, block_size = 0;
+        if (!get_varint(p, end, ks) || ks > static_cast<uint64_t>(end - p)) return false;
+        IndexEntry e;
+        e.separator.assign(reinterpret_cast<const char*>(p), ks);
+        p += ks;
+        if (!get_varint(p, end, offset) || !get_varint(p, end, block_size)) return false;
+        e.offset = offset;
+        e.size   = static_cast<uint32_t>(block_size);
+        index_.push_back(std::move(e));
     }
+    return true;
+}
+
+// Format 2: fixed-width fields and whole last keys.
+bool SSTableReader::parse_index_v2(const uint8_t* p, size_t size) {
+    uint32_t block_count = 0;
+    if (size < 4) return false;
+    std::memcpy(&block_count, p, 4);
+    size_t off = 4;
+    for (uint32_t i = 0; i < block_count; ++i) {
+        uint32_t ks = 0;
+        if (off + 4 > size) return false;
+        std::memcpy(&ks, p + off, 4); off += 4;
+        if (off + ks + 12 > size) return false;
+        IndexEntry e;
+        e.separator.assign(reinterpret_cast<const char*>(p + off), ks); off += ks;
+        std::memcpy(&e.offset, p + off, 8); off += 8;
+        std::memcpy(&e.size, p + off, 4);   off += 4;
+        index_.push_back(std::move(e));
+    }
+    return true;
+}
+
+// Format 1 and legacy files: read everything once and keep it resident as
+// a single block.
+bool SSTableReader::load_whole_file(uint64_t file_size) {
+    auto block = std::make_shared<SSTableBlock>();
+    block->data.resize(file_size);
+    std::vector<IORead> reads{{fd_, block->data.data(), block->data.size(), 0}};
+    if (!ctx_.io->read(reads)) return false;
+    close_file();
+
+    uint32_t entry_count = 0, bloom_offset = 0, bloom_size_total = 0;
+    size_t   payload_size = 0;
+    if (!parse_footer(block->data, entry_count, bloom_offset, bloom_size_total, payload_size)) {
+        std::cerr << "[SSTable] WARNING: checksum mismatch in " << path_ << "\n";
+        return false;
+    }
+    if (entry_count == 0) return false;
+    if (!parse_entries(*block, bloom_offset, entry_count)) return false;
 
     // Init bloom
     if (bloom_size_total >= 4 && bloom_offset + 4 <= payload_size) {
         uint32_t k;
-        std::memcpy(&k, buf.data() + bloom_offset, 4);
+        std::memcpy(&k, block->data.data() + bloom_offset, 4);
         uint32_t actual_bloom_size = bloom_size_total - 4;
-        bloom_.load(path, bloom_offset + 4, actual_bloom_size, k);
+        bloom_.load(path_, bloom_offset + 4, actual_bloom_size, k);
     }
 
+    entry_count_ = entry_count;
+    min_key_ = std::string(block->entries.front().key);
+    index_.push_back({std::string(block->entries.back().key), 0, 0});
+    pinned_bytes_ = block->data.size() + block->entries.size() * sizeof(SSTableEntryRef);
+    if (ctx_.cache) ctx_.cache->pin(pinned_bytes_);
+    resident_ = std::move(block);
     return true;
 }
 
-bool SSTableReader::get(const std::string& key, VLogPointer& out_pointer) const {
-    // Binary search on sorted entries.
-    auto it = std::lower_bound(entries_.begin(), entries_.end(), key,
-        [](const SSTableEntry& e, const std::string& k) { return e.key < k; });
+SSTableBlockHandle SSTableReader::read_block(size_t i, bool fill_cache) const {
+    if (resident_) return resident_;
+    if (map_) return mapped_block(i);
+    if (block_state_[i].load(std::memory_order_acquire) == kBlockCorrupt) return nullptr;
+    const IndexEntry& e = index_[i];
+    if (ctx_.cache) {
+        if (auto cached = ctx_.cache->lookup(ctx_.cache_owner, sequence_, e.offset)) {
+            if (ctx_.metrics) ctx_.metrics->block_cache_hits++;
+            return cached;
+        }
+        if (ctx_.metrics) ctx_.metrics->block_cache_misses++;
+    }
+    auto block = std::make_shared<SSTableBlock>();
+    block->data.resize(static_cast<size_t>(e.size) + 4);
+    std::vector<IORead> reads{{fd_, block->data.data(), block->data.size(), e.offset}};
+    if (!ctx_.io->read(reads)) {
+        std::cerr << "[SSTable] WARNING: failed to read block " << i << " of " << path_ << "\n";
+        return nullptr;
+    }
+    uint32_t crc;
+    std::memcpy(&crc, block->data.data() + e.size, 4);
+    if (compute_checksum(checksum_type_, block->data.data(), e.size) != crc ||
+        !init_block(*block, format_, e.size)) {
+        mark_corrupt(i);
+        return nullptr;
+    }
+    if (ctx_.cache && fill_cache) {
+        size_t charge = block->data.size() + block->entries.size() * sizeof(SSTableEntryRef) +
+                        sizeof(SSTableBlock);
+        size_t evicted = ctx_.cache->insert(ctx_.cache_owner, sequence_, e.offset, block, charge);
+        if (ctx_.metrics) ctx_.metrics->block_cache_evictions += evicted;
+    }
+    return block;
+}
+
+// A mapped block is checksummed the first time it is used, then decoded in
+// place; the OS page cache stands in for the block cache.
+SSTableBlockHandle SSTableReader::mapped_block(size_t i) const {
+    const IndexEntry& e = index_[i];
+    auto block = std::make_shared<SSTableBlock>();
+    block->mapped = map_ + e.offset;
+    uint8_t state = block_state_[i].load(std::memory_order_acquire);
+    if (state == kBlockUnchecked) {
+        uint32_t crc;
+        std::memcpy(&crc, block->mapped + e.size, 4);
+        if (compute_checksum(checksum_type_, block->mapped, e.size) != crc) {
+            mark_corrupt(i);
+            return nullptr;
+        }
+        block_state_[i].compare_exchange_strong(state, kBlockVerified, std::memory_order_acq_rel);
+        state = block_state_[i].load(std::memory_order_acquire);
+    }
+    if (state == kBlockCorrupt) return nullptr;
+    if (!init_block(*block, format_, e.size)) {
+        mark_corrupt(i);
+        return nullptr;
+    }
+    return block;
+}
+
+// A block stays rejected once it failed, and is reported only then, so a
+// hot corrupt block does not flood the log.
+void SSTableReader::mark_corrupt(size_t i) const {
+    if (block_state_[i].exchange(kBlockCorrupt, std::memory_order_acq_rel) != kBlockCorrupt)
+        std::cerr << "[SSTable] WARNING: checksum mismatch in block " << i << " of " << path_ << "\n";
+}
+
+SSTableLookup SSTableReader::get(const std::string& key, VLogPointer& out_pointer) const {
+    // The first block whose separator is >= key is the only one that can hold it.
+    auto idx = std::lower_bound(index_.begin(), index_.end(), key,
+        [](const IndexEntry& e, const std::string& k) { return e.separator < k; });
+    if (idx == index_.end()) return SSTableLookup::kAbsent;
 
-    if (it != entries_.end() && it->key == key) {
-        out_pointer = it->pointer;
-        return true;
+    SSTableBlockHandle block = read_block(static_cast<size_t>(idx - index_.begin()));
+    if (!block) return SSTableLookup::kCorrupt;
+    SSTableBlockCursor cursor(std::move(block));
+    cursor.seek(key);
+    if (cursor.valid() && cursor.key() == key) {
+        out_pointer = cursor.pointer();
+        return SSTableLookup::kFound;
+    }
+    return cursor.corrupt() ? SSTableLookup::kCorrupt : SSTableLookup::kAbsent;
+}
+
+// ── SSTableBlockCursor ─────────────────────────────────────────
+
+std::string_view SSTableBlockCursor::key() const {
+    if (block_->num_restarts == 0) return block_->entries[pos_].key;
+    return key_;
+}
+
+const VLogPointer& SSTableBlockCursor::pointer() const {
+    if (block_->num_restarts == 0) return block_->entries[pos_].pointer;
+    return pointer_;
+}
+
+uint32_t SSTableBlockCursor::restart_point(uint32_t r) const {
+    uint32_t off;
+    std::memcpy(&off, block_->bytes() + block_->restarts + r * 4, 4);
+    return off;
+}
+
+void SSTableBlockCursor::seek_to_restart(uint32_t r) {
+    restart_ = r;
+    next_ = restart_point(r);
+    prev_offset_ = 0;
+    key_.clear();
+    valid_ = false;
+}
+
+bool SSTableBlockCursor::decode_next() {
+    valid_ = false;
+    if (next_ >= block_->restarts) return false;
+    if (restart_ + 1 < block_->num_restarts && next_ == restart_point(restart_ + 1)) {
+        restart_++;
+        prev_offset_ = 0;
+    }
+    const uint8_t* p   = block_->bytes() + next_;
+    const uint8_t* end = block_->bytes() + block_->restarts;
+    uint64_t shared, unshared, file_id, delta, length;
+    if (!get_varint(p, end, shared) || !get_varint(p, end, unshared) ||
+        shared > key_.size() || unshared > static_cast<uint64_t>(end - p)) {
+        corrupt_ = true;
+        return false;
+    }
+    key_.resize(shared);
+    key_.append(reinterpret_cast<const char*>(p), unshared);
+    p += unshared;
+    if (!get_varint(p, end, file_id) || !get_varint(p, end, delta) || !get_varint(p, end, length)) {
+        corrupt_ = true;
+        return false;
+    }
+    pointer_.file_id = static_cast<uint32_t>(file_id);
+    pointer_.offset  = prev_offset_ + unzigzag(delta);
+    pointer_.length  = static_cast<uint32_t>(length);
+    prev_offset_ = pointer_.offset;
+    next_ = static_cast<uint32_t>(p - block_->bytes());
+    valid_ = true;
+    return true;
+}
+
+void SSTableBlockCursor::seek_to_first() {
+    valid_ = false;
+    corrupt_ = false;
+    if (!block_) return;
+    if (block_->num_restarts == 0) {
+        pos_ = 0;
+        valid_ = !block_->entries.empty();
+        return;
+    }
+    seek_to_restart(0);
+    decode_next();
+}
+
+void SSTableBlockCursor::next() {
+    if (block_->num_restarts == 0) {
+        valid_ = ++pos_ < block_->entries.size();
+        return;
+    }
+    decode_next();
+}
+
+void SSTableBlockCursor::seek(std::string_view target) {
+    valid_ = false;
+    corrupt_ = false;
+    if (!block_) return;
+    if (block_->num_restarts == 0) {
+        auto it = std::lower_bound(block_->entries.begin(), block_->entries.end(), target,
+            [](const SSTableEntryRef& e, std::string_view k) { return e.key < k; });
+        pos_ = static_cast<size_t>(it - block_->entries.begin());
+        valid_ = pos_ < block_->entries.size();
+        return;
+    }
+
+    // Last restart point whose (whole) key is < target, then scan forward.
+    uint32_t lo = 0, hi = block_->num_restarts - 1;
+    while (lo < hi) {
+        uint32_t mid = (lo + hi + 1) / 2;
+        seek_to_restart(mid);
+        if (!decode_next()) return;
+        if (key_ < target) lo = mid;
+        else hi = mid - 1;
+    }
+    seek_to_restart(lo);
+    while (decode_next())
+        if (std::string_view(key_) >= target) return;
+}
+
+// ── SSTableReader::Iterator ────────────────────────────────────
+
+void SSTableReader::Iterator::load_block(size_t i) {
+    index_ = i;
+    cursor_ = SSTableBlockCursor();
+    if (i >= table_->index_.size()) return;
+    SSTableBlockHandle block = table_->read_block(i, fill_cache_);
+    if (!block) {
+        ok_ = false;
+        return;
+    }
+    cursor_ = SSTableBlockCursor(std::move(block));
+}
+
+void SSTableReader::Iterator::seek_to_first() {
+    ok_ = true;
+    load_block(0);
+    cursor_.seek_to_first();
+    skip_exhausted_blocks();
+}
+
+void SSTableReader::Iterator::seek(std::string_view target) {
+    ok_ = true;
+    auto idx = std::lower_bound(table_->index_.begin(), table_->index_.end(), target,
+        [](const IndexEntry& e, std::string_view k) { return e.separator < k; });
+    load_block(static_cast<size_t>(idx - table_->index_.begin()));
+    cursor_.seek(target);
+    skip_exhausted_blocks();
+}
+
+void SSTableReader::Iterator::next() {
+    cursor_.next();
+    skip_exhausted_blocks();
+}
+
+// Moves to the first entry of the following block while the current one
+// is used up; stops at the end or on a bad block.
+void SSTableReader::Iterator::skip_exhausted_blocks() {
+    while (!cursor_.valid() && ok_) {
+        if (cursor_.corrupt()) {
+            ok_ = false;
+            return;
+        }
+        if (index_ + 1 >= table_->index_.size()) return;
+        load_block(index_ + 1);
+        cursor_.seek_to_first();
     }
-    return false;
 }
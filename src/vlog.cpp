@@ -1,8 +1,10 @@
 #include "vlog.h"
+#include "crc32.h"
 
 #include <cerrno>
 #include <cstring>
 #include <iostream>
+#include <limits>
 #include <vector>
 
 // ── Platform abstraction ───────────────────────────────────────
@@ -11,64 +13,30 @@
   #include <fcntl.h>
   #include <sys/stat.h>
   #define vlog_open(p, f, m)    _open(p, f, m)
-  #define vlog_write(fd, b, n)  _write(fd, b, static_cast<unsigned int>(n))
-  #define vlog_read(fd, b, n)   _read(fd, b, static_cast<unsigned int>(n))
   #define vlog_close(fd)        _close(fd)
-  #define vlog_fsync(fd)        _commit(fd)
   #define vlog_lseek(fd, o, w)  _lseeki64(fd, o, w)
-  static constexpr int VLOG_APPEND_FLAGS = _O_WRONLY | _O_APPEND | _O_CREAT | _O_BINARY;
+  #define vlog_ftruncate(fd, n) _chsize_s(fd, n)
+  static constexpr int VLOG_WRITE_FLAGS  = _O_WRONLY | _O_CREAT | _O_BINARY;
   static constexpr int VLOG_READ_FLAGS   = _O_RDONLY | _O_BINARY;
   static constexpr int VLOG_MODE         = _S_IREAD | _S_IWRITE;
-  #ifndef EINTR
-    #define EINTR 0
-  #endif
 #else
   #include <unistd.h>
   #include <fcntl.h>
   #define vlog_open(p, f, m)    open(p, f, m)
-  #define vlog_write(fd, b, n)  write(fd, b, n)
-  #define vlog_read(fd, b, n)   read(fd, b, n)
   #define vlog_close(fd)        close(fd)
-  #define vlog_fsync(fd)        fdatasync(fd)
   #define vlog_lseek(fd, o, w)  lseek(fd, o, w)
-  static constexpr int VLOG_APPEND_FLAGS = O_WRONLY | O_APPEND | O_CREAT;
+  #define vlog_ftruncate(fd, n) ftruncate(fd, n)
+  static constexpr int VLOG_WRITE_FLAGS  = O_WRONLY | O_CREAT;
   static constexpr int VLOG_READ_FLAGS   = O_RDONLY;
   static constexpr int VLOG_MODE         = 0644;
 #endif
 
-// ── Helpers ────────────────────────────────────────────────────
-
-static bool vlog_write_all(int fd, const void* buf, size_t len) {
-    const uint8_t* p = static_cast<const uint8_t*>(buf);
-    size_t rem = len;
-    while (rem > 0) {
-        auto n = vlog_write(fd, p, rem);
-        if (n < 0) { if (errno == EINTR) continue; return false; }
-        if (n == 0) return false;
-        p   += n;
-        rem -= static_cast<size_t>(n);
-    }
-    return true;
-}
-
-static bool vlog_read_exact(int fd, void* buf, size_t len) {
-    uint8_t* p = static_cast<uint8_t*>(buf);
-    size_t rem = len;
-    while (rem > 0) {
-        auto n = vlog_read(fd, p, rem);
-        if (n < 0) { if (errno == EINTR) continue; return false; }
-        if (n == 0) return false;
-        p   += n;
-        rem -= static_cast<size_t>(n);
-    }
-    return true;
-}
-
 // ── VLog implementation ────────────────────────────────────────
 
-VLog::VLog(const std::string& path)
-    : path_(path), write_fd_(-1), read_fd_(-1), current_offset_(0) {
-    write_fd_ = vlog_open(path_.c_str(), VLOG_APPEND_FLAGS, VLOG_MODE);
+VLog::VLog(const std::string& path, IOBackend* io, uint32_t file_id)
+    : io_(io ? io : default_io_backend()), path_(path), file_id_(file_id), write_fd_(-1),
+      read_fd_(-1), current_offset_(0) {
+    write_fd_ = vlog_open(path_.c_str(), VLOG_WRITE_FLAGS, VLOG_MODE);
     if (write_fd_ < 0) {
         std::cerr << "[VLog] FATAL: cannot open write fd: " << path_ << "\n";
         std::abort();
@@ -90,58 +58,290 @@ VLog::~VLog() {
     if (read_fd_  >= 0) vlog_close(read_fd_);
 }
 
-bool VLog::append(const std::string& value, VLogPointer& out_pointer) {
+bool VLog::append(std::string_view value, VLogPointer& out_pointer) {
     uint32_t value_size = static_cast<uint32_t>(value.size());
 
-    // Serialize: [value_size][value_bytes]
-    std::vector<uint8_t> record(sizeof(uint32_t) + value_size);
-    std::memcpy(record.data(), &value_size, sizeof(uint32_t));
-    if (value_size > 0)
-        std::memcpy(record.data() + sizeof(uint32_t), value.data(), value_size);
+    // Serialize: [value_size][value_bytes] — header copied, value referenced.
+    gather_.clear();
+    gather_.copy(&value_size, sizeof(uint32_t));
+    gather_.add(value.data(), value_size);
 
     // Capture offset BEFORE write.
     uint64_t write_offset = current_offset_;
 
-    if (!vlog_write_all(write_fd_, record.data(), record.size())) {
-        std::cerr << "[VLog] ERROR: write failed\n";
+    // Advances current_offset_ only AFTER a successful write.
+    if (!write_gathered(false, "write")) return false;
+
+    out_pointer.file_id = file_id_;
+    out_pointer.offset  = write_offset;
+    out_pointer.length  = value_size;
+    return true;
+}
+
+// Positioned write of gather_ at current_offset_; the offset advances only
+// on success.
+bool VLog::write_gathered(bool sync, const char* what) {
+    if (!io_->write(write_fd_, gather_.slices(), current_offset_, sync)) {
+        std::cerr << "[VLog] ERROR: " << what << " failed\n";
         return false;   // current_offset_ NOT advanced
     }
+    current_offset_ += gather_.size();
+    return true;
+}
+
+bool VLog::append_group(const std::vector<std::string_view>& values,
+                        std::vector<VLogPointer>& out_pointers, bool sync) {
+    // Every [value_size][value_bytes] record back-to-back, values by reference.
+    gather_.clear();
+    std::vector<VLogPointer> ptrs(values.size());
+    for (size_t i = 0; i < values.size(); ++i) {
+        uint32_t value_size = static_cast<uint32_t>(values[i].size());
+        ptrs[i].file_id = file_id_;
+        ptrs[i].offset  = current_offset_ + gather_.size();
+        ptrs[i].length  = value_size;
+        gather_.copy(&value_size, sizeof(uint32_t));
+        gather_.add(values[i].data(), value_size);
+    }
+
+    if (!write_gathered(sync, "group write")) return false;
+    out_pointers = std::move(ptrs);
+    return true;
+}
 
-    // Advance offset AFTER successful write.
-    current_offset_ += record.size();
+// ── Keyed records (VLog as WAL) ────────────────────────────────
 
-    out_pointer.file_id = 0;
-    out_pointer.offset  = write_offset;
-    out_pointer.length  = value_size;
+static constexpr size_t KEYED_HEADER = 20;   // marker, key_size, seq, checksum
+
+// The marker names the checksum type: the original markers use IEEE CRC32,
+// the *_CRC32C ones (all that is written now) CRC32C.
+static ChecksumType marker_checksum_type(uint32_t marker) {
+    return (marker == VLog::KEYED_MARKER_CRC32C || marker == VLog::BATCH_MARKER_CRC32C)
+               ? ChecksumType::kCRC32C : ChecksumType::kCRC32;
+}
+
+static uint32_t keyed_checksum(ChecksumType type, uint32_t key_size, uint64_t seq,
+                               uint32_t value_size, std::string_view key, std::string_view value) {
+    uint32_t crc = checksum_extend(type, 0, &key_size, sizeof(uint32_t));
+    crc = checksum_extend(type, crc, &seq, sizeof(uint64_t));
+    crc = checksum_extend(type, crc, &value_size, sizeof(uint32_t));
+    crc = checksum_extend(type, crc, key.data(), key.size());
+    return checksum_extend(type, crc, value.data(), value.size());
+}
+
+// Appends one keyed record to `out`; returns the offset of its [value_size]
+// field relative to the start of the record. `payload_crc` is extended over
+// every emitted byte (the batch envelope checksum).
+static size_t encode_keyed(GatherBuffer& out, const VLogRecordRef& r, uint32_t& payload_crc) {
+    uint32_t key_size   = static_cast<uint32_t>(r.key.size());
+    std::string_view value = r.is_tombstone ? std::string_view() : r.value;
+    uint32_t value_size = r.is_tombstone ? VLog::TOMBSTONE_SIZE : static_cast<uint32_t>(value.size());
+
+    uint8_t header[KEYED_HEADER];
+    uint32_t marker   = VLog::KEYED_MARKER_CRC32C;
+    uint32_t checksum = keyed_checksum(ChecksumType::kCRC32C, key_size, r.seq, value_size, r.key, value);
+    std::memcpy(header,      &marker,   sizeof(uint32_t));
+    std::memcpy(header + 4,  &key_size, sizeof(uint32_t));
+    std::memcpy(header + 8,  &r.seq,    sizeof(uint64_t));
+    std::memcpy(header + 16, &checksum, sizeof(uint32_t));
+
+    out.copy(header, KEYED_HEADER);
+    out.add(r.key.data(), key_size);
+    out.copy(&value_size, sizeof(uint32_t));
+    out.add(value.data(), value.size());
+
+    payload_crc = crc32c_extend(payload_crc, header, KEYED_HEADER);
+    payload_crc = crc32c_extend(payload_crc, r.key.data(), key_size);
+    payload_crc = crc32c_extend(payload_crc, &value_size, sizeof(uint32_t));
+    payload_crc = crc32c_extend(payload_crc, value.data(), value.size());
+    return KEYED_HEADER + key_size;
+}
+
+bool VLog::append_keyed_group(const std::vector<VLogRecordRef>& records,
+                              std::vector<VLogPointer>& out_pointers, bool sync) {
+    gather_.clear();
+    std::vector<VLogPointer> ptrs(records.size());
+    for (size_t i = 0; i < records.size(); ) {
+        size_t n = records[i].batch_size > 0 ? records[i].batch_size : 1;
+
+        // Batches get a 16-byte envelope whose payload size and checksum are
+        // only known once the records have been emitted; reserve and patch.
+        uint32_t head[4] = {BATCH_MARKER_CRC32C, static_cast<uint32_t>(n), 0, 0};
+        size_t envelope = 0;
+        if (records[i].batch_size > 0) envelope = gather_.copy(head, sizeof(head));
+        size_t payload_start = gather_.size();
+
+        uint32_t payload_crc = 0;
+        for (size_t j = i; j < i + n; ++j) {
+            uint64_t record_start = current_offset_ + gather_.size();
+            size_t vf = encode_keyed(gather_, records[j], payload_crc);
+            ptrs[j].file_id = file_id_;
+            ptrs[j].offset  = record_start + vf;
+            ptrs[j].length  = records[j].is_tombstone ? 0 : static_cast<uint32_t>(records[j].value.size());
+        }
+
+        if (records[i].batch_size > 0) {
+            head[2] = static_cast<uint32_t>(gather_.size() - payload_start);
+            head[3] = payload_crc;
+            gather_.patch(envelope, head, sizeof(head));
+        }
+        i += n;
+    }
+
+    if (!write_gathered(sync, "keyed group write")) return false;
+    out_pointers = std::move(ptrs);
+    return true;
+}
+
+size_t VLog::decode_keyed(const uint8_t* buf, size_t len, uint64_t base,
+                          VLogScanEntry& out) {
+    if (len < KEYED_HEADER + sizeof(uint32_t)) return 0;
+    uint32_t marker, key_size, checksum;
+    uint64_t seq;
+    std::memcpy(&marker,   buf,      sizeof(uint32_t));
+    std::memcpy(&key_size, buf + 4,  sizeof(uint32_t));
+    std::memcpy(&seq,      buf + 8,  sizeof(uint64_t));
+    std::memcpy(&checksum, buf + 16, sizeof(uint32_t));
+    if ((marker != KEYED_MARKER && marker != KEYED_MARKER_CRC32C) ||
+        key_size > len - KEYED_HEADER - sizeof(uint32_t)) return 0;
+
+    size_t value_field = KEYED_HEADER + key_size;
+    uint32_t value_size;
+    std::memcpy(&value_size, buf + value_field, sizeof(uint32_t));
+    bool tombstone = (value_size == TOMBSTONE_SIZE);
+    size_t value_len = tombstone ? 0 : value_size;
+    if (value_len > len - value_field - sizeof(uint32_t)) return 0;
+
+    std::string_view key(reinterpret_cast<const char*>(buf + KEYED_HEADER), key_size);
+    std::string_view value(reinterpret_cast<const char*>(buf + value_field + sizeof(uint32_t)), value_len);
+    if (keyed_checksum(marker_checksum_type(marker), key_size, seq, value_size, key, value) != checksum)
+        return 0;
+
+    out.key          = key;
+    out.seq          = seq;
+    out.is_tombstone = tombstone;
+    out.pointer.file_id = 0;
+    out.pointer.offset  = tombstone ? std::numeric_limits<uint64_t>::max() : base + value_field;
+    out.pointer.length  = tombstone ? 0 : value_size;
+    return value_field + sizeof(uint32_t) + value_len;
+}
+
+uint64_t VLog::scan_keyed(uint64_t from,
+                          const std::function<void(const VLogScanEntry&)>& fn) const {
+    uint64_t off = from;
+    std::vector<uint8_t> buf;
+    while (off < current_offset_) {
+        uint32_t head[4];
+        if (!read_exact_at(off, head, sizeof(uint32_t))) break;
+
+        if (head[0] == KEYED_MARKER || head[0] == KEYED_MARKER_CRC32C) {
+            // Fixed part: header + key + value_size; then the value bytes.
+            if (!read_exact_at(off, head, sizeof(uint32_t) * 2)) break;
+            uint32_t key_size = head[1];
+            if (key_size > MAX_SCAN_FIELD) break;
+            size_t fixed = KEYED_HEADER + key_size + sizeof(uint32_t);
+            if (off + fixed > current_offset_) break;
+            buf.resize(fixed);
+            if (!read_exact_at(off, buf.data(), fixed)) break;
+
+            uint32_t value_size;
+            std::memcpy(&value_size, buf.data() + fixed - sizeof(uint32_t), sizeof(uint32_t));
+            size_t value_len = (value_size == TOMBSTONE_SIZE) ? 0 : value_size;
+            if (value_len > MAX_SCAN_FIELD || off + fixed + value_len > current_offset_) break;
+            buf.resize(fixed + value_len);
+            if (value_len > 0 && !read_exact_at(off + fixed, buf.data() + fixed, value_len)) break;
+
+            VLogScanEntry e;
+            if (decode_keyed(buf.data(), buf.size(), off, e) != buf.size()) break;
+            e.pointer.file_id = file_id_;
+            fn(e);
+            off += buf.size();
+        } else if (head[0] == BATCH_MARKER || head[0] == BATCH_MARKER_CRC32C) {
+            if (!read_exact_at(off, head, sizeof(head))) break;
+            uint32_t count = head[1], payload_size = head[2], checksum = head[3];
+            if (payload_size > MAX_SCAN_FIELD || off + sizeof(head) + payload_size > current_offset_) break;
+            buf.resize(payload_size);
+            if (payload_size > 0 && !read_exact_at(off + sizeof(head), buf.data(), payload_size)) break;
+            if (compute_checksum(marker_checksum_type(head[0]), buf.data(), payload_size) != checksum)
+                break;
+
+            // All-or-nothing: decode every record before delivering any.
+            std::vector<VLogScanEntry> ops;
+            size_t pos = 0;
+            for (uint32_t i = 0; i < count; ++i) {
+                VLogScanEntry e;
+                size_t n = decode_keyed(buf.data() + pos, payload_size - pos,
+                                        off + sizeof(head) + pos, e);
+                if (n == 0) break;
+                e.pointer.file_id = file_id_;
+                ops.push_back(e);
+                pos += n;
+            }
+            if (ops.size() != count || pos != payload_size) break;
+            for (const auto& e : ops) fn(e);
+            off += sizeof(head) + payload_size;
+        } else {
+            // Plain [value_size][value] record: nothing to replay, skip it.
+            if (off + sizeof(uint32_t) + head[0] > current_offset_) break;
+            off += sizeof(uint32_t) + head[0];
+        }
+    }
+    return off;
+}
+
+bool VLog::truncate(uint64_t offset) {
+    if (offset >= current_offset_) return true;
+    if (vlog_ftruncate(write_fd_, static_cast<long long>(offset)) != 0) {
+        std::cerr << "[VLog] ERROR: truncate failed (errno=" << errno << ")\n";
+        return false;
+    }
+    current_offset_ = offset;
     return true;
 }
 
+bool VLog::read_exact_at(uint64_t offset, void* buf, size_t len) const {
+    std::vector<IORead> reads{{read_fd_, buf, len, offset}};
+    return io_->read(reads);
+}
+
 bool VLog::sync() {
-    if (vlog_fsync(write_fd_) != 0) {
+    if (!io_->sync(write_fd_)) {
         std::cerr << "[VLog] ERROR: fsync failed (errno=" << errno << ")\n";
         return false;
     }
     return true;
 }
 
-// Read value at pointer.
-// Safety: lseek + read on read_fd_ is NOT thread-safe. This is correct for
-// Phase 2 (single-threaded). Phase 3+ with concurrent reads MUST use pread()
-// on POSIX or per-call file descriptors on Windows to avoid fd position races.
+// Read value at pointer: one positioned read covers [value_size][value],
+// and the stored size must match the pointer. Positioned reads keep no fd
+// state, so concurrent readers are safe.
 bool VLog::read_at(const VLogPointer& pointer, std::string& out_value) const {
-    // Seek to offset on read fd.
-    auto pos = vlog_lseek(read_fd_, static_cast<long long>(pointer.offset), SEEK_SET);
-    if (pos < 0) return false;
-
-    // Read and validate value_size header.
-    uint32_t stored_size = 0;
-    if (!vlog_read_exact(read_fd_, &stored_size, sizeof(uint32_t))) return false;
-    if (stored_size != pointer.length) return false;   // consistency check
-
-    // Read value bytes.
-    out_value.resize(pointer.length);
-    if (pointer.length > 0 && !vlog_read_exact(read_fd_, out_value.data(), pointer.length))
-        return false;
-
+    std::vector<bool> ok;
+    std::vector<std::string> values;
+    read_batch({pointer}, values, ok);
+    if (!ok[0]) return false;
+    out_value = std::move(values[0]);
     return true;
 }
+
+void VLog::read_batch(const std::vector<VLogPointer>& pointers,
+                      std::vector<std::string>& out_values, std::vector<bool>& ok) const {
+    // Each buffer holds the 4-byte size header followed by the value.
+    std::vector<std::string> bufs(pointers.size());
+    std::vector<IORead> reads(pointers.size());
+    for (size_t i = 0; i < pointers.size(); ++i) {
+        bufs[i].resize(sizeof(uint32_t) + pointers[i].length);
+        reads[i] = {read_fd_, bufs[i].data(), bufs[i].size(), pointers[i].offset};
+    }
+    io_->read(reads);
+
+    out_values.assign(pointers.size(), std::string());
+    ok.assign(pointers.size(), false);
+    for (size_t i = 0; i < pointers.size(); ++i) {
+        if (!reads[i].ok) continue;
+        uint32_t stored_size = 0;
+        std::memcpy(&stored_size, bufs[i].data(), sizeof(uint32_t));
+        if (stored_size != pointers[i].length) continue;   // consistency check
+        out_values[i] = bufs[i].substr(sizeof(uint32_t));
+        ok[i] = true;
+    }
+}
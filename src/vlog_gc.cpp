@@ -5,66 +5,96 @@
 #include <iostream>
 #include <map>
 #include <set>
+#include <stdexcept>
 
 // Definition for run_vlog_gc
 void run_vlog_gc(KVStore* store) {
     if (!store) return;
 
+    // Steps 1–2 run as an exclusive writer so no commit group is mid-append
+    // to the VLog being swapped and the memtables stay still while scanned.
+    //
     // 1. Force a VLog rotation to safely isolate the "old" VLog file for GC.
     // This allows GC to happen cleanly on a static file, without breaking Phase 1/2 VLog constraints.
-    store->vlog_->sync();
     std::string active_vlog_path = store->vlog_path();
     std::string old_vlog_path = store->data_dir_ + "/vlog_gc_target.bin";
+    std::shared_ptr<VLog> old_vlog_reader;
+    std::map<std::string, VLogPointer> live_pointers;
 
-    // Windows requires closing the file before renaming.
-    store->vlog_.reset(); 
+    store->run_exclusive([&]() {
+        // Log mode: the memtable's only durable copy is in the VLog being
+        // retired, so move it into an SSTable before the swap.
+        if (store->options_.vlog_as_wal) store->flush();
 
-    std::filesystem::rename(active_vlog_path, old_vlog_path);
-    store->vlog_ = std::make_unique<VLog>(active_vlog_path); // new clean active VLog
+        {
+            // The background syncer must not see the swap half-done.
+            std::lock_guard<std::mutex> sync_lock(store->sync_mu_);
+            store->vlog_->sync();
 
-    auto old_vlog_reader = std::make_unique<VLog>(old_vlog_path);
+            // The old log stays open and published as retired_vlog_, so
+            // reads keep resolving pointers into it until step 4; POSIX lets
+            // them go on reading the renamed file. The new log gets the next
+            // file id, which tells the two apart.
+            old_vlog_reader = std::move(store->vlog_);
+            std::filesystem::rename(active_vlog_path, old_vlog_path);
+            store->vlog_ = std::make_unique<VLog>(active_vlog_path, store->io_.get(),
+                                                  old_vlog_reader->file_id() + 1);
+            store->retired_vlog_ = old_vlog_reader;
+        }
+        store->install_version();
 
-    // 2. Scan LSM tree to collect ONLY the newest LIVE pointers.
-    std::map<std::string, VLogPointer> live_pointers;
-    std::set<std::string> seen_keys; // Guarantee ONLY latest version per key is rewritten
+        // Offsets restart in the new VLog; recovery must scan it from 0.
+        store->manifest_.vlog_replay_offset = 0;
+        store->manifest_.vlog_file_id = store->vlog_->file_id();
+        if (!store->manifest_.commit(store->manifest_path()))
+            throw std::runtime_error("[VLog GC] Manifest commit failed");
 
-    // Strictly process Newest to Oldest to guarantee shadows are respected.
-    auto process_entries = [&](const std::string& key, const VLogPointer& ptr) {
-        if (seen_keys.find(key) != seen_keys.end()) return; // Older shadowed version, skip
-        
-        seen_keys.insert(key);
-        if (!is_tombstone(ptr)) {
-            live_pointers[key] = ptr;
-        }
-    };
+        // 2. Scan LSM tree to collect ONLY the newest LIVE pointers.
+        std::set<std::string> seen_keys; // Guarantee ONLY latest version per key is rewritten
 
-    // A. Active Memtable (Newest)
-    if (store->active_) {
-        for (const auto& [k, v] : store->active_->entries()) process_entries(k, v);
-    }
+        // Strictly process Newest to Oldest to guarantee shadows are respected.
+        auto process_entries = [&](const std::string& key, const VLogPointer& ptr) {
+            if (seen_keys.find(key) != seen_keys.end()) return; // Older shadowed version, skip
+        
+            seen_keys.insert(key);
+            if (!is_tombstone(ptr)) {
+                live_pointers[key] = ptr;
+            }
+        };
 
-    // B. Immutable Memtable
-    if (store->immutable_) {
-        for (const auto& [k, v] : store->immutable_->entries()) process_entries(k, v);
-    }
+        // A. Active Memtable (Newest)
+        if (store->active_) {
+            store->active_->for_each([&](std::string_view k, const VLogPointer& v) {
+                process_entries(std::string(k), v);
+            });
+        }
 
-    // C. L0 SSTables (Iterate 0 to N. l0_sstables_ is already kept newest-first!)
-    for (const auto& sst : store->l0_sstables_) {
-        for (const auto& e : sst.entries()) process_entries(e.key, e.pointer);
-    }
+        // B. Immutable Memtables, newest first
+        for (auto it = store->immutables_.rbegin(); it != store->immutables_.rend(); ++it) {
+            it->mem->for_each([&](std::string_view k, const VLogPointer& v) {
+                process_entries(std::string(k), v);
+            });
+        }
 
-    // D. L1 SSTables (Oldest level conceptually)
-    for (const auto& sst : store->l1_sstables_) {
-        for (const auto& e : sst.entries()) process_entries(e.key, e.pointer);
-    }
+        // C. SSTables level by level: L0 (kept newest-first!), then each
+        //    deeper level, which only holds older versions.
+        for (const auto& level : store->levels_) {
+            for (const auto& sst : level) {
+                auto it = sst->new_iterator(false);
+                for (it.seek_to_first(); it.valid(); it.next()) process_entries(std::string(it.key()), it.pointer());
+                if (!it.ok()) throw std::runtime_error("[VLog GC] Corrupt data block in " + sst->path());
+            }
+        }
+    });
 
     // 3. Rewrite Live Values
     size_t rewritten = 0;
     for (const auto& [key, ptr] : live_pointers) {
         std::string value;
         if (old_vlog_reader->read_at(ptr, value)) {
-            // standard LSM write path overrides naturally
-            store->put(key, value);
+            // Standard write path, but only if no write since the scan has
+            // replaced or deleted the key.
+            if (!store->rewrite_value(key, value, ptr)) continue;
             // GC internal put should not artificially inflate user structural bytes
             store->subtract_user_bytes(key.size() + value.size());
             rewritten++;
@@ -73,9 +103,14 @@ void run_vlog_gc(KVStore* store) {
         }
     }
 
-    // 4. Verification Step: Ensure NO references point to old vlog physically
-    // (In reality, since we rewrote all valid references matching this file via put(),
-    // and no new writes targeted it, the count of active references to this file is exactly 0).
+    // 4. Every live value now has a newer pointer into the new log. Flush
+    // them to an SSTable, then stop publishing the old log. Readers still
+    // pinning an older Version keep their reference to it.
+    store->run_exclusive([&]() {
+        store->flush();
+        store->retired_vlog_.reset();
+        store->install_version();
+    });
     old_vlog_reader.reset(); // Release Windows file lock
     std::filesystem::remove(old_vlog_path);
     std::cout << "[VLog GC] Rewrote " << rewritten << " live values and dropped old VLog.\n";
@@ -1,9 +1,14 @@
 #include "wal.h"
 #include "crc32.h"
+#include "write_batch.h"
 
 #include <cerrno>
 #include <cstring>
+#include <deque>
+#include <filesystem>
+#include <future>
 #include <iostream>
+#include <memory>
 #include <vector>
 
 // ── Platform abstraction for raw file I/O ──────────────────────
@@ -12,12 +17,11 @@
   #include <fcntl.h>
   #include <sys/stat.h>
   #define wal_open(path, flags, mode)  _open(path, flags, mode)
-  #define wal_write(fd, buf, len)      _write(fd, buf, static_cast<unsigned int>(len))
   #define wal_read(fd, buf, len)       _read(fd, buf, static_cast<unsigned int>(len))
+  #define wal_lseek(fd, off, whence)   _lseeki64(fd, off, whence)
   #define wal_close(fd)                _close(fd)
-  #define wal_fsync(fd)                _commit(fd)
-  static constexpr int WAL_APPEND_FLAGS = _O_WRONLY | _O_APPEND | _O_CREAT | _O_BINARY;
-  static constexpr int WAL_READ_FLAGS   = _O_RDONLY | _O_BINARY;
+  #define wal_extend(fd, len)          _chsize_s(fd, len)
+  static constexpr int WAL_WRITE_FLAGS  = _O_RDWR | _O_CREAT | _O_BINARY;
   static constexpr int WAL_MODE         = _S_IREAD | _S_IWRITE;
   // Windows does not use EINTR; define it away for uniform code.
   #ifndef EINTR
@@ -27,32 +31,16 @@
   #include <unistd.h>
   #include <fcntl.h>
   #define wal_open(path, flags, mode)  open(path, flags, mode)
-  #define wal_write(fd, buf, len)      write(fd, buf, len)
   #define wal_read(fd, buf, len)       read(fd, buf, len)
+  #define wal_lseek(fd, off, whence)   lseek(fd, off, whence)
   #define wal_close(fd)                close(fd)
-  #define wal_fsync(fd)                fdatasync(fd)
-  static constexpr int WAL_APPEND_FLAGS = O_WRONLY | O_APPEND | O_CREAT;
-  static constexpr int WAL_READ_FLAGS   = O_RDONLY;
+  // Allocates real blocks (unlike ftruncate), so later overwrites do not
+  // change the file's size or extent map.
+  #define wal_extend(fd, len)          posix_fallocate(fd, 0, len)
+  static constexpr int WAL_WRITE_FLAGS  = O_RDWR | O_CREAT;
   static constexpr int WAL_MODE         = 0644;
 #endif
 
-// ── Helper: write all bytes, retrying on EINTR and short writes ─
-static bool write_all(int fd, const void* buf, size_t len) {
-    const uint8_t* p = static_cast<const uint8_t*>(buf);
-    size_t remaining = len;
-    while (remaining > 0) {
-        auto written = wal_write(fd, p, remaining);
-        if (written < 0) {
-            if (errno == EINTR) continue;   // interrupted — retry
-            return false;                   // real I/O error
-        }
-        if (written == 0) return false;     // unexpected zero-write
-        p         += written;
-        remaining -= static_cast<size_t>(written);
-    }
-    return true;
-}
-
 // ── Helper: read exactly `len` bytes; returns false on short/EOF ─
 static bool read_exact(int fd, void* buf, size_t len) {
     uint8_t* p = static_cast<uint8_t*>(buf);
@@ -71,12 +59,42 @@ static bool read_exact(int fd, void* buf, size_t len) {
 }
 
 // ── WAL constructor ────────────────────────────────────────────
-WAL::WAL(const std::string& path) : path_(path), fd_(-1), tainted_(false) {
-    fd_ = wal_open(path_.c_str(), WAL_APPEND_FLAGS, WAL_MODE);
+WAL::WAL(const std::string& path, uint32_t log_number, uint64_t preallocate_bytes,
+         IOBackend* io)
+    : io_(io ? io : default_io_backend()), path_(path), fd_(-1), tainted_(false),
+      log_number_(0), checksum_(ChecksumType::kCRC32), version_(0), offset_(0) {
+    fd_ = wal_open(path_.c_str(), WAL_WRITE_FLAGS, WAL_MODE);
     if (fd_ < 0) {
         std::cerr << "[WAL] FATAL: cannot open " << path_ << "\n";
         std::abort();
     }
+
+    auto end = wal_lseek(fd_, 0, SEEK_END);
+    offset_ = end > 0 ? static_cast<uint64_t>(end) : 0;
+
+    uint32_t header[4] = {};
+    if (offset_ == 0) {
+        // Fresh file: stamp it so records can carry a log number.
+        if (!write_header(log_number)) {
+            std::cerr << "[WAL] FATAL: cannot write header to " << path_ << "\n";
+            std::abort();
+        }
+        offset_ = HEADER_SIZE;
+    } else if (offset_ >= HEADER_SIZE &&
+               wal_lseek(fd_, 0, SEEK_SET) == 0 &&
+               read_exact(fd_, header, sizeof(header)) && header[0] == HEADER_MAGIC) {
+        if (!parse_header(header, checksum_)) {
+            std::cerr << "[WAL] FATAL: unsupported format version " << header[1]
+                      << " in " << path_ << "\n";
+            std::abort();
+        }
+        log_number_ = header[2];
+        version_    = header[1];
+    }
+    // else: legacy headerless file, appended to in the old record format
+    // with IEEE CRC32.
+
+    if (preallocate_bytes > offset_ && recyclable()) preallocate(preallocate_bytes);
 }
 
 // ── WAL destructor ─────────────────────────────────────────────
@@ -84,54 +102,149 @@ WAL::~WAL() {
     if (fd_ >= 0) wal_close(fd_);
 }
 
-// ── append ─────────────────────────────────────────────────────
-bool WAL::append(const std::string& key, const std::string& value) {
-    uint32_t key_size   = static_cast<uint32_t>(key.size());
+bool WAL::write_header(uint32_t log_number) {
+    uint32_t header[4] = {HEADER_MAGIC, FORMAT_VERSION, log_number,
+                          static_cast<uint32_t>(kDefaultChecksumType)};
+    if (!io_->write(fd_, {{header, sizeof(header)}}, 0, false)) return false;
+    log_number_ = log_number;
+    checksum_   = kDefaultChecksumType;
+    version_    = FORMAT_VERSION;
+    return true;
+}
+
+// Version 2 headers predate checksum types (reserved word, IEEE CRC32).
+bool WAL::parse_header(const uint32_t header[4], ChecksumType& out) {
+    if (header[1] == 2) {
+        out = ChecksumType::kCRC32;
+        return true;
+    }
+    if (header[1] < 3 || header[1] > FORMAT_VERSION || !is_known_checksum_type(header[3])) return false;
+    out = static_cast<ChecksumType>(header[3]);
+    return true;
+}
+
+bool WAL::preallocate(uint64_t bytes) {
+    if (wal_extend(fd_, static_cast<long long>(bytes)) != 0) {
+        // Not fatal: appends simply grow the file as before.
+        std::cerr << "[WAL] WARNING: preallocation of " << path_ << " failed\n";
+        return false;
+    }
+    return true;
+}
+
+// ── Record encoding ────────────────────────────────────────────
+// Appends one serialized record to `out`: the header is copied, key and
+// value go in by reference when large (no per-record heap buffer). The
+// checksum is computed over the pieces in place. Tombstones carry no value
+// bytes and use the 0xFFFFFFFF value_size marker; batches put the payload
+// length in the key_size slot and the payload in the key position.
+// log_number 0 selects the legacy layout (no log_number field).
+static void encode_record(GatherBuffer& out, const WALRecordRef& r, uint32_t log_number,
+                          ChecksumType type) {
+    std::string_view key = r.key, value = r.value;
     uint32_t value_size = static_cast<uint32_t>(value.size());
-    uint32_t checksum   = record_checksum(key_size, value_size, key, value);
-
-    // Serialize the full record into a single buffer to minimize syscalls.
-    const size_t record_len = sizeof(uint32_t) * 3 + key_size + value_size;
-    std::vector<uint8_t> record(record_len);
-    size_t off = 0;
-    std::memcpy(record.data() + off, &key_size,   sizeof(uint32_t)); off += sizeof(uint32_t);
-    std::memcpy(record.data() + off, &value_size, sizeof(uint32_t)); off += sizeof(uint32_t);
-    std::memcpy(record.data() + off, &checksum,   sizeof(uint32_t)); off += sizeof(uint32_t);
-    std::memcpy(record.data() + off, key.data(),   key_size);        off += key_size;
-    std::memcpy(record.data() + off, value.data(), value_size);
-
-    // Loop until the entire record is written (handles EINTR + short writes).
-    if (!write_all(fd_, record.data(), record_len)) {
-        std::cerr << "[WAL] ERROR: failed to write record\n";
+    if (r.type == WALRecordType::kTombstone) {
+        value_size = WAL_TOMBSTONE_MARKER;
+        value = std::string_view();
+    } else if (r.type == WALRecordType::kBatch) {
+        value_size = WAL_BATCH_MARKER;
+        key = r.value;
+        value = std::string_view();
+    } else if (r.type == WALRecordType::kVLogBase) {
+        value_size = WAL_VLOG_BASE_MARKER;
+        value = std::string_view();
+    }
+    uint32_t key_size = static_cast<uint32_t>(key.size());
+    uint32_t checksum = log_number ? record_checksum(type, log_number, key_size, value_size, key, value)
+                                   : record_checksum(key_size, value_size, key, value);
+
+    uint32_t header[4];
+    size_t   n = 0;
+    header[n++] = key_size;
+    header[n++] = value_size;
+    if (log_number) header[n++] = log_number;
+    header[n++] = checksum;
+    out.copy(header, n * sizeof(uint32_t));
+    out.add(key.data(), key.size());
+    out.add(value.data(), value.size());
+}
+
+// Write everything in gather_ at offset_ (the backend handles EINTR + short
+// writes). offset_ only advances on success.
+bool WAL::write_gathered(const char* what, bool sync) {
+    if (!io_->write(fd_, gather_.slices(), offset_, sync)) {
+        std::cerr << "[WAL] ERROR: failed to write " << what << "\n";
         return false;
     }
+    offset_ += gather_.size();
     return true;
 }
 
+// ── append ─────────────────────────────────────────────────────
+bool WAL::append(const std::string& key, const std::string& value) {
+    gather_.clear();
+    encode_record(gather_, {key, value, WALRecordType::kValue}, log_number_, checksum_);
+    return write_gathered("record");
+}
+
 // ── append_delete ──────────────────────────────────────────────
 bool WAL::append_delete(const std::string& key) {
-    uint32_t key_size   = static_cast<uint32_t>(key.size());
-    uint32_t value_size = 0xFFFFFFFF; // Tombstone marker
-    uint32_t checksum   = record_checksum(key_size, value_size, key, "");
-
-    const size_t record_len = sizeof(uint32_t) * 3 + key_size;
-    std::vector<uint8_t> record(record_len);
-    size_t off = 0;
-    std::memcpy(record.data() + off, &key_size,   sizeof(uint32_t)); off += sizeof(uint32_t);
-    std::memcpy(record.data() + off, &value_size, sizeof(uint32_t)); off += sizeof(uint32_t);
-    std::memcpy(record.data() + off, &checksum,   sizeof(uint32_t)); off += sizeof(uint32_t);
-    std::memcpy(record.data() + off, key.data(),   key_size);
-
-    if (!write_all(fd_, record.data(), record_len)) {
-        std::cerr << "[WAL] ERROR: failed to write tombstone\n";
+    gather_.clear();
+    encode_record(gather_, {key, std::string_view(), WALRecordType::kTombstone}, log_number_, checksum_);
+    return write_gathered("tombstone");
+}
+
+// ── append_batch ───────────────────────────────────────────────
+bool WAL::append_batch(std::string_view payload) {
+    gather_.clear();
+    encode_record(gather_, {std::string_view(), payload, WALRecordType::kBatch}, log_number_, checksum_);
+    return write_gathered("batch");
+}
+
+// ── append_group ───────────────────────────────────────────────
+// One write() for the whole group. A crash mid-write leaves a torn tail,
+// which replay already treats as the end of the log (I4): a prefix of the
+// group may survive, but none of its writers has been acknowledged yet.
+bool WAL::append_group(const std::vector<WALRecordRef>& records, bool sync) {
+    gather_.clear();
+    for (const auto& r : records) encode_record(gather_, r, log_number_, checksum_);
+    return write_gathered("record group", sync);
+}
+
+// ── recycle ────────────────────────────────────────────────────
+// Crash safety: the header is durable under the new log number before the
+// rename, so whichever name survives a crash, the old records are stale and
+// replay yields nothing from them. The caller only recycles a log whose
+// contents are already covered by a committed SSTable.
+bool WAL::recycle(const std::string& new_path, uint32_t new_log_number) {
+    if (!recyclable() || new_log_number <= log_number_) return false;
+    if (!write_header(new_log_number) || !sync()) {
+        std::cerr << "[WAL] ERROR: failed to restamp " << path_ << "\n";
         return false;
     }
+
+    // Windows cannot rename an open file: close, rename, reopen.
+    wal_close(fd_);
+    fd_ = -1;
+    std::error_code ec;
+    std::filesystem::rename(path_, new_path, ec);
+    if (ec) {
+        std::cerr << "[WAL] ERROR: cannot rename " << path_ << " → " << new_path << "\n";
+        return false;
+    }
+    path_ = new_path;
+    fd_ = wal_open(path_.c_str(), WAL_WRITE_FLAGS, WAL_MODE);
+    if (fd_ < 0) {
+        std::cerr << "[WAL] FATAL: cannot reopen " << path_ << "\n";
+        std::abort();
+    }
+    offset_ = HEADER_SIZE;
     return true;
 }
 
 // ── sync ───────────────────────────────────────────────────────
 bool WAL::sync() {
-    if (wal_fsync(fd_) != 0) {
+    if (!io_->sync(fd_)) {
         std::cerr << "[WAL] ERROR: fsync failed (errno=" << errno << ")\n";
         return false;
     }
@@ -140,64 +253,222 @@ bool WAL::sync() {
 
 // ── replay ─────────────────────────────────────────────────────
 //
+// The log is memory-mapped and replayed as a three-stage pipeline:
+//   1. This thread walks record headers only: sizes, bounds and log numbers.
+//      Records are grouped into ~REPLAY_CHUNK_BYTES chunks.
+//   2. Each chunk's checksums (and batch encodings) are verified by a pool
+//      task, so verification of several chunks overlaps.
+//   3. This thread hands verified chunks to `fn` in log order.
+// At most 2 × pool size chunks are in flight, so memory use does not grow
+// with the log. Delivery stops at the first record that fails verification;
+// nothing after it reaches `fn`.
+//
 // Memory safety: key_size and value_size are bounded by MAX_FIELD_SIZE
-// (64 MiB) before any allocation. This prevents a corrupted WAL from
-// causing unbounded memory consumption. See class-level comment in wal.h.
-ReplayResult WAL::replay() const {
-    ReplayResult result;
-    result.tainted = false;
+// (64 MiB) and checked against the mapped length before any access.
 
-    int rfd = wal_open(path_.c_str(), WAL_READ_FLAGS, 0);
-    if (rfd < 0) return result;   // file does not exist yet
+namespace {
 
-    bool hit_eof_cleanly = false;
+// One record located by the header walk, not yet verified.
+struct RecordSpan {
+    uint64_t offset;       // of the record header
+    uint32_t key_size;     // payload length for batches
+    uint32_t value_size;   // or WAL_TOMBSTONE_MARKER / WAL_BATCH_MARKER
+    uint32_t checksum;
+};
 
-    while (true) {
-        uint32_t key_size = 0, value_size = 0, stored_checksum = 0;
+struct ReplayChunk {
+    std::shared_ptr<const std::vector<RecordSpan>> spans;
+    std::future<size_t> verified;   // number of leading spans that verify
+};
 
-        // Read 12-byte header. A clean EOF here means we've consumed
-        // all records — NOT corruption.
-        if (!read_exact(rfd, &key_size, sizeof(uint32_t))) {
-            hit_eof_cleanly = true;
-            break;
+constexpr uint64_t REPLAY_CHUNK_BYTES = 1u << 20;
+
+} // namespace
+
+static bool is_marker(uint32_t value_size) {
+    return value_size == WAL_TOMBSTONE_MARKER || value_size == WAL_BATCH_MARKER ||
+           value_size == WAL_VLOG_BASE_MARKER;
+}
+
+static uint64_t span_body(const RecordSpan& r) {
+    if (is_marker(r.value_size)) return r.key_size;
+    return static_cast<uint64_t>(r.key_size) + r.value_size;
+}
+
+// Returns how many leading spans carry a valid checksum (and, for batches,
+// a well-formed WriteBatch payload).
+static size_t verify_spans(const uint8_t* base, const std::vector<RecordSpan>& spans,
+                           uint64_t record_header, uint32_t log_number, ChecksumType type) {
+    for (size_t i = 0; i < spans.size(); ++i) {
+        const RecordSpan& r = spans[i];
+        const char* p = reinterpret_cast<const char*>(base + r.offset + record_header);
+        std::string_view key(p, r.key_size), value;
+        if (span_body(r) > r.key_size) value = std::string_view(p + r.key_size, r.value_size);
+        uint32_t expected = log_number
+            ? record_checksum(type, log_number, r.key_size, r.value_size, key, value)
+            : record_checksum(r.key_size, r.value_size, key, value);
+        if (expected != r.checksum) return i;
+        if (r.value_size == WAL_BATCH_MARKER &&
+            !WriteBatch::for_each_in(key, [](uint8_t, std::string_view, std::string_view) {}))
+            return i;
+    }
+    return spans.size();
+}
+
+ReplayResult WAL::replay(const std::function<void(const WALEntryView&)>& fn,
+                         ThreadPool* pool) const {
+    ReplayResult result;
+    MappedFile file;
+    if (!file.open(path_)) return result;   // file does not exist yet
+    const uint8_t* base = file.data();
+    const uint64_t size = file.size();
+
+    // Headered file → records carry its log number. Otherwise legacy layout
+    // from byte 0.
+    uint32_t log_number = 0;
+    ChecksumType type = ChecksumType::kCRC32;
+    uint64_t pos = 0;
+    uint32_t file_header[4] = {};
+    if (size >= HEADER_SIZE) std::memcpy(file_header, base, HEADER_SIZE);
+    if (size >= HEADER_SIZE && file_header[0] == HEADER_MAGIC) {
+        if (!parse_header(file_header, type)) {
+            std::cerr << "[WAL] WARNING: unsupported format version " << file_header[1]
+                      << " in " << path_ << ", nothing replayed\n";
+            result.tainted = true;
+            const_cast<WAL*>(this)->tainted_ = true;
+            return result;
         }
-        if (!read_exact(rfd, &value_size,      sizeof(uint32_t))) break;
-        if (!read_exact(rfd, &stored_checksum, sizeof(uint32_t))) break;
-
-        // Read key.
-        std::string key(key_size, '\0');
-        if (key_size > 0 && !read_exact(rfd, key.data(), key_size)) break;
-
-        // Check if tombstone
-        if (value_size == 0xFFFFFFFF) {
-            uint32_t expected = record_checksum(key_size, value_size, key, "");
-            if (stored_checksum != expected) break;
-            result.entries.push_back({std::move(key), "", true});
-            continue;
+        log_number = file_header[2];
+        pos = HEADER_SIZE;
+    }
+    result.log_number  = log_number;
+    result.valid_bytes = pos;
+    const uint64_t record_header = sizeof(uint32_t) * (log_number ? 4 : 3);
+    auto read32 = [&](uint64_t at) {
+        uint32_t v;
+        std::memcpy(&v, base + at, sizeof(uint32_t));
+        return v;
+    };
+
+    uint64_t vlog_cursor = UINT64_MAX;   // next value's VLog offset (kVLogBase)
+    auto next_vlog_offset = [&](size_t value_len) {
+        uint64_t at = vlog_cursor;
+        if (vlog_cursor != UINT64_MAX) vlog_cursor += sizeof(uint32_t) + value_len;
+        return at;
+    };
+
+    bool clean_end = false;   // walk ended at EOF or at another log's record
+    bool corrupt   = false;   // a record failed verification
+    std::deque<ReplayChunk> inflight;
+    const size_t max_inflight = pool ? pool->size() * 2 : 1;
+
+    // Pool tasks read the mapping: never unmap (or unwind) with any running.
+    struct DrainGuard {
+        std::deque<ReplayChunk>& q;
+        ~DrainGuard() { for (auto& c : q) if (c.verified.valid()) c.verified.wait(); }
+    } drain{inflight};
+
+    auto deliver_front = [&]() {
+        ReplayChunk& c = inflight.front();
+        size_t ok = c.verified.get();
+        if (!corrupt) {
+            for (size_t i = 0; i < ok; ++i) {
+                const RecordSpan& r = (*c.spans)[i];
+                const char* p = reinterpret_cast<const char*>(base + r.offset + record_header);
+                if (r.value_size == WAL_VLOG_BASE_MARKER) {
+                    std::memcpy(&vlog_cursor, p, sizeof(uint64_t));
+                } else if (r.value_size == WAL_BATCH_MARKER) {
+                    WriteBatch::for_each_in(std::string_view(p, r.key_size),
+                        [&](uint8_t op, std::string_view k, std::string_view v) {
+                            if (op == WriteBatch::kTypeDeletion) {
+                                fn({k, std::string_view(), true});
+                            } else {
+                                fn({k, v, false, next_vlog_offset(v.size())});
+                            }
+                            ++result.entries;
+                        });
+                } else if (r.value_size == WAL_TOMBSTONE_MARKER) {
+                    fn({std::string_view(p, r.key_size), std::string_view(), true});
+                    ++result.entries;
+                } else {
+                    std::string_view value(p + r.key_size, r.value_size);
+                    fn({std::string_view(p, r.key_size), value, false, next_vlog_offset(value.size())});
+                    ++result.entries;
+                }
+                result.valid_bytes = r.offset + record_header + span_body(r);
+            }
+            if (ok < c.spans->size()) corrupt = true;
         }
+        inflight.pop_front();
+    };
 
-        // Size sanity check — corruption guard.
-        if (key_size > MAX_FIELD_SIZE || value_size > MAX_FIELD_SIZE) break;
+    auto submit = [&](std::vector<RecordSpan>&& spans) {
+        ReplayChunk c;
+        c.spans = std::make_shared<const std::vector<RecordSpan>>(std::move(spans));
+        auto verify = [base, spans = c.spans, record_header, log_number, type] {
+            return verify_spans(base, *spans, record_header, log_number, type);
+        };
+        if (pool) {
+            c.verified = pool->submit(std::move(verify));
+        } else {
+            std::promise<size_t> done;
+            done.set_value(verify());
+            c.verified = done.get_future();
+        }
+        inflight.push_back(std::move(c));
+        while (inflight.size() >= max_inflight && !inflight.empty()) deliver_front();
+    };
 
-        // Read value.
-        std::string value(value_size, '\0');
-        if (value_size > 0 && !read_exact(rfd, value.data(), value_size)) break;
+    std::vector<RecordSpan> chunk;
+    uint64_t chunk_bytes = 0;
+    while (!corrupt) {
+        // A header that does not even hold key_size is a clean end (the
+        // writer's last append never started); any other short read is a
+        // torn record.
+        if (size - pos < sizeof(uint32_t)) {
+            clean_end = true;
+            break;
+        }
+        if (size - pos < sizeof(uint32_t) * 2) break;
+        uint32_t key_size   = read32(pos);
+        uint32_t value_size = read32(pos + 4);
+        if (log_number) {
+            // Preallocated zeros or a record left by this file's previous
+            // life: the end of this log, not corruption.
+            if (size - pos < sizeof(uint32_t) * 3) break;
+            if (read32(pos + 8) != log_number) {
+                clean_end = true;
+                break;
+            }
+        }
+        if (size - pos < record_header) break;
 
-        // Verify checksum.
-        uint32_t expected = record_checksum(key_size, value_size, key, value);
-        if (stored_checksum != expected) break;
+        // Size sanity checks — corruption guards. Batch records hold the
+        // payload length in key_size.
+        RecordSpan r{pos, key_size, value_size, read32(pos + record_header - sizeof(uint32_t))};
+        if (value_size == WAL_BATCH_MARKER ? key_size > MAX_BATCH_SIZE : key_size > MAX_FIELD_SIZE) break;
+        if (value_size == WAL_VLOG_BASE_MARKER && key_size != sizeof(uint64_t)) break;
+        if (!is_marker(value_size) && value_size > MAX_FIELD_SIZE) break;
+        uint64_t record_size = record_header + span_body(r);
+        if (size - pos < record_size) break;
 
-        result.entries.push_back({std::move(key), std::move(value), false});
-        continue;
+        chunk.push_back(r);
+        pos         += record_size;
+        chunk_bytes += record_size;
+        if (chunk_bytes >= REPLAY_CHUNK_BYTES) {
+            submit(std::move(chunk));
+            chunk.clear();
+            chunk_bytes = 0;
+        }
     }
+    if (!chunk.empty() && !corrupt) submit(std::move(chunk));
+    while (!inflight.empty()) deliver_front();
 
-    wal_close(rfd);
-
-    // If we didn't exit cleanly at a record boundary, the WAL is tainted.
-    if (!hit_eof_cleanly) {
-        result.tainted = true;
+    // If we didn't stop cleanly at a record boundary, the WAL is tainted.
+    result.tainted = corrupt || !clean_end;
+    if (result.tainted) {
         std::cerr << "[WAL] WARNING: replay stopped at corrupt/incomplete record "
-                  << "(recovered " << result.entries.size()
+                  << "(recovered " << result.entries
                   << " valid entries, WAL marked tainted)\n";
     }
 
@@ -0,0 +1,39 @@
+#include "write_batch.h"
+
+#include <cstring>
+
+void WriteBatch::clear() {
+    rep_.assign(sizeof(uint32_t), '\0');   // count = 0
+}
+
+uint32_t WriteBatch::count() const {
+    uint32_t n = 0;
+    std::memcpy(&n, rep_.data(), sizeof(uint32_t));
+    return n;
+}
+
+void WriteBatch::put(std::string_view key, std::string_view value) {
+    append_op(kTypeValue, key, value);
+}
+
+void WriteBatch::delete_key(std::string_view key) {
+    append_op(kTypeDeletion, key, std::string_view());
+}
+
+void WriteBatch::append_op(uint8_t type, std::string_view key, std::string_view value) {
+    uint32_t ks = static_cast<uint32_t>(key.size());
+    uint32_t vs = static_cast<uint32_t>(value.size());
+
+    size_t off = rep_.size();
+    rep_.resize(off + 1 + sizeof(uint32_t) * 2 + ks + vs);
+    char* p = rep_.data() + off;
+    *p++ = static_cast<char>(type);
+    std::memcpy(p, &ks, sizeof(uint32_t)); p += sizeof(uint32_t);
+    std::memcpy(p, &vs, sizeof(uint32_t)); p += sizeof(uint32_t);
+    if (ks > 0) std::memcpy(p, key.data(), ks);
+    p += ks;
+    if (vs > 0) std::memcpy(p, value.data(), vs);
+
+    uint32_t n = count() + 1;
+    std::memcpy(rep_.data(), &n, sizeof(uint32_t));
+}